@@ -0,0 +1,146 @@
+#include "utility/drawSort.hpp"
+#include "utility/jobSystem.hpp"
+#include "utility/lightClusters.hpp"
+#include "utility/math.h"
+#include "utility/normalGeneration.hpp"
+#include "utility/sceneBvh.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <simd/simd.h>
+
+// Scaling of the job-system users with the thread count. The pool size is fixed once the
+// first job runs, so without arguments the benchmark runs itself once per count from 1 to
+// the hardware thread count and each child reports a row of timings.
+//
+//   jobSystemBenchmark            every thread count
+//   jobSystemBenchmark <threads>  one row
+
+namespace {
+    constexpr int kRepeats = 5;
+
+    // Best of kRepeats in milliseconds, setup runs outside the timing
+    double measure(const std::function<void()>& setup, const std::function<void()>& work) {
+        double best = 1e30;
+        for (int i = 0; i < kRepeats; i++) {
+            if (setup) setup();
+            const auto start = std::chrono::steady_clock::now();
+            work();
+            const auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+
+    double benchParallelFor() {
+        std::vector<float> values(1 << 22);
+        return measure(nullptr, [&]() {
+            jobs::parallelFor(values.size(), 1024, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) values[i] = std::sin(float(i) * 0.001f) * std::cos(float(i) * 0.002f);
+            });
+        });
+    }
+
+    double benchRadixSort() {
+        std::mt19937_64 random(1);
+        std::vector<drawSort::Item> source(1 << 20), items, scratch;
+        for (size_t i = 0; i < source.size(); i++) source[i] = { random(), uint32_t(i) };
+        return measure([&]() { items = source; }, [&]() { drawSort::radixSort(items, scratch); });
+    }
+
+    double benchLightClusters() {
+        std::mt19937 random(2);
+        std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+        std::uniform_real_distribution<float> range(0.5f, 6.0f);
+        std::vector<LightClusters::Light> lights(4096);
+        for (LightClusters::Light& light : lights) {
+            light = { simd_make_float3(position(random), position(random) * 0.2f, position(random) - 60.0f), range(random) };
+        }
+
+        LightClusters clusters;
+        clusters.setProjection(math::makePerspective(1.0f, 16.0f / 9.0f, 0.1f, 200.0f), 0.1f, 200.0f);
+        return measure(nullptr, [&]() { clusters.assign(math::makeIdentity(), lights.data(), lights.size()); });
+    }
+
+    double benchNormalGeneration() {
+        // Bumpy grid, 512 x 512 quads
+        constexpr int kSide = 513;
+        std::vector<Vertex> sourceVertices(kSide * kSide);
+        std::vector<unsigned int> sourceIndices;
+        for (int y = 0; y < kSide; y++) {
+            for (int x = 0; x < kSide; x++) {
+                Vertex& vertex = sourceVertices[y * kSide + x];
+                vertex = {};
+                vertex.position = simd_make_float3(float(x), std::sin(x * 0.3f) * std::cos(y * 0.2f), float(y));
+                vertex.texCoords = simd_make_float2(x / float(kSide - 1), y / float(kSide - 1));
+            }
+        }
+        for (int y = 0; y + 1 < kSide; y++) {
+            for (int x = 0; x + 1 < kSide; x++) {
+                const unsigned int corner = y * kSide + x;
+                sourceIndices.insert(sourceIndices.end(), { corner, corner + kSide, corner + 1, corner + 1, corner + kSide, corner + kSide + 1 });
+            }
+        }
+
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        return measure([&]() {
+            vertices = sourceVertices;
+            indices = sourceIndices;
+        }, [&]() { normalGeneration::generateNormals(vertices, indices); });
+    }
+
+    double benchBvhBuild() {
+        std::mt19937 random(3);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_real_distribution<float> size(0.5f, 4.0f);
+        SceneBvh bvh;
+        bvh.resize(200000);
+        std::vector<simd::float3> mins(bvh.size()), maxs(bvh.size());
+        for (size_t i = 0; i < bvh.size(); i++) {
+            mins[i] = simd_make_float3(position(random), position(random), position(random));
+            maxs[i] = mins[i] + simd_make_float3(size(random), size(random), size(random));
+        }
+        return measure([&]() {
+            for (size_t i = 0; i < bvh.size(); i++) bvh.setItem(uint32_t(i), mins[i], maxs[i]);
+        }, [&]() { bvh.build(); });
+    }
+
+    void runRow(unsigned int threads) {
+        jobs::initialize(threads);
+        const double parallelFor = benchParallelFor();
+        const double radixSort = benchRadixSort();
+        const double lightClusters = benchLightClusters();
+        const double normals = benchNormalGeneration();
+        const double bvh = benchBvhBuild();
+        std::printf("%7u %12.2f %12.2f %12.2f %12.2f %12.2f\n", threads, parallelFor, radixSort, lightClusters, normals, bvh);
+        std::fflush(stdout);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        runRow((unsigned int)std::max(1, std::atoi(argv[1])));
+        return 0;
+    }
+
+    std::printf("best of %d, milliseconds\n", kRepeats);
+    std::printf("%7s %12s %12s %12s %12s %12s\n", "threads", "parallelFor", "radixSort", "clusters", "normals", "bvhBuild");
+    std::fflush(stdout);
+
+    const unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int threads = 1; threads <= hardwareThreads; threads++) {
+        const std::string command = std::string("\"") + argv[0] + "\" " + std::to_string(threads);
+        if (std::system(command.c_str()) != 0) return 1;
+    }
+    return 0;
+}
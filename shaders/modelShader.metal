@@ -4,14 +4,21 @@ using namespace metal;
 struct v2f {
     float4 position [[position]];
     float3 normal;
+    float3 tangent;
+    float3 bitangent;
     float2 texcoord;
     float3 viewPos;
+    float3 worldPosition;
+    float viewDepth;
 };
 
-struct VertexData {
-    float3 position;
-    float3 normal;
-    float2 texCoord;
+// Attribute indices follow vertexFormat::Semantic, the layout comes from the
+// MTL::VertexDescriptor generated for the mesh's vertex format
+struct VertexIn {
+    float3 position [[attribute(0)]];
+    float3 normal [[attribute(1)]];
+    float2 texCoord [[attribute(2)]];
+    float4 qtangent [[attribute(3)]];
 };
 
 struct DirectionalLight {
@@ -26,6 +33,7 @@ struct PointLight {
     float3 diffuse;
     float3 specular;
     float3 ambient;
+    float range;
 };
 
 struct CameraData {
@@ -35,8 +43,16 @@ struct CameraData {
     float4x4 modifiedView;
 };
 
+struct InstanceData {
+    float4x4 transform;
+    float3x3 normalTransform;
+};
+
+// uvTransform places the texture inside its atlas page, xy scale and zw offset.
+// Standalone textures carry (1, 1, 0, 0).
 struct SingleTexture {
-    texture2d<float> texture;
+    texture2d<float> texture [[id(0)]];
+    float4 uvTransform [[id(1)]];
 };
 
 struct TextureEndpoints {
@@ -46,85 +62,148 @@ struct TextureEndpoints {
     int height;
 };
 
+struct MaterialData {
+    TextureEndpoints endpoints;
+    uint textureOffset;
+    uint textureCount;
+};
+
+// Cluster grid from LightClusters, slices are log(depth) * sliceScale + sliceBias
 struct LightInfo {
     int numPoints;
     int numDirections;
+    float2 tileScale;
+    uint tilesX;
+    uint tilesY;
+    uint slices;
+    float sliceScale;
+    float sliceBias;
+};
+
+// A run of lightIndices, matches LightClusters::Cluster
+struct LightCluster {
+    uint offset;
+    uint count;
 };
 
-v2f vertex vertexMain(device const VertexData* vertexData [[buffer(0)]],
-                      device const CameraData& cameraData [[buffer(2)]], uint vertexId [[vertex_id]]) {
+// Mirrors tangentFrame::decodeQTangent without the normal, which the vertex carries
+// unquantized. Negative w flips the bitangent. The short4 normalized attribute arrives
+// already scaled to [-1, 1].
+void decodeTangents(float4 qtangent, thread float3& tangent, thread float3& bitangent) {
+    float4 q = normalize(qtangent);
+    
+    tangent = float3(1.0 - 2.0 * (q.y * q.y + q.z * q.z),
+                     2.0 * (q.x * q.y + q.w * q.z),
+                     2.0 * (q.x * q.z - q.w * q.y));
+    bitangent = float3(2.0 * (q.x * q.y - q.w * q.z),
+                       1.0 - 2.0 * (q.x * q.x + q.z * q.z),
+                       2.0 * (q.y * q.z + q.w * q.x));
+    
+    if (q.w < 0.0) bitangent = -bitangent;
+}
+
+// Wraps the coordinate inside the atlas rect, the gradients come from the unwrapped
+// coordinate so the fract() seam doesn't drop to the smallest mip
+float4 sampleSlot(device const SingleTexture& slot, sampler s, float2 texcoord, float2 ddx, float2 ddy) {
+    float2 scale = slot.uvTransform.xy;
+    float2 uv = fract(texcoord) * scale + slot.uvTransform.zw;
+    return slot.texture.sample(s, uv, gradient2d(ddx * scale, ddy * scale));
+}
+
+v2f vertex vertexMain(VertexIn vs [[stage_in]],
+                      device const InstanceData* instances [[buffer(1)]],
+                      device const CameraData& cameraData [[buffer(2)]],
+                      uint instanceId [[instance_id]]) {
     v2f o;
     
-    const device VertexData& vs = vertexData[vertexId];
-    float4 pos = float4(vs.position, 1.0);
+    const device InstanceData& instance = instances[instanceId];
+    float4 pos = instance.transform * float4(vs.position, 1.0);
     o.position = cameraData.perspective * cameraData.view * pos;
     
-    o.normal = vs.normal;
+    float3 tangent, bitangent;
+    decodeTangents(vs.qtangent, tangent, bitangent);
+    
+    float3x3 linear = float3x3(instance.transform[0].xyz, instance.transform[1].xyz, instance.transform[2].xyz);
+    o.tangent = linear * tangent;
+    o.bitangent = linear * bitangent;
+    o.normal = instance.normalTransform * vs.normal;
     o.texcoord = vs.texCoord.xy;
     o.viewPos = cameraData.position;
+    o.worldPosition = pos.xyz;
+    o.viewDepth = -(cameraData.view * pos).z;
     
     return o;
 }
 
-float4 fragment fragmentMain(v2f in [[stage_in]], device TextureEndpoints& endpoints [[buffer(0)]], device SingleTexture* textures[[buffer(1)]],
-                             device PointLight* pointLights [[buffer(2)]],
-                             device DirectionalLight* directionLights [[buffer(3)]],
-                             device const LightInfo& lightInfo [[buffer(4)]]) {
-    constexpr sampler s(address::repeat, filter::linear);
+float4 fragment fragmentMain(v2f in [[stage_in]], device const MaterialData* materials [[buffer(0)]], device SingleTexture* allTextures [[buffer(1)]],
+                             device const PointLight* pointLights [[buffer(2)]],
+                             device const DirectionalLight* directionLights [[buffer(3)]],
+                             device const LightInfo& lightInfo [[buffer(4)]],
+                             constant uint& materialIndex [[buffer(5)]],
+                             device const LightCluster* clusters [[buffer(6)]],
+                             device const uint* lightIndices [[buffer(7)]]) {
+    constexpr sampler s(address::repeat, filter::linear, mip_filter::linear);
+    
+    const device MaterialData& material = materials[materialIndex];
+    TextureEndpoints endpoints = material.endpoints;
+    device SingleTexture* textures = allTextures + material.textureOffset;
+    float2 ddx = dfdx(in.texcoord);
+    float2 ddy = dfdy(in.texcoord);
     
     float3 total = float3(0.0);
-    float3 viewDir = in.viewPos - in.position.xyz;
+    float3 viewDir = in.viewPos - in.worldPosition;
     viewDir = normalize(viewDir);
     
+    float3 normal = normalize(in.normal);
+    if (endpoints.normal >= 0) {
+        float3 tangentNormal = sampleSlot(textures[endpoints.normal], s, in.texcoord, ddx, ddy).xyz * 2.0 - 1.0;
+        float3x3 tbn = float3x3(normalize(in.tangent), normalize(in.bitangent), normal);
+        normal = normalize(tbn * tangentNormal);
+    }
+    
+    // Texels are the same for every light, sample them once
+    float3 diffuseTexel = float3(0.0);
+    for (int i = 0; i <= endpoints.diffuse; i++) {
+        diffuseTexel += sampleSlot(textures[i], s, in.texcoord, ddx, ddy).rgb;
+    }
+    
+    float3 specularTexel = float3(0.0);
+    for (int i = endpoints.diffuse+1; i <= endpoints.specular; i++) {
+        specularTexel += sampleSlot(textures[i], s, in.texcoord, ddx, ddy).rgb;
+    }
+    
     for (int i = 0; i < lightInfo.numDirections; i++) {
         DirectionalLight light = directionLights[i];
         
-        float diffuse = max(dot(in.normal, light.direction), 0.0);
+        float diffuse = max(dot(normal, light.direction), 0.0);
         
-        float3 reflectDir = reflect(-light.direction, in.normal);
+        float3 reflectDir = reflect(-light.direction, normal);
         float specular = pow(max(dot(reflectDir, viewDir), 0.0), 10);
         
-        for (int i = 0; i <= endpoints.diffuse; i++) {
-            texture2d<float> currentTexture = textures[i].texture;
-            float3 texel = currentTexture.sample(s, in.texcoord).rgb;
-            
-            total += light.diffuse * diffuse * texel;
-        }
-        
-        for (int i = endpoints.diffuse+1; i <= endpoints.specular; i++) {
-            texture2d<float> currentTexture = textures[i].texture;
-            float3 texel = currentTexture.sample(s, in.texcoord).rgb;
-
-            total += light.specular * specular * texel;
-        }
-        
-        total += light.ambient;
+        total += light.diffuse * diffuse * diffuseTexel + light.specular * specular * specularTexel + light.ambient;
     }
     
-    for (int i = 0; i < lightInfo.numPoints; i++) {
-        PointLight light = pointLights[i];
-        float3 lightDir = normalize(light.position - in.position.xyz);
+    // Only the point lights binned into this pixel's cluster can reach it
+    uint2 tile = min(uint2(in.position.xy * lightInfo.tileScale), uint2(lightInfo.tilesX - 1, lightInfo.tilesY - 1));
+    uint slice = uint(clamp(log(in.viewDepth) * lightInfo.sliceScale + lightInfo.sliceBias, 0.0, float(lightInfo.slices - 1)));
+    LightCluster cluster = clusters[(slice * lightInfo.tilesY + tile.y) * lightInfo.tilesX + tile.x];
+    
+    for (uint i = 0; i < cluster.count; i++) {
+        PointLight light = pointLights[lightIndices[cluster.offset + i]];
+        float3 toLight = light.position - in.worldPosition;
+        float distanceSquared = dot(toLight, toLight);
+        float3 lightDir = toLight * rsqrt(max(distanceSquared, 1e-8));
         
-        float diffuse = max(dot(in.normal, lightDir), 0.0);
+        // Reaches zero at the range, which is what the clusters were binned by
+        float falloff = saturate(1.0 - distanceSquared / (light.range * light.range));
+        falloff *= falloff;
         
-        float3 reflectDir = reflect(-lightDir, in.normal);
-        float specular = pow(max(dot(reflectDir, viewDir), 0.0), 10);
+        float diffuse = max(dot(normal, lightDir), 0.0);
         
-        for (int j = 0; j <= endpoints.diffuse; j++) {
-            texture2d<float> currentTexture = textures[j].texture;
-            float3 texel = currentTexture.sample(s, in.texcoord).rgb;
-            
-            total += light.diffuse * diffuse * texel;
-        }
-        
-        for (int j = endpoints.diffuse+1; j <= endpoints.specular; j++) {
-            texture2d<float> currentTexture = textures[j].texture;
-            float3 texel = currentTexture.sample(s, in.texcoord).rgb;
-
-            total += light.specular * specular * texel;
-        }
+        float3 reflectDir = reflect(-lightDir, normal);
+        float specular = pow(max(dot(reflectDir, viewDir), 0.0), 10);
         
-        total += light.ambient;
+        total += (light.diffuse * diffuse * diffuseTexel + light.specular * specular * specularTexel + light.ambient) * falloff;
     }
     
     return float4(total, 1.0);
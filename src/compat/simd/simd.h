@@ -0,0 +1,291 @@
+#pragma once
+
+// Portable stand-in for the part of Apple's <simd/simd.h> the backend-free core uses, so
+// metal_engine_core and its tests build on hosts without the Apple SDK. CMake only puts it
+// on the include path for non-Apple targets. Vectors are plain structs with the sizes and
+// alignment of Apple's types, so three-wide vectors are padded to 16 bytes.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+typedef int simd_int1;
+
+struct alignas(8) simd_float2 {
+    float x, y;
+
+    float& operator[](int i) { return (&x)[i]; }
+    float operator[](int i) const { return (&x)[i]; }
+};
+
+struct alignas(16) simd_float3 {
+    float x, y, z;
+
+    float& operator[](int i) { return (&x)[i]; }
+    float operator[](int i) const { return (&x)[i]; }
+};
+
+struct alignas(16) simd_float4 {
+    union {
+        struct { float x, y, z, w; };
+        simd_float3 xyz;
+        struct { simd_float2 xy, zw; };
+    };
+
+    float& operator[](int i) { return (&x)[i]; }
+    float operator[](int i) const { return (&x)[i]; }
+};
+
+struct alignas(8) simd_short4 {
+    short x, y, z, w;
+
+    short& operator[](int i) { return (&x)[i]; }
+    short operator[](int i) const { return (&x)[i]; }
+};
+
+struct simd_float3x3 {
+    simd_float3 columns[3];
+};
+
+struct simd_float4x4 {
+    simd_float4 columns[4];
+};
+
+struct simd_quatf {
+    simd_float4 vector;
+};
+
+namespace simd_compat {
+    template <typename V> struct Lanes { static constexpr int value = 0; };
+    template <> struct Lanes<simd_float2> { static constexpr int value = 2; };
+    template <> struct Lanes<simd_float3> { static constexpr int value = 3; };
+    template <> struct Lanes<simd_float4> { static constexpr int value = 4; };
+
+    template <typename V>
+    using Vector = typename std::enable_if<(Lanes<V>::value > 0), V>::type;
+
+    template <typename V, typename Function>
+    V zip(const V& a, const V& b, Function function) {
+        V result = {};
+        for (int i = 0; i < Lanes<V>::value; i++) result[i] = function(a[i], b[i]);
+        return result;
+    }
+
+    template <typename V, typename Function>
+    V map(const V& a, Function function) {
+        V result = {};
+        for (int i = 0; i < Lanes<V>::value; i++) result[i] = function(a[i]);
+        return result;
+    }
+
+    template <typename V>
+    V splat(float value) {
+        V result = {};
+        for (int i = 0; i < Lanes<V>::value; i++) result[i] = value;
+        return result;
+    }
+}
+
+template <typename V> inline simd_compat::Vector<V> operator+(V a, V b) { return simd_compat::zip(a, b, [](float x, float y) { return x + y; }); }
+template <typename V> inline simd_compat::Vector<V> operator-(V a, V b) { return simd_compat::zip(a, b, [](float x, float y) { return x - y; }); }
+template <typename V> inline simd_compat::Vector<V> operator*(V a, V b) { return simd_compat::zip(a, b, [](float x, float y) { return x * y; }); }
+template <typename V> inline simd_compat::Vector<V> operator/(V a, V b) { return simd_compat::zip(a, b, [](float x, float y) { return x / y; }); }
+template <typename V> inline simd_compat::Vector<V> operator-(V a) { return simd_compat::map(a, [](float x) { return -x; }); }
+
+template <typename V> inline simd_compat::Vector<V> operator+(V a, float b) { return a + simd_compat::splat<V>(b); }
+template <typename V> inline simd_compat::Vector<V> operator-(V a, float b) { return a - simd_compat::splat<V>(b); }
+template <typename V> inline simd_compat::Vector<V> operator*(V a, float b) { return a * simd_compat::splat<V>(b); }
+template <typename V> inline simd_compat::Vector<V> operator/(V a, float b) { return a / simd_compat::splat<V>(b); }
+template <typename V> inline simd_compat::Vector<V> operator+(float a, V b) { return simd_compat::splat<V>(a) + b; }
+template <typename V> inline simd_compat::Vector<V> operator-(float a, V b) { return simd_compat::splat<V>(a) - b; }
+template <typename V> inline simd_compat::Vector<V> operator*(float a, V b) { return simd_compat::splat<V>(a) * b; }
+template <typename V> inline simd_compat::Vector<V> operator/(float a, V b) { return simd_compat::splat<V>(a) / b; }
+
+template <typename V> inline simd_compat::Vector<V>& operator+=(V& a, V b) { return a = a + b; }
+template <typename V> inline simd_compat::Vector<V>& operator-=(V& a, V b) { return a = a - b; }
+template <typename V> inline simd_compat::Vector<V>& operator*=(V& a, V b) { return a = a * b; }
+template <typename V> inline simd_compat::Vector<V>& operator/=(V& a, V b) { return a = a / b; }
+template <typename V> inline simd_compat::Vector<V>& operator+=(V& a, float b) { return a = a + b; }
+template <typename V> inline simd_compat::Vector<V>& operator-=(V& a, float b) { return a = a - b; }
+template <typename V> inline simd_compat::Vector<V>& operator*=(V& a, float b) { return a = a * b; }
+template <typename V> inline simd_compat::Vector<V>& operator/=(V& a, float b) { return a = a / b; }
+
+inline simd_float2 simd_make_float2(float x, float y) { return { x, y }; }
+inline simd_float3 simd_make_float3(float x, float y, float z) { return { x, y, z }; }
+inline simd_float3 simd_make_float3(simd_float4 v) { return simd_make_float3(v.x, v.y, v.z); }
+inline simd_float4 simd_make_float4(float x, float y, float z, float w) {
+    simd_float4 result = {};
+    result.x = x;
+    result.y = y;
+    result.z = z;
+    result.w = w;
+    return result;
+}
+inline simd_float4 simd_make_float4(simd_float3 v, float w) { return simd_make_float4(v.x, v.y, v.z, w); }
+inline simd_short4 simd_make_short4(short x, short y, short z, short w) { return { x, y, z, w }; }
+
+template <typename V> inline typename std::enable_if<(simd_compat::Lanes<V>::value > 0), float>::type simd_dot(V a, V b) {
+    float sum = 0.0f;
+    for (int i = 0; i < simd_compat::Lanes<V>::value; i++) sum += a[i] * b[i];
+    return sum;
+}
+template <typename V> inline simd_compat::Vector<V> simd_min(V a, V b) { return simd_compat::zip(a, b, [](float x, float y) { return std::min(x, y); }); }
+template <typename V> inline simd_compat::Vector<V> simd_max(V a, V b) { return simd_compat::zip(a, b, [](float x, float y) { return std::max(x, y); }); }
+template <typename V> inline simd_compat::Vector<V> simd_abs(V a) { return simd_compat::map(a, [](float x) { return std::fabs(x); }); }
+template <typename V> inline simd_compat::Vector<V> simd_floor(V a) { return simd_compat::map(a, [](float x) { return std::floor(x); }); }
+template <typename V> inline simd_compat::Vector<V> simd_clamp(V x, V low, V high) { return simd_min(simd_max(x, low), high); }
+template <typename V> inline simd_compat::Vector<V> simd_mix(V a, V b, V t) { return a + (b - a) * t; }
+template <typename V> inline float simd_length_squared(V a) { return simd_dot(a, a); }
+template <typename V> inline float simd_length(V a) { return std::sqrt(simd_dot(a, a)); }
+template <typename V> inline float simd_distance(V a, V b) { return simd_length(a - b); }
+template <typename V> inline simd_compat::Vector<V> simd_normalize(V a) { return a / simd_length(a); }
+inline float simd_clamp(float x, float low, float high) { return std::min(std::max(x, low), high); }
+inline float simd_reduce_min(simd_float3 a) { return std::min(a.x, std::min(a.y, a.z)); }
+inline float simd_reduce_max(simd_float3 a) { return std::max(a.x, std::max(a.y, a.z)); }
+
+inline simd_float3 simd_cross(simd_float3 a, simd_float3 b) {
+    return simd_make_float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+inline simd_float3x3 simd_matrix(simd_float3 c0, simd_float3 c1, simd_float3 c2) { return { { c0, c1, c2 } }; }
+inline simd_float4x4 simd_matrix(simd_float4 c0, simd_float4 c1, simd_float4 c2, simd_float4 c3) { return { { c0, c1, c2, c3 } }; }
+
+inline simd_float3x3 simd_transpose(const simd_float3x3& m) {
+    simd_float3x3 result = {};
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++) result.columns[c][r] = m.columns[r][c];
+    }
+    return result;
+}
+
+inline simd_float4x4 simd_transpose(const simd_float4x4& m) {
+    simd_float4x4 result = {};
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) result.columns[c][r] = m.columns[r][c];
+    }
+    return result;
+}
+
+inline simd_float3x3 simd_matrix_from_rows(simd_float3 r0, simd_float3 r1, simd_float3 r2) {
+    return simd_transpose(simd_matrix(r0, r1, r2));
+}
+inline simd_float4x4 simd_matrix_from_rows(simd_float4 r0, simd_float4 r1, simd_float4 r2, simd_float4 r3) {
+    return simd_transpose(simd_matrix(r0, r1, r2, r3));
+}
+
+inline simd_float3 simd_mul(const simd_float3x3& m, simd_float3 v) {
+    return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z;
+}
+inline simd_float4 simd_mul(const simd_float4x4& m, simd_float4 v) {
+    return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z + m.columns[3] * v.w;
+}
+inline simd_float3x3 simd_mul(const simd_float3x3& a, const simd_float3x3& b) {
+    return simd_matrix(simd_mul(a, b.columns[0]), simd_mul(a, b.columns[1]), simd_mul(a, b.columns[2]));
+}
+inline simd_float4x4 simd_mul(const simd_float4x4& a, const simd_float4x4& b) {
+    return simd_matrix(simd_mul(a, b.columns[0]), simd_mul(a, b.columns[1]), simd_mul(a, b.columns[2]), simd_mul(a, b.columns[3]));
+}
+inline simd_float3 operator*(const simd_float3x3& m, simd_float3 v) { return simd_mul(m, v); }
+inline simd_float4 operator*(const simd_float4x4& m, simd_float4 v) { return simd_mul(m, v); }
+inline simd_float3x3 operator*(const simd_float3x3& a, const simd_float3x3& b) { return simd_mul(a, b); }
+inline simd_float4x4 operator*(const simd_float4x4& a, const simd_float4x4& b) { return simd_mul(a, b); }
+
+inline simd_float3x3 simd_inverse(const simd_float3x3& m) {
+    const simd_float3 r0 = simd_cross(m.columns[1], m.columns[2]);
+    const simd_float3 r1 = simd_cross(m.columns[2], m.columns[0]);
+    const simd_float3 r2 = simd_cross(m.columns[0], m.columns[1]);
+    const float determinant = simd_dot(r2, m.columns[2]);
+    return simd_matrix_from_rows(r0 / determinant, r1 / determinant, r2 / determinant);
+}
+
+// Cofactor expansion by 2x2 sub-determinants
+inline simd_float4x4 simd_inverse(const simd_float4x4& m) {
+    float a[16];
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) a[c * 4 + r] = m.columns[c][r];
+    }
+
+    float inverse[16];
+    inverse[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] + a[9] * a[7] * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+    inverse[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] - a[8] * a[7] * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+    inverse[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] + a[8] * a[7] * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+    inverse[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] - a[8] * a[6] * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+    inverse[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] - a[9] * a[3] * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+    inverse[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] + a[8] * a[3] * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+    inverse[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] - a[8] * a[3] * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+    inverse[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] + a[8] * a[2] * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+    inverse[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] + a[5] * a[3] * a[14] + a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+    inverse[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] - a[4] * a[3] * a[14] - a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+    inverse[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] + a[4] * a[3] * a[13] + a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+    inverse[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] - a[4] * a[2] * a[13] - a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+    inverse[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] - a[5] * a[3] * a[10] - a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+    inverse[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] + a[4] * a[3] * a[10] + a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+    inverse[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] - a[4] * a[3] * a[9] - a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+    inverse[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] + a[4] * a[2] * a[9] + a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+    const float determinant = a[0] * inverse[0] + a[1] * inverse[4] + a[2] * inverse[8] + a[3] * inverse[12];
+    simd_float4x4 result = {};
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) result.columns[c][r] = inverse[c * 4 + r] / determinant;
+    }
+    return result;
+}
+
+inline simd_quatf simd_quaternion(float x, float y, float z, float w) { return { simd_make_float4(x, y, z, w) }; }
+inline simd_quatf simd_quaternion(simd_float4 xyzw) { return { xyzw }; }
+inline simd_quatf simd_quaternion(float angle, simd_float3 axis) {
+    const simd_float3 v = simd_normalize(axis) * std::sin(angle * 0.5f);
+    return simd_quaternion(v.x, v.y, v.z, std::cos(angle * 0.5f));
+}
+inline simd_quatf simd_normalize(simd_quatf q) { return { simd_normalize(q.vector) }; }
+
+inline simd_float3x3 simd_matrix3x3(simd_quatf q) {
+    const float x = q.vector.x, y = q.vector.y, z = q.vector.z, w = q.vector.w;
+    return simd_matrix(simd_make_float3(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y)),
+                       simd_make_float3(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x)),
+                       simd_make_float3(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y)));
+}
+inline simd_float4x4 simd_matrix4x4(simd_quatf q) {
+    const simd_float3x3 m = simd_matrix3x3(q);
+    return simd_matrix(simd_make_float4(m.columns[0], 0.0f), simd_make_float4(m.columns[1], 0.0f),
+                       simd_make_float4(m.columns[2], 0.0f), simd_make_float4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+inline simd_float3 simd_act(simd_quatf q, simd_float3 v) { return simd_mul(simd_matrix3x3(q), v); }
+
+static const simd_float3x3 matrix_identity_float3x3 = { { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } } };
+static const simd_float4x4 matrix_identity_float4x4 = simd_matrix(simd_make_float4(1.0f, 0.0f, 0.0f, 0.0f), simd_make_float4(0.0f, 1.0f, 0.0f, 0.0f),
+                                                                  simd_make_float4(0.0f, 0.0f, 1.0f, 0.0f), simd_make_float4(0.0f, 0.0f, 0.0f, 1.0f));
+
+namespace simd {
+    typedef simd_int1 int1;
+    typedef simd_float2 float2;
+    typedef simd_float3 float3;
+    typedef simd_float4 float4;
+    typedef simd_short4 short4;
+    typedef simd_float3x3 float3x3;
+    typedef simd_float4x4 float4x4;
+    typedef simd_quatf quatf;
+
+    template <typename V> inline float dot(V a, V b) { return simd_dot(a, b); }
+    template <typename V> inline V min(V a, V b) { return simd_min(a, b); }
+    template <typename V> inline V max(V a, V b) { return simd_max(a, b); }
+    template <typename V> inline V abs(V a) { return simd_abs(a); }
+    template <typename V> inline V floor(V a) { return simd_floor(a); }
+    template <typename V> inline V clamp(V x, V low, V high) { return simd_clamp(x, low, high); }
+    template <typename V> inline V mix(V a, V b, V t) { return simd_mix(a, b, t); }
+    template <typename V> inline float length(V a) { return simd_length(a); }
+    template <typename V> inline float length_squared(V a) { return simd_length_squared(a); }
+    template <typename V> inline float distance(V a, V b) { return simd_distance(a, b); }
+    template <typename V> inline V normalize(V a) { return simd_normalize(a); }
+    inline float3 cross(float3 a, float3 b) { return simd_cross(a, b); }
+    inline float reduce_min(float3 a) { return simd_reduce_min(a); }
+    inline float reduce_max(float3 a) { return simd_reduce_max(a); }
+    inline float3x3 inverse(const float3x3& m) { return simd_inverse(m); }
+    inline float4x4 inverse(const float4x4& m) { return simd_inverse(m); }
+    inline float3x3 transpose(const float3x3& m) { return simd_transpose(m); }
+    inline float4x4 transpose(const float4x4& m) { return simd_transpose(m); }
+}
+
+static_assert(sizeof(simd::float3) == 16 && sizeof(simd::float4) == 16, "simd vectors must match Apple's layout");
+static_assert(sizeof(simd::float3x3) == 48 && sizeof(simd::float4x4) == 64, "simd matrices must match Apple's layout");
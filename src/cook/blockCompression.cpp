@@ -0,0 +1,153 @@
+#include "blockCompression.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    inline uint16_t packRGB565(const float color[3]) {
+        int r = std::clamp((int)std::lround(color[0] * 31.0f / 255.0f), 0, 31);
+        int g = std::clamp((int)std::lround(color[1] * 63.0f / 255.0f), 0, 63);
+        int b = std::clamp((int)std::lround(color[2] * 31.0f / 255.0f), 0, 31);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    inline void unpackRGB565(uint16_t packed, int color[3]) {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // Endpoints come from the extremes of the block along its principal axis, inset
+    // slightly so the interpolated colours cover the cluster instead of its outliers
+    void principalEndpoints(const unsigned char* rgba, float minColor[3], float maxColor[3]) {
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; i++) {
+            for (int c = 0; c < 3; c++) mean[c] += rgba[i * 4 + c];
+        }
+        for (int c = 0; c < 3; c++) mean[c] /= 16.0f;
+
+        float covariance[6] = { 0.0f };
+        for (int i = 0; i < 16; i++) {
+            float r = rgba[i * 4] - mean[0], g = rgba[i * 4 + 1] - mean[1], b = rgba[i * 4 + 2] - mean[2];
+            covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+            covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+        }
+
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+            float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+            float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+            float length = std::max({ std::fabs(x), std::fabs(y), std::fabs(z) });
+            if (length < 1e-6f) break;
+            axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+        }
+
+        float minProjection = 1e30f, maxProjection = -1e30f;
+        for (int i = 0; i < 16; i++) {
+            float projection = (rgba[i * 4] - mean[0]) * axis[0] + (rgba[i * 4 + 1] - mean[1]) * axis[1] +
+                               (rgba[i * 4 + 2] - mean[2]) * axis[2];
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+
+        float inset = (maxProjection - minProjection) / 32.0f;
+        minProjection += inset;
+        maxProjection -= inset;
+
+        float axisLengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        if (axisLengthSquared < 1e-12f) axisLengthSquared = 1.0f;
+        for (int c = 0; c < 3; c++) {
+            minColor[c] = std::clamp(mean[c] + axis[c] * minProjection / axisLengthSquared, 0.0f, 255.0f);
+            maxColor[c] = std::clamp(mean[c] + axis[c] * maxProjection / axisLengthSquared, 0.0f, 255.0f);
+        }
+    }
+
+    void encodeColorBlock(const unsigned char* rgba, unsigned char* output) {
+        float minColor[3], maxColor[3];
+        principalEndpoints(rgba, minColor, maxColor);
+
+        uint16_t color0 = packRGB565(maxColor);
+        uint16_t color1 = packRGB565(minColor);
+        uint32_t selectors = 0;
+
+        // color0 > color1 keeps the block in four colour mode
+        if (color0 < color1) std::swap(color0, color1);
+        if (color0 != color1) {
+            int palette[4][3];
+            unpackRGB565(color0, palette[0]);
+            unpackRGB565(color1, palette[1]);
+            for (int c = 0; c < 3; c++) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (int i = 0; i < 16; i++) {
+                int best = 0, bestError = 1 << 30;
+                for (int p = 0; p < 4; p++) {
+                    int dr = rgba[i * 4] - palette[p][0], dg = rgba[i * 4 + 1] - palette[p][1], db = rgba[i * 4 + 2] - palette[p][2];
+                    int error = dr * dr + dg * dg + db * db;
+                    if (error < bestError) {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                selectors |= (uint32_t)best << (i * 2);
+            }
+        }
+
+        std::memcpy(output, &color0, 2);
+        std::memcpy(output + 2, &color1, 2);
+        std::memcpy(output + 4, &selectors, 4);
+    }
+
+    void encodeAlphaBlock(const unsigned char* values, int stride, unsigned char* output) {
+        int minValue = 255, maxValue = 0;
+        for (int i = 0; i < 16; i++) {
+            minValue = std::min(minValue, (int)values[i * stride]);
+            maxValue = std::max(maxValue, (int)values[i * stride]);
+        }
+
+        output[0] = (unsigned char)maxValue;
+        output[1] = (unsigned char)minValue;
+        uint64_t selectors = 0;
+
+        if (maxValue != minValue) {
+            // Eight value mode, palette runs from max (0) through the interpolants to min (1)
+            int palette[8];
+            palette[0] = maxValue;
+            palette[1] = minValue;
+            for (int p = 1; p < 7; p++) palette[p + 1] = ((7 - p) * maxValue + p * minValue) / 7;
+
+            for (int i = 0; i < 16; i++) {
+                int value = values[i * stride];
+                int best = 0, bestError = 1 << 30;
+                for (int p = 0; p < 8; p++) {
+                    int error = std::abs(value - palette[p]);
+                    if (error < bestError) {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                selectors |= (uint64_t)best << (i * 3);
+            }
+        }
+
+        for (int i = 0; i < 6; i++) output[2 + i] = (unsigned char)(selectors >> (i * 8));
+    }
+}
+
+void blockCompression::encodeBC1(const unsigned char* rgba, unsigned char* output) {
+    encodeColorBlock(rgba, output);
+}
+
+void blockCompression::encodeBC3(const unsigned char* rgba, unsigned char* output) {
+    encodeAlphaBlock(rgba + 3, 4, output);
+    encodeColorBlock(rgba, output + 8);
+}
+
+void blockCompression::encodeBC4(const unsigned char* values, unsigned char* output) {
+    encodeAlphaBlock(values, 1, output);
+}
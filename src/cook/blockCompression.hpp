@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+// Block encoders for the cooked texture formats. Every function takes one 4x4
+// block of pixels in row order, edge blocks are expected to be padded by the caller.
+namespace blockCompression {
+    // 16 RGBA8 pixels -> 8 bytes, alpha is ignored
+    void encodeBC1(const unsigned char* rgba, unsigned char* output);
+
+    // 16 RGBA8 pixels -> 16 bytes, BC4 alpha block followed by a BC1 colour block
+    void encodeBC3(const unsigned char* rgba, unsigned char* output);
+
+    // 16 single channel pixels -> 8 bytes
+    void encodeBC4(const unsigned char* values, unsigned char* output);
+}
@@ -0,0 +1,289 @@
+#include "cooker.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include "textureCooker.hpp"
+#include "../utility/importUtils.hpp"
+#include "../utility/jobSystem.hpp"
+#include "../utility/meshCache.hpp"
+#include "../utility/tangentFrame.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+    // Bump whenever an output format or processing step changes, it invalidates every node
+    const std::string kCookerVersion = "mcache3-mtex1";
+
+    const char* kModelExtensions[] = { ".obj", ".fbx", ".gltf", ".glb", ".dae", ".3ds", ".blend", ".ply", ".stl" };
+    const char* kImageExtensions[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp", ".psd", ".hdr", ".gif" };
+
+    template <size_t N>
+    bool hasExtension(const fs::path& path, const char* (&extensions)[N]) {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        for (const char* candidate : extensions) {
+            if (extension == candidate) return true;
+        }
+        return false;
+    }
+
+    uint64_t settingsHash(const std::string& parameters) {
+        return cook::hashString(parameters, cook::hashString(kCookerVersion));
+    }
+
+    // Records every file Assimp opens, which covers side files like .mtl and .bin
+    class RecordingIOSystem : public Assimp::DefaultIOSystem {
+    public:
+        std::vector<std::string> opened;
+
+        Assimp::IOStream* Open(const char* file, const char* mode = "rb") override {
+            Assimp::IOStream* stream = Assimp::DefaultIOSystem::Open(file, mode);
+            if (stream) opened.push_back(file);
+            return stream;
+        }
+    };
+
+    // One asset per range, cook times vary too much for batching to pay off
+    template <typename Function>
+    void parallelFor(size_t count, Function function) {
+        jobs::parallelFor(count, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) function(i);
+        });
+    }
+
+    // Same traversal as Model::processNode, one entry per unique aiMesh with all its node transforms
+    void collectMeshes(aiNode* node, const simd::float4x4& parentTransform, std::vector<int>& meshLookup,
+                       std::vector<unsigned int>& meshes, std::vector<std::vector<simd::float4x4>>& instances) {
+        simd::float4x4 transform = simd_mul(parentTransform, importUtils::toMatrix(node->mTransformation));
+
+        for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+            unsigned int meshIndex = node->mMeshes[i];
+            if (meshLookup[meshIndex] < 0) {
+                meshLookup[meshIndex] = (int)meshes.size();
+                meshes.push_back(meshIndex);
+                instances.emplace_back();
+            }
+            instances[meshLookup[meshIndex]].push_back(transform);
+        }
+        for (unsigned int i = 0; i < node->mNumChildren; i++) {
+            collectMeshes(node->mChildren[i], transform, meshLookup, meshes, instances);
+        }
+    }
+}
+
+cook::Cooker::Cooker(const Options& options) : m_options(options) {
+    jobs::initialize(m_options.threadCount);
+    m_manifestPath = (fs::path(m_options.outputDirectory) / ".cookmanifest").string();
+}
+
+bool cook::Cooker::run(const std::vector<std::string>& inputs) {
+    std::error_code error;
+    fs::create_directories(m_options.outputDirectory, error);
+    if (error) {
+        std::cout << "Error::Cook::Could not create " << m_options.outputDirectory << ": " << error.message() << std::endl;
+        return false;
+    }
+    if (!m_options.force) m_graph.load(m_manifestPath);
+
+    std::vector<Source> models, images;
+    for (const std::string& input : inputs) collectSources(input, models, images);
+
+    for (const Source& image : images) {
+        std::string output = (fs::path(m_options.outputDirectory) / (image.name + ".mtex")).string();
+        queueTexture({ fs::absolute(image.path).lexically_normal().string(), output, "diffuse" });
+    }
+
+    parallelFor(models.size(), [&](size_t i) {
+        if (!cookModel(models[i])) m_failed++;
+    });
+
+    std::vector<TextureJob> textures;
+    for (auto& entry : m_textureJobs) textures.push_back(entry.second);
+
+    parallelFor(textures.size(), [&](size_t i) {
+        if (!cookTexture(textures[i])) m_failed++;
+    });
+
+    if (!m_graph.save(m_manifestPath)) {
+        std::cout << "Error::Cook::Could not write " << m_manifestPath << std::endl;
+    }
+
+    std::cout << "Cooked " << m_cooked << ", up to date " << m_skipped << ", failed " << m_failed << std::endl;
+    return m_failed == 0;
+}
+
+void cook::Cooker::collectSources(const std::string& input, std::vector<Source>& models, std::vector<Source>& images) {
+    std::error_code error;
+    fs::path root(input);
+
+    auto add = [&](const fs::path& file, const fs::path& relative) {
+        std::string name = relative.parent_path().empty() ? relative.stem().string()
+                                                          : (relative.parent_path() / relative.stem()).string();
+        if (hasExtension(file, kModelExtensions)) models.push_back({ file.string(), name });
+        else if (hasExtension(file, kImageExtensions)) images.push_back({ file.string(), name });
+    };
+
+    if (fs::is_directory(root, error)) {
+        // Images inside a model directory are cooked through the models that use them
+        for (auto& entry : fs::recursive_directory_iterator(root, error)) {
+            if (!entry.is_regular_file() || !hasExtension(entry.path(), kModelExtensions)) continue;
+            add(entry.path(), fs::relative(entry.path(), root));
+        }
+    } else if (fs::is_regular_file(root, error)) {
+        add(root, root.filename());
+    } else {
+        std::cout << "Error::Cook::No such input " << input << std::endl;
+        m_failed++;
+    }
+}
+
+bool cook::Cooker::cookModel(const Source& source) {
+    const fs::path output = fs::path(m_options.outputDirectory) / (source.name + ".mcache");
+    const std::string outputPath = output.string();
+    const uint64_t settings = settingsHash("mesh");
+
+    if (!m_options.force && m_graph.isUpToDate(outputPath, settings)) {
+        DependencyNode previous;
+        m_graph.previousNode(outputPath, previous);
+        m_graph.record(previous);
+        queueChildren(outputPath);
+        m_skipped++;
+        return true;
+    }
+
+    RecordingIOSystem* ioSystem = new RecordingIOSystem();
+    Assimp::Importer importer;
+    importer.SetIOHandler(ioSystem);
+
+    const aiScene* scene = importer.ReadFile(source.path, aiProcess_Triangulate);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cout << "Error::Cook::" << source.path << ": " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+
+    std::vector<int> meshLookup(scene->mNumMeshes, -1);
+    std::vector<unsigned int> meshIndices;
+    std::vector<std::vector<simd::float4x4>> meshInstances;
+    collectMeshes(scene->mRootNode, matrix_identity_float4x4, meshLookup, meshIndices, meshInstances);
+
+    const fs::path sourceDirectory = fs::path(source.path).parent_path();
+    DependencyNode node;
+    node.output = outputPath;
+    node.parameters = "mesh";
+    node.settings = settings;
+
+    std::vector<meshCache::CachedMesh> cachedMeshes(meshIndices.size());
+    for (size_t m = 0; m < meshIndices.size(); m++) {
+        meshCache::CachedMesh& cached = cachedMeshes[m];
+        aiMesh* sceneMesh = scene->mMeshes[meshIndices[m]];
+        cached.endpoints = { -1, -1, -1, -1 };
+        cached.instances = std::move(meshInstances[m]);
+
+        importUtils::extractGeometry(sceneMesh, cached.vertices, cached.indices);
+        if (!tangentFrame::hasTangents(cached.vertices)) tangentFrame::generateTangents(cached.vertices, cached.indices);
+
+        if (sceneMesh->mMaterialIndex >= scene->mNumMaterials) continue;
+        importUtils::materialTextures(scene->mMaterials[sceneMesh->mMaterialIndex], cached.textures, cached.endpoints);
+
+        for (meshCache::CachedTexture& texture : cached.textures) {
+            if (!texture.path.empty() && texture.path[0] == '*') {
+                std::cout << "Warning::Cook::Embedded texture " << texture.path << " in " << source.path << " is not cooked" << std::endl;
+                continue;
+            }
+
+            std::string texturePath = (sourceDirectory / texture.path).lexically_normal().string();
+            TextureJob job = { texturePath, textureOutput(texturePath, texture.type), texture.type };
+            queueTexture(job);
+
+            if (std::find(node.children.begin(), node.children.end(), job.output) == node.children.end()) {
+                node.children.push_back(job.output);
+            }
+            texture.path = fs::relative(job.output, output.parent_path()).string();
+        }
+    }
+
+    std::error_code error;
+    fs::create_directories(output.parent_path(), error);
+    if (!meshCache::write(outputPath, cachedMeshes)) {
+        std::cout << "Error::Cook::Could not write " << outputPath << std::endl;
+        return false;
+    }
+
+    std::sort(ioSystem->opened.begin(), ioSystem->opened.end());
+    ioSystem->opened.erase(std::unique(ioSystem->opened.begin(), ioSystem->opened.end()), ioSystem->opened.end());
+    for (const std::string& input : ioSystem->opened) {
+        node.inputs.push_back({ input, m_graph.inputHash(input) });
+    }
+    m_graph.record(node);
+
+    std::cout << "Cooked " << source.path << " -> " << outputPath << std::endl;
+    m_cooked++;
+    return true;
+}
+
+bool cook::Cooker::cookTexture(const TextureJob& job) {
+    const std::string parameters = "texture " + job.role;
+    const uint64_t settings = settingsHash(parameters);
+
+    if (!m_options.force && m_graph.isUpToDate(job.output, settings)) {
+        DependencyNode previous;
+        m_graph.previousNode(job.output, previous);
+        m_graph.record(previous);
+        m_skipped++;
+        return true;
+    }
+
+    DependencyNode node;
+    node.output = job.output;
+    node.parameters = parameters;
+    node.settings = settings;
+    node.inputs.push_back({ job.source, m_graph.inputHash(job.source) });
+
+    std::error_code error;
+    fs::create_directories(fs::path(job.output).parent_path(), error);
+    if (!textureCooker::cook(job.source, job.output, job.role)) return false;
+
+    m_graph.record(node);
+    m_cooked++;
+    return true;
+}
+
+void cook::Cooker::queueTexture(const TextureJob& job) {
+    std::lock_guard<std::mutex> lock(m_textureMutex);
+    m_textureJobs.emplace(job.output, job);
+}
+
+// A model that did not need cooking still owns its textures, rebuild their jobs
+// from the manifest so they get checked without importing the model
+void cook::Cooker::queueChildren(const std::string& output) {
+    DependencyNode node;
+    if (!m_graph.previousNode(output, node)) return;
+
+    for (const std::string& child : node.children) {
+        DependencyNode texture;
+        if (!m_graph.previousNode(child, texture) || texture.inputs.empty()) continue;
+
+        const std::string prefix = "texture ";
+        if (texture.parameters.compare(0, prefix.size(), prefix) != 0) continue;
+        queueTexture({ texture.inputs[0].first, child, texture.parameters.substr(prefix.size()) });
+    }
+}
+
+// Textures are named after their source plus a hash of source path and role, so the
+// same image used by several models is only cooked once
+std::string cook::Cooker::textureOutput(const std::string& source, const std::string& role) {
+    char suffix[17];
+    std::snprintf(suffix, sizeof(suffix), "%016" PRIx64, hashString(source + "|" + role));
+
+    std::string name = fs::path(source).stem().string() + "_" + std::string(suffix, 8) + ".mtex";
+    return (fs::path(m_options.outputDirectory) / "textures" / name).string();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "dependencyGraph.hpp"
+
+namespace cook {
+    struct Options {
+        std::string outputDirectory;
+        // 0 uses every hardware thread
+        unsigned int threadCount = 0;
+        // Ignore the manifest and cook everything
+        bool force = false;
+    };
+
+    // Turns source models and images into the runtime formats: models become .mcache
+    // files whose materials point at cooked .mtex textures. Models are cooked in
+    // parallel first, the textures they reference are deduplicated and cooked in a
+    // second parallel pass. Anything whose inputs hash the same as last time is skipped.
+    class Cooker {
+    public:
+        Cooker(const Options& options);
+
+        bool run(const std::vector<std::string>& inputs);
+
+    private:
+        struct Source {
+            std::string path;
+            // Output path relative to the output directory, without extension
+            std::string name;
+        };
+
+        struct TextureJob {
+            std::string source;
+            std::string output;
+            std::string role;
+        };
+
+        Options m_options;
+        std::string m_manifestPath;
+        DependencyGraph m_graph;
+
+        std::mutex m_textureMutex;
+        std::map<std::string, TextureJob> m_textureJobs;
+
+        std::atomic<int> m_cooked { 0 };
+        std::atomic<int> m_skipped { 0 };
+        std::atomic<int> m_failed { 0 };
+
+        void collectSources(const std::string& input, std::vector<Source>& models, std::vector<Source>& images);
+        bool cookModel(const Source& source);
+        bool cookTexture(const TextureJob& job);
+        void queueTexture(const TextureJob& job);
+        void queueChildren(const std::string& output);
+        std::string textureOutput(const std::string& source, const std::string& role);
+    };
+}
@@ -0,0 +1,170 @@
+#include "dependencyGraph.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "../utility/fileIO.h"
+
+namespace {
+    constexpr uint64_t kHashPrime = 0x100000001B3ull;
+    constexpr uint64_t kHashMultiplier = 0x9E3779B97F4A7C15ull;
+
+    inline uint64_t mix(uint64_t hash, uint64_t value) {
+        hash ^= value * kHashMultiplier;
+        hash = (hash << 27) | (hash >> 37);
+        return hash * kHashPrime + 0x52DCE729;
+    }
+
+    uint64_t hashBytes(const unsigned char* data, size_t size, uint64_t seed) {
+        uint64_t lanes[4] = { seed ^ 0xCBF29CE484222325ull, seed + 1, seed + 2, seed + 3 };
+
+        // Four independent lanes keep the multiplies pipelined on large files
+        size_t offset = 0;
+        for (; offset + 32 <= size; offset += 32) {
+            for (int lane = 0; lane < 4; lane++) {
+                uint64_t word;
+                std::memcpy(&word, data + offset + lane * 8, sizeof(word));
+                lanes[lane] = mix(lanes[lane], word);
+            }
+        }
+        for (; offset + 8 <= size; offset += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + offset, sizeof(word));
+            lanes[0] = mix(lanes[0], word);
+        }
+        uint64_t tail = 0;
+        if (size > offset) std::memcpy(&tail, data + offset, size - offset);
+
+        uint64_t hash = mix(lanes[0], tail);
+        for (int lane = 1; lane < 4; lane++) hash = mix(hash, lanes[lane]);
+        hash = mix(hash, size);
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+}
+
+uint64_t cook::hashFile(const std::string& path) {
+    util::MappedFile file(path);
+    if (!file.isValid()) {
+        // Empty files map to nothing, still give them a stable hash
+        std::error_code error;
+        return std::filesystem::is_regular_file(path, error) ? hashBytes(nullptr, 0, 1) : 0;
+    }
+    return hashBytes(file.data(), file.size(), 1);
+}
+
+uint64_t cook::hashString(const std::string& value, uint64_t seed) {
+    return hashBytes(reinterpret_cast<const unsigned char*>(value.data()), value.size(), seed);
+}
+
+// Manifest format, one record per line:
+//   node <settings> <output>
+//   param <parameters>
+//   input <hash> <path>
+//   child <output>
+bool cook::DependencyGraph::load(const std::string& path) {
+    std::ifstream stream(path);
+    if (!stream) return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    DependencyNode* node = nullptr;
+    std::string line;
+    while (std::getline(stream, line)) {
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+
+        if (kind == "node") {
+            uint64_t settings;
+            std::string output;
+            fields >> std::hex >> settings >> std::ws;
+            std::getline(fields, output);
+            node = &m_previous[output];
+            node->output = output;
+            node->settings = settings;
+        } else if (kind == "param" && node) {
+            fields >> std::ws;
+            std::getline(fields, node->parameters);
+        } else if (kind == "input" && node) {
+            uint64_t hash;
+            std::string input;
+            fields >> std::hex >> hash >> std::ws;
+            std::getline(fields, input);
+            node->inputs.push_back({ input, hash });
+        } else if (kind == "child" && node) {
+            std::string child;
+            fields >> std::ws;
+            std::getline(fields, child);
+            node->children.push_back(child);
+        }
+    }
+    return true;
+}
+
+bool cook::DependencyGraph::save(const std::string& path) const {
+    std::ofstream stream(path, std::ios::trunc);
+    if (!stream) return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    char hex[17];
+    for (const auto& entry : m_current) {
+        const DependencyNode& node = entry.second;
+        std::snprintf(hex, sizeof(hex), "%016" PRIx64, node.settings);
+        stream << "node " << hex << " " << node.output << "\n";
+        if (!node.parameters.empty()) stream << "param " << node.parameters << "\n";
+        for (const auto& input : node.inputs) {
+            std::snprintf(hex, sizeof(hex), "%016" PRIx64, input.second);
+            stream << "input " << hex << " " << input.first << "\n";
+        }
+        for (const std::string& child : node.children) {
+            stream << "child " << child << "\n";
+        }
+    }
+    return (bool)stream;
+}
+
+bool cook::DependencyGraph::isUpToDate(const std::string& output, uint64_t settings) {
+    DependencyNode node;
+    if (!previousNode(output, node) || node.settings != settings) return false;
+
+    std::error_code error;
+    if (!std::filesystem::exists(output, error)) return false;
+
+    for (const auto& input : node.inputs) {
+        if (inputHash(input.first) != input.second) return false;
+    }
+    return true;
+}
+
+bool cook::DependencyGraph::previousNode(const std::string& output, DependencyNode& node) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_previous.find(output);
+    if (found == m_previous.end()) return false;
+    node = found->second;
+    return true;
+}
+
+void cook::DependencyGraph::record(const DependencyNode& node) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_current[node.output] = node;
+}
+
+uint64_t cook::DependencyGraph::inputHash(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_hashes.find(path);
+        if (found != m_hashes.end()) return found->second;
+    }
+
+    // Hash outside the lock, two threads racing on the same file get the same answer
+    uint64_t hash = hashFile(path);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hashes[path] = hash;
+    return hash;
+}
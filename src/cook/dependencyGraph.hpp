@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cook {
+    // 64-bit content hash of a whole file, 0 when it cannot be read
+    uint64_t hashFile(const std::string& path);
+    uint64_t hashString(const std::string& value, uint64_t seed = 0);
+
+    struct DependencyNode {
+        std::string output;
+        // Everything that is not a file but changes the output, e.g. a texture's role.
+        // settings is its hash combined with the cooker version.
+        std::string parameters;
+        uint64_t settings = 0;
+        std::vector<std::pair<std::string, uint64_t>> inputs;
+        // Outputs this node references, e.g. the textures a mesh cache points at
+        std::vector<std::string> children;
+    };
+
+    // Outputs of the previous cook and the content hashes they were built from,
+    // persisted next to the cooked data. Lookups and records are thread safe.
+    class DependencyGraph {
+    public:
+        bool load(const std::string& path);
+        bool save(const std::string& path) const;
+
+        // True when the output exists and was cooked from exactly these settings and inputs
+        bool isUpToDate(const std::string& output, uint64_t settings);
+        bool previousNode(const std::string& output, DependencyNode& node) const;
+        void record(const DependencyNode& node);
+
+        // Memoized per run so shared inputs are only read once
+        uint64_t inputHash(const std::string& path);
+
+    private:
+        mutable std::mutex m_mutex;
+        std::unordered_map<std::string, DependencyNode> m_previous;
+        std::unordered_map<std::string, DependencyNode> m_current;
+        std::unordered_map<std::string, uint64_t> m_hashes;
+    };
+}
@@ -0,0 +1,44 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cooker.hpp"
+
+namespace {
+    void printUsage() {
+        std::cout << "Usage: metal_engine_cook [-f] [-j threads] <output directory> <model|image|directory>..." << std::endl;
+        std::cout << "  -f          cook everything, ignoring the previous manifest" << std::endl;
+        std::cout << "  -j threads  worker threads, defaults to the hardware thread count" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    cook::Options options;
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-f") == 0) {
+            options.force = true;
+        } else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            options.threadCount = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "-h") == 0 || std::strcmp(argv[i], "--help") == 0) {
+            printUsage();
+            return 0;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+
+    if (positional.size() < 2) {
+        printUsage();
+        return 1;
+    }
+
+    options.outputDirectory = positional[0];
+    positional.erase(positional.begin());
+
+    cook::Cooker cooker(options);
+    return cooker.run(positional) ? 0 : 1;
+}
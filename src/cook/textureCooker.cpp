@@ -0,0 +1,156 @@
+#include "textureCooker.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stb/stb_image.h>
+#include <vector>
+
+#include "blockCompression.hpp"
+#include "../utility/cookedTexture.hpp"
+
+namespace {
+    struct Pixels {
+        uint32_t width;
+        uint32_t height;
+        int channels;
+        std::vector<float> values;
+    };
+
+    float srgbToLinear(float value) {
+        value /= 255.0f;
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float linearToSrgb(float value) {
+        value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+        return value * 255.0f;
+    }
+
+    // 2x2 box filter, the last row/column is reused when a dimension is odd
+    Pixels downsample(const Pixels& source) {
+        Pixels result;
+        result.width = std::max(1u, source.width / 2);
+        result.height = std::max(1u, source.height / 2);
+        result.channels = source.channels;
+        result.values.resize((size_t)result.width * result.height * result.channels);
+
+        for (uint32_t y = 0; y < result.height; y++) {
+            uint32_t y0 = std::min(y * 2, source.height - 1), y1 = std::min(y * 2 + 1, source.height - 1);
+            for (uint32_t x = 0; x < result.width; x++) {
+                uint32_t x0 = std::min(x * 2, source.width - 1), x1 = std::min(x * 2 + 1, source.width - 1);
+                for (int c = 0; c < source.channels; c++) {
+                    auto at = [&](uint32_t sx, uint32_t sy) {
+                        return source.values[((size_t)sy * source.width + sx) * source.channels + c];
+                    };
+                    result.values[((size_t)y * result.width + x) * result.channels + c] =
+                        0.25f * (at(x0, y0) + at(x1, y0) + at(x0, y1) + at(x1, y1));
+                }
+            }
+        }
+        return result;
+    }
+
+    // Averaged normals shrink, push them back onto the unit sphere
+    void renormalize(Pixels& pixels) {
+        for (size_t i = 0; i < (size_t)pixels.width * pixels.height; i++) {
+            float* normal = &pixels.values[i * pixels.channels];
+            float x = normal[0] * 2.0f - 1.0f, y = normal[1] * 2.0f - 1.0f, z = normal[2] * 2.0f - 1.0f;
+            float length = std::sqrt(x * x + y * y + z * z);
+            if (length < 1e-6f) continue;
+            normal[0] = (x / length) * 0.5f + 0.5f;
+            normal[1] = (y / length) * 0.5f + 0.5f;
+            normal[2] = (z / length) * 0.5f + 0.5f;
+        }
+    }
+
+    std::vector<unsigned char> quantize(const Pixels& pixels, bool srgb) {
+        std::vector<unsigned char> bytes(pixels.values.size());
+        for (size_t i = 0; i < pixels.values.size(); i++) {
+            bool colorChannel = srgb && (i % pixels.channels) < 3;
+            float value = colorChannel ? linearToSrgb(pixels.values[i]) : pixels.values[i] * 255.0f;
+            bytes[i] = (unsigned char)std::clamp((int)std::lround(value), 0, 255);
+        }
+        return bytes;
+    }
+
+    std::vector<unsigned char> compress(const std::vector<unsigned char>& bytes, uint32_t width, uint32_t height, int channels,
+                                        cookedTexture::Format format) {
+        if (!cookedTexture::isBlockCompressed(format)) return bytes;
+
+        std::vector<unsigned char> output(cookedTexture::levelSize(format, width, height));
+        const size_t blockBytes = format == cookedTexture::Format::BC3 ? 16 : 8;
+        const uint32_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+
+        unsigned char block[16 * 4];
+        for (uint32_t by = 0; by < blocksHigh; by++) {
+            for (uint32_t bx = 0; bx < blocksWide; bx++) {
+                for (uint32_t i = 0; i < 16; i++) {
+                    uint32_t x = std::min(bx * 4 + (i & 3), width - 1), y = std::min(by * 4 + (i >> 2), height - 1);
+                    for (int c = 0; c < channels; c++) block[i * channels + c] = bytes[((size_t)y * width + x) * channels + c];
+                }
+
+                unsigned char* destination = output.data() + ((size_t)by * blocksWide + bx) * blockBytes;
+                switch (format) {
+                    case cookedTexture::Format::BC1: blockCompression::encodeBC1(block, destination); break;
+                    case cookedTexture::Format::BC3: blockCompression::encodeBC3(block, destination); break;
+                    case cookedTexture::Format::BC4: blockCompression::encodeBC4(block, destination); break;
+                    default: break;
+                }
+            }
+        }
+        return output;
+    }
+}
+
+bool textureCooker::cook(const std::string& sourcePath, const std::string& outputPath, const std::string& role) {
+    int width, height, nrComponents;
+    if (!stbi_info(sourcePath.c_str(), &width, &height, &nrComponents)) {
+        std::cout << "Error::Cook::Could not read image " << sourcePath << std::endl;
+        return false;
+    }
+
+    const bool normalMap = role == "normal";
+    const int channels = (nrComponents == 1 && !normalMap) ? 1 : 4;
+    unsigned char* data = stbi_load(sourcePath.c_str(), &width, &height, &nrComponents, channels);
+    if (!data) {
+        std::cout << "Error::Cook::Could not decode image " << sourcePath << std::endl;
+        return false;
+    }
+
+    // Colour data is filtered in linear space, normals and masks as stored
+    const bool srgb = role == "diffuse" && channels == 4;
+    bool opaque = true;
+
+    Pixels level;
+    level.width = (uint32_t)width;
+    level.height = (uint32_t)height;
+    level.channels = channels;
+    level.values.resize((size_t)width * height * channels);
+    for (size_t i = 0; i < level.values.size(); i++) {
+        bool colorChannel = (int)(i % channels) < 3;
+        level.values[i] = (srgb && colorChannel) ? srgbToLinear(data[i]) : data[i] / 255.0f;
+        if (channels == 4 && !colorChannel && data[i] != 255) opaque = false;
+    }
+    stbi_image_free(data);
+
+    cookedTexture::Image image;
+    if (channels == 1) image.format = cookedTexture::Format::BC4;
+    else if (normalMap) image.format = cookedTexture::Format::RGBA8;
+    else image.format = opaque ? cookedTexture::Format::BC1 : cookedTexture::Format::BC3;
+
+    while (true) {
+        std::vector<unsigned char> bytes = quantize(level, srgb);
+        image.mips.push_back({ level.width, level.height, compress(bytes, level.width, level.height, channels, image.format) });
+
+        if (level.width == 1 && level.height == 1) break;
+        level = downsample(level);
+        if (normalMap) renormalize(level);
+    }
+
+    if (!cookedTexture::write(outputPath, image)) {
+        std::cout << "Error::Cook::Could not write " << outputPath << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+namespace textureCooker {
+    // Loads an image, builds its mip chain and writes it as a .mtex. The role is the
+    // material slot the texture is bound to ("diffuse", "specular", "normal") and
+    // picks the filtering and compression.
+    bool cook(const std::string& sourcePath, const std::string& outputPath, const std::string& role);
+}
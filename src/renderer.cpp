@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <cassert>
 #include <simd/simd.h>
@@ -5,6 +6,10 @@
 #include "utility/math.h"
 #include "utility/fileIO.h"
 #include "utility/importUtils.hpp"
+#include "utility/instanceBatch.hpp"
+#include "utility/jobSystem.hpp"
+#include "utility/textureBudget.hpp"
+#include "utility/vertexFormat.hpp"
 
 #include "imgui.h"
 #include "imgui_impl_metal.h"
@@ -16,7 +21,9 @@
 #include "renderer.h"
 #include <SDL2/SDL.h>
 #include <thread>
-#include <future>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
 
 const int Renderer::kMaxFramesInFlight = 3;
 
@@ -40,30 +47,26 @@ namespace shader_types {
         simd::float4x4 modifiedView;
     };
 
-    struct DirectionalLight {
-        simd::float3 direction;
-        simd::float3 diffuse;
-        simd::float3 specular;
-        simd::float3 ambient;
-    };
-
-    struct PointLight {
-        simd::float3 position;
-        simd::float3 diffuse;
-        simd::float3 specular;
-        simd::float3 ambient;
-    };
-
     struct LightInfo {
         simd::int1 numPoints;
         simd::int1 numDirections;
+        simd::float2 tileScale;
+        uint32_t tilesX;
+        uint32_t tilesY;
+        uint32_t slices;
+        float sliceScale;
+        float sliceBias;
     };
 }
 
 Renderer::Renderer() : 
     m_angle(0.0f),
     m_frame(0),
-    m_animationIndex(0) {
+    m_animationIndex(0),
+    m_dirLights(kMaxFramesInFlight),
+    m_pointLights(kMaxFramesInFlight),
+    m_clusterRanges(kMaxFramesInFlight),
+    m_clusterIndices(kMaxFramesInFlight) {
     initWindow();
     m_commandQueue = m_device->newCommandQueue();
     m_camera = Camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -93,9 +96,6 @@ Renderer::~Renderer() {
     for (int i = 0; i < kMaxFramesInFlight; i++) {
         m_instanceDataBuffer[i]->release();
     }
-    for (int i = 0; i < kMaxFramesInFlight; i++) {
-        m_cameraDataBuffer[i]->release();
-    }
 
     m_indexBuffer->release();
     m_computeState->release();
@@ -153,7 +153,15 @@ void Renderer::run() {
     SDL_Event event;
     bool done = false;
     
+    FrameInput input;
+    startSimulation();
+    requestSimulation(input);
+    
+    uint64_t frame = 0;
     while (!done) {
+        input.deltaTime = m_cameraInfo.deltaTime;
+        input.cameraEvents.clear();
+        
         while (SDL_PollEvent(&event)) {
             ImGui_ImplSDL2_ProcessEvent(&event);
             
@@ -164,10 +172,10 @@ void Renderer::run() {
             } else if (event.type == SDL_KEYDOWN) {
                 SDL_Keycode type = event.key.keysym.sym;
                 
-                if (type == SDLK_LEFT) m_camera.processKeyboard(LEFT, m_cameraInfo.deltaTime);
-                if (type == SDLK_RIGHT) m_camera.processKeyboard(RIGHT, m_cameraInfo.deltaTime);
-                if (type == SDLK_UP) m_camera.processKeyboard(FORWARD, m_cameraInfo.deltaTime);
-                if (type == SDLK_DOWN) m_camera.processKeyboard(BACKWARD, m_cameraInfo.deltaTime);
+                if (type == SDLK_LEFT) input.cameraEvents.push_back({ FrameInput::CameraEvent::Move, LEFT });
+                if (type == SDLK_RIGHT) input.cameraEvents.push_back({ FrameInput::CameraEvent::Move, RIGHT });
+                if (type == SDLK_UP) input.cameraEvents.push_back({ FrameInput::CameraEvent::Move, FORWARD });
+                if (type == SDLK_DOWN) input.cameraEvents.push_back({ FrameInput::CameraEvent::Move, BACKWARD });
             } else if (event.type == SDL_MOUSEMOTION) {
                 float mouseX = event.motion.x;
                 float mouseY = event.motion.y;
@@ -183,28 +191,336 @@ void Renderer::run() {
                 
                 m_cameraInfo.lastX = mouseX;
                 m_cameraInfo.lastY = mouseY;
-                m_camera.processMouseMovement(xoffset, yoffset);
+                input.cameraEvents.push_back({ FrameInput::CameraEvent::Look, LEFT, xoffset, yoffset });
             } else if (event.type == SDL_MOUSEWHEEL) {
                 float scrollY = event.wheel.y;
-                m_camera.processMouseScroll(scrollY);
+                input.cameraEvents.push_back({ FrameInput::CameraEvent::Zoom, LEFT, 0.0f, scrollY });
             }
             
         }
         
+        jobs::pumpMainThread();
+        // Everything this frame reads of the models comes from one snapshot
+        m_scenePinnedFrame = frame + 1;
+        m_scene = m_sceneModels.pin(m_scenePinnedFrame);
+        updateSceneBvh();
+        
         float currentFrame = static_cast<float>(SDL_GetTicks());
         m_cameraInfo.deltaTime = currentFrame - m_cameraInfo.lastFrame;
         m_cameraInfo.deltaTime *= 0.1;
         m_cameraInfo.lastFrame = currentFrame;
         
+        // The snapshot for this frame was simulated while the last one was encoded,
+        // the next one is simulated from this frame's input while this one is encoded
+        const FrameSnapshot& snapshot = waitForSnapshot(++frame);
+        requestSimulation(input);
+        
         int width = 0, height = 0;
         SDL_GetRendererOutputSize(m_renderer, &width, &height);
         
         m_layer->setDrawableSize(CGSizeMake(width, height));
         
         auto layer = m_layer->nextDrawable();
-        drawModelOnly(layer);
+        drawModelOnly(layer, snapshot);
         layer->release();
     }
+    
+    stopSimulation();
+}
+
+void Renderer::startSimulation() {
+    m_simulationStopping = false;
+    m_simulationRequested = 0;
+    m_simulationCompleted = 0;
+    m_simulationThread = std::thread(&Renderer::simulationLoop, this);
+}
+
+void Renderer::stopSimulation() {
+    {
+        std::lock_guard<std::mutex> lock(m_simulationMutex);
+        m_simulationStopping = true;
+    }
+    m_simulationWake.notify_all();
+    if (m_simulationThread.joinable()) m_simulationThread.join();
+}
+
+// Swaps rather than copies, input comes back holding last step's vectors to refill
+void Renderer::requestSimulation(FrameInput& input) {
+    {
+        std::lock_guard<std::mutex> lock(m_simulationMutex);
+        std::swap(m_simulationInput, input);
+        m_simulationRequested++;
+    }
+    m_simulationWake.notify_all();
+}
+
+const FrameSnapshot& Renderer::waitForSnapshot(uint64_t frame) {
+    {
+        std::unique_lock<std::mutex> lock(m_simulationMutex);
+        m_simulationWake.wait(lock, [this, frame]() { return m_simulationCompleted >= frame; });
+    }
+    m_snapshots.acquire();
+    return m_snapshots.front();
+}
+
+void Renderer::simulationLoop() {
+    FrameInput input;
+    
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_simulationMutex);
+            m_simulationWake.wait(lock, [this]() { return m_simulationStopping || m_simulationRequested > m_simulationCompleted; });
+            if (m_simulationStopping) return;
+            std::swap(input, m_simulationInput);
+        }
+        
+        FrameSnapshot& snapshot = m_snapshots.back();
+        simulate(input, snapshot);
+        m_snapshots.publish();
+        
+        {
+            std::lock_guard<std::mutex> lock(m_simulationMutex);
+            m_simulationCompleted++;
+        }
+        m_simulationWake.notify_all();
+    }
+}
+
+void Renderer::simulate(const FrameInput& input, FrameSnapshot& snapshot) {
+    for (const FrameInput::CameraEvent& cameraEvent : input.cameraEvents) {
+        switch (cameraEvent.type) {
+            case FrameInput::CameraEvent::Move: m_camera.processKeyboard(cameraEvent.direction, input.deltaTime); break;
+            case FrameInput::CameraEvent::Look: m_camera.processMouseMovement(cameraEvent.x, cameraEvent.y); break;
+            case FrameInput::CameraEvent::Zoom: m_camera.processMouseScroll(cameraEvent.y); break;
+        }
+    }
+    
+    snapshot.frame = m_simulationCompleted + 1;
+    snapshot.cameraPosition = m_camera.getPosition();
+    snapshot.view = m_camera.getViewMatrix();
+    snapshot.perspective = m_camera.getPerspectiveMatrix(1280.0 / 720.0);
+    snapshot.modifiedView = m_camera.getModifiedView();
+    snapshot.frustum = culling::makeFrustum(simd_mul(snapshot.perspective, snapshot.view));
+    
+    m_angle += 0.002f;
+    snapshot.angle = m_angle;
+}
+
+// Rebuilds when models come or go, otherwise refits the models whose bounds changed.
+// A model replaced by a new snapshot counts as changed even if its version matches.
+void Renderer::updateSceneBvh() {
+    const size_t modelCount = m_scene->models.size();
+    bool rebuild = m_sceneVersions.size() != modelCount;
+    for (size_t i = 0; i < modelCount && !rebuild; i++) {
+        rebuild = sceneModel(i).instanceCount() != m_sceneFirstItem[i + 1] - m_sceneFirstItem[i];
+    }
+    
+    if (rebuild) {
+        std::unordered_map<const void*, uint32_t> geometryIds;
+        m_sceneFirstItem.assign(1, 0);
+        m_sceneFirstMesh.assign(1, 0);
+        m_sceneMeshGeometry.clear();
+        for (const std::shared_ptr<const Model>& model : m_scene->models) {
+            m_sceneFirstItem.push_back(m_sceneFirstItem.back() + (uint32_t)model->instanceCount());
+            m_sceneFirstMesh.push_back(m_sceneFirstMesh.back() + (uint32_t)model->meshCount());
+            for (size_t mesh = 0; mesh < model->meshCount(); mesh++) {
+                m_sceneMeshGeometry.push_back(geometryIds.emplace(model->meshGeometry(mesh), (uint32_t)geometryIds.size()).first->second);
+            }
+        }
+        m_sceneVersions.assign(modelCount, 0);
+        m_sceneRefs.assign(modelCount, nullptr);
+        m_sceneBvh.resize(m_sceneFirstItem.back());
+    }
+    
+    for (size_t i = 0; i < modelCount; i++) {
+        const Model& model = sceneModel(i);
+        if (!rebuild && &model == m_sceneRefs[i] && model.boundsVersion() == m_sceneVersions[i]) continue;
+        
+        const culling::BoxSet& boxes = model.instanceBounds();
+        for (size_t box = 0; box < boxes.count; box++) {
+            simd::float3 center = simd_make_float3(boxes.centerX[box], boxes.centerY[box], boxes.centerZ[box]);
+            simd::float3 extent = simd_make_float3(boxes.extentX[box], boxes.extentY[box], boxes.extentZ[box]);
+            m_sceneBvh.setItem(m_sceneFirstItem[i] + (uint32_t)box, center - extent, center + extent);
+        }
+        m_sceneVersions[i] = model.boundsVersion();
+        m_sceneRefs[i] = &model;
+    }
+    
+    if (rebuild) m_sceneBvh.build();
+    else m_sceneBvh.refit();
+}
+
+// Drops visible instances hidden behind the largest visible ones, m_sceneVisible stays sorted
+size_t Renderer::cullOccluded(const FrameSnapshot& snapshot) {
+    constexpr size_t kMaxOccluderTriangles = 16384;
+    // Anything denser is not worth rasterizing on the CPU without a simplified version
+    constexpr size_t kMaxMeshTriangles = 2048;
+    
+    const simd::float4x4 viewProjection = simd_mul(snapshot.perspective, snapshot.view);
+    auto modelOf = [this](uint32_t item) {
+        return std::upper_bound(m_sceneFirstItem.begin(), m_sceneFirstItem.end(), item) - m_sceneFirstItem.begin() - 1;
+    };
+    
+    m_occluders.clear();
+    for (uint32_t item : m_sceneVisible) {
+        const size_t model = modelOf(item);
+        const uint32_t box = item - m_sceneFirstItem[model];
+        const size_t triangles = sceneModel(model).occluderTriangles(box);
+        if (triangles == 0 || triangles > kMaxMeshTriangles) continue;
+        
+        const culling::BoxSet& boxes = sceneModel(model).instanceBounds();
+        simd::float3 center = simd_make_float3(boxes.centerX[box], boxes.centerY[box], boxes.centerZ[box]);
+        simd::float3 extent = simd_make_float3(boxes.extentX[box], boxes.extentY[box], boxes.extentZ[box]);
+        float distance = std::max(simd::length(center - snapshot.cameraPosition), 1e-3f);
+        m_occluders.push_back({ simd::length(extent) / distance, item });
+    }
+    std::sort(m_occluders.begin(), m_occluders.end(), std::greater<>());
+    
+    m_occlusionBuffer.clear();
+    size_t triangles = 0;
+    for (const auto& occluder : m_occluders) {
+        const size_t model = modelOf(occluder.second);
+        const uint32_t box = occluder.second - m_sceneFirstItem[model];
+        triangles += sceneModel(model).occluderTriangles(box);
+        if (triangles > kMaxOccluderTriangles) break;
+        sceneModel(model).addOccluder(m_occlusionBuffer, box, viewProjection);
+    }
+    if (m_occlusionBuffer.triangleCount() == 0) return 0;
+    m_occlusionBuffer.rasterize();
+    
+    const size_t visibleCount = m_sceneVisible.size();
+    m_sceneVisible.erase(std::remove_if(m_sceneVisible.begin(), m_sceneVisible.end(), [&](uint32_t item) {
+        const size_t model = modelOf(item);
+        const uint32_t box = item - m_sceneFirstItem[model];
+        const culling::BoxSet& boxes = sceneModel(model).instanceBounds();
+        simd::float3 center = simd_make_float3(boxes.centerX[box], boxes.centerY[box], boxes.centerZ[box]);
+        simd::float3 extent = simd_make_float3(boxes.extentX[box], boxes.extentY[box], boxes.extentZ[box]);
+        return m_occlusionBuffer.isOccluded(viewProjection, center - extent, center + extent);
+    }), m_sceneVisible.end());
+    return visibleCount - m_sceneVisible.size();
+}
+
+// Keys put draws in state order and group instances of the same geometry and material, copies of
+// a model included. Every group becomes one instanced draw reading the per-frame instance buffer.
+void Renderer::drawVisible(StateEncoder& encoder, const FrameSnapshot& snapshot) {
+    constexpr uint32_t kOpaquePass = 0;
+    constexpr uint32_t kModelPipeline = 0;
+    
+    m_drawItems.clear();
+    size_t model = 0;
+    for (uint32_t item : m_sceneVisible) {
+        while (item >= m_sceneFirstItem[model + 1]) model++;
+        const uint32_t box = item - m_sceneFirstItem[model];
+        const culling::BoxSet& boxes = sceneModel(model).instanceBounds();
+        simd::float3 center = simd_make_float3(boxes.centerX[box], boxes.centerY[box], boxes.centerZ[box]);
+        
+        uint32_t depth = drawSort::depthBucket(simd::length(center - snapshot.cameraPosition), NEAR_PLANE, FAR_PLANE);
+        uint32_t mesh = m_sceneMeshGeometry[m_sceneFirstMesh[model] + sceneModel(model).meshOf(box)];
+        uint64_t key = drawSort::makeKey(kOpaquePass, kModelPipeline, sceneModel(model).materialOf(box), mesh, depth);
+        m_drawItems.push_back({ key, item });
+    }
+    drawSort::radixSort(m_drawItems, m_drawScratch);
+    
+    // One entry per sorted draw, filled in while recording
+    FrameAllocator::Allocation instanceData = m_frameAllocator.allocate(std::max<size_t>(1, m_drawItems.size()) * sizeof(MeshInstance));
+    MeshInstance* instances = instanceData.as<MeshInstance>();
+    
+    // Chunks are recorded on the job system, each starting from unknown binding state
+    const size_t chunkCount = (m_drawItems.size() + kDrawsPerCommandList - 1) / kDrawsPerCommandList;
+    m_commandLists.resize(chunkCount);
+    jobs::parallelFor(chunkCount, 1, [this, instances, &instanceData](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; chunk++) {
+            m_commandLists[chunk].clear();
+            m_commandLists[chunk].setVertexBuffer(instanceData.buffer, instanceData.offset, 1);
+            recordDraws(m_commandLists[chunk], chunk * kDrawsPerCommandList,
+                        std::min(m_drawItems.size(), (chunk + 1) * kDrawsPerCommandList), instances);
+        }
+    });
+    m_drawCalls = 0;
+    m_stateChanges = 0;
+    for (const gfx::CommandList& commands : m_commandLists) {
+        gfx::replay(commands, encoder);
+        m_drawCalls += commands.drawCount();
+        m_stateChanges += commands.commandCount() - commands.drawCount();
+    }
+    
+    if (m_validateCommands) {
+        gfx::ValidationResult validation = gfx::validate(m_commandLists);
+        if (validation.errors) std::cout << "Error::Renderer::" << validation.errors << " invalid commands, " << validation.firstError << "\n";
+    }
+}
+
+// Instance data of sorted draw i goes to instances[i], so chunks fill their own ranges
+void Renderer::recordDraws(gfx::CommandList& commands, size_t begin, size_t end, MeshInstance* instances) const {
+    auto locate = [this](uint32_t item, uint32_t& box) -> const Model& {
+        const size_t model = std::upper_bound(m_sceneFirstItem.begin(), m_sceneFirstItem.end(), item) - m_sceneFirstItem.begin() - 1;
+        box = item - m_sceneFirstItem[model];
+        return sceneModel(model);
+    };
+    
+    // Keys only hold the low bits of material and mesh, so a run also has to match them in full
+    uint32_t boundMaterial = UINT32_MAX;
+    const void* boundGeometry = nullptr;
+    for (size_t i = begin; i < end;) {
+        uint32_t box;
+        const Model& model = locate(m_drawItems[i].value, box);
+        const uint64_t batch = drawSort::batch(m_drawItems[i].key);
+        const uint32_t material = model.materialOf(box);
+        const void* geometry = model.meshGeometry(model.meshOf(box));
+        
+        size_t run = 0;
+        for (; i + run < end && drawSort::batch(m_drawItems[i + run].key) == batch; run++) {
+            uint32_t instanceBox;
+            const Model& instanceModel = locate(m_drawItems[i + run].value, instanceBox);
+            if (instanceModel.materialOf(instanceBox) != material || instanceModel.meshGeometry(instanceModel.meshOf(instanceBox)) != geometry) break;
+            instances[i + run] = instanceModel.instanceData(instanceBox);
+        }
+        
+        if (material != boundMaterial) {
+            commands.setFragmentBytes(&material, sizeof(uint32_t), 5);
+            boundMaterial = material;
+        }
+        if (geometry != boundGeometry) {
+            model.bindMesh(commands, box);
+            boundGeometry = geometry;
+        }
+        model.drawMesh(commands, box, (uint32_t)i, (uint32_t)run);
+        i += run;
+    }
+}
+
+// Shares the geometry, textures and materials of a pinned model, next to its last copy
+void Renderer::placeCopy(size_t model) {
+    auto copy = std::make_shared<Model>(sceneModel(model));
+    
+    // Placed against the newest scene, which may already hold copies the pinned one lacks
+    m_sceneModels.update([&copy](Scene& scene) {
+        simd::float4x4 placement = copy->placement();
+        for (const std::shared_ptr<const Model>& other : scene.models) {
+            if (other->path() != copy->path()) continue;
+            float spacing = other->boundingRadius() * 2.2f;
+            placement.columns[3].x = std::max(placement.columns[3].x, other->placement().columns[3].x + spacing);
+        }
+        
+        copy->setPlacement(placement);
+        scene.models.push_back(std::move(copy));
+    });
+}
+
+// Published models never change, the edited node goes out on a copy that replaces the model.
+// The copy shares the meshes, only its transforms and bounds differ, and the BVH refits it.
+void Renderer::setNodeTransform(size_t model, uint32_t node, simd::float3 translation, simd::quatf rotation, simd::float3 scale) {
+    m_sceneModels.update([&](Scene& scene) {
+        if (model >= scene.models.size() || node >= scene.models[model]->transforms().size()) return;
+        
+        auto edited = std::make_shared<Model>(*scene.models[model]);
+        TransformHierarchy& transforms = edited->transforms();
+        transforms.setTranslation(node, translation);
+        transforms.setRotation(node, rotation);
+        transforms.setScale(node, scale);
+        edited->updateTransforms();
+        scene.models[model] = std::move(edited);
+    });
 }
 
 void Renderer::createLights() {
@@ -242,6 +558,10 @@ void Renderer::buildShaders() {
     descriptor->setFragmentFunction(fragmentFn);
     descriptor->colorAttachments()->object(0)->setPixelFormat(MTL::PixelFormat::PixelFormatBGRA8Unorm_sRGB);
     descriptor->setDepthAttachmentPixelFormat(MTL::PixelFormat::PixelFormatDepth16Unorm);
+    
+    MTL::VertexDescriptor* vertexDescriptor = vertexFormat::makeVertexDescriptor<Vertex>(0);
+    descriptor->setVertexDescriptor(vertexDescriptor);
+    vertexDescriptor->release();
 
     m_state = m_device->newRenderPipelineState(descriptor, &error);
     if (!m_state) {
@@ -384,16 +704,44 @@ void Renderer::buildBuffers() {
         m_instanceDataBuffer[i] = m_device->newBuffer(instanceDataSize, MTL::ResourceStorageModeManaged);
     }
 
-    const size_t cameraDataSize = kMaxFramesInFlight * sizeof(shader_types::CameraData);
-    for (size_t i = 0; i < kMaxFramesInFlight; i++) {
-        m_cameraDataBuffer[i] = m_device->newBuffer(cameraDataSize, MTL::ResourceStorageModeManaged);
+    // Grid layout, spin rates and colors never change, draw only animates the transforms
+    const float scl = 0.5f;
+    instanceBatch::resize(m_instanceField, kNumInstances);
+    m_instanceField.scale = scl;
+
+    size_t ix = 0, iy = 0, iz = 0;
+    for (size_t i = 0; i < kNumInstances; i++) {
+        if (ix == kInstanceRows) {
+            ix = 0;
+            iy += 1;
+        }
+        if (iy == kInstanceRows) {
+            iy = 0;
+            iz += 1;
+        }
+
+        m_instanceField.offsetX[i] = ((float)ix - (float)kInstanceRows/2.0f) * (2.0f * scl) + scl;
+        m_instanceField.offsetY[i] = ((float)iy - (float)kInstanceRows/2.0f) * (2.0f * scl) + scl;
+        m_instanceField.offsetZ[i] = ((float)iz - (float)kInstanceRows/2.0f) * (2.0f * scl) + scl;
+        m_instanceField.zSpin[i] = sinf((float)ix);
+        m_instanceField.ySpin[i] = cosf((float)iy);
+
+        float divNumInstances = i / (float)kNumInstances;
+        float r = divNumInstances,
+            g = 1.0f - r,
+            b = sinf(M_PI * 2.0f * divNumInstances);
+        for (size_t frame = 0; frame < kMaxFramesInFlight; frame++) {
+            shader_types::InstanceData* instanceData = reinterpret_cast<shader_types::InstanceData*>(m_instanceDataBuffer[frame]->contents());
+            instanceData[i].instanceColor = (simd::float4){r, g, b, 1.0f};
+        }
+
+        ix += 1;
     }
-    
-    const size_t dirLightSize = 10 * sizeof(shader_types::DirectionalLight);
-    m_dirLightsBuffer = m_device->newBuffer(dirLightSize, MTL::ResourceStorageModeManaged);
-    
-    const size_t pointLightSize = 10 * sizeof(shader_types::PointLight);
-    m_pointLightsBuffer = m_device->newBuffer(pointLightSize, MTL::ResourceStorageModeManaged);
+    for (size_t frame = 0; frame < kMaxFramesInFlight; frame++) {
+        m_instanceDataBuffer[frame]->didModifyRange(NS::Range::Make(0, kNumInstances * sizeof(shader_types::InstanceData)));
+    }
+
+    m_frameAllocator.init(m_device, kMaxFramesInFlight, 64 * 1024);
     
     m_textureAnimationBuffer = m_device->newBuffer(sizeof(uint), MTL::ResourceStorageModeManaged);
 }
@@ -522,7 +870,7 @@ void Renderer::importModel() {
 
 }
 
-void Renderer::draw(CA::MetalDrawable* drawable) {
+void Renderer::draw(CA::MetalDrawable* drawable, const FrameSnapshot& snapshot) {
     using simd::float4x4;
     using simd::float4;
     using simd::float3;
@@ -539,64 +887,34 @@ void Renderer::draw(CA::MetalDrawable* drawable) {
     cmd->addCompletedHandler([renderer](MTL::CommandBuffer* cmd) {
         dispatch_semaphore_signal(renderer->m_semaphore);
     });
+    m_frameAllocator.beginFrame(m_frame);
 
-    m_angle += 0.002f;
-
-    const float scl = 0.5f;
-    shader_types::InstanceData* instanceData = 
-        reinterpret_cast<shader_types::InstanceData*>(instanceDataBuffer->contents());
-
+    // Only this demo path draws the grid, so it is animated here rather than simulated every frame
     float3 objectPosition = { 0.0f, 0.0f, -5.0f };
 
     float4x4 rt = math::makeTranslate(objectPosition);
-    float4x4 rr1 = math::makeYRotate(-m_angle);
-    float4x4 rr0 = math::makeXRotate(m_angle * 0.5);
+    float4x4 rr1 = math::makeYRotate(-snapshot.angle);
+    float4x4 rr0 = math::makeXRotate(snapshot.angle * 0.5);
 
     float3 inverseVector = { -objectPosition.x, -objectPosition.y, -objectPosition.z};
     float4x4 rtInverse = math::makeTranslate(inverseVector);
     float4x4 fullObjectRotate = rt * rr1 * rr0 * rtInverse;
 
-    size_t ix = 0, iy = 0, iz = 0;
-    for (size_t i = 0; i < kNumInstances; i++) {
-        if (ix == kInstanceRows) {
-            ix = 0;
-            iy += 1;
-        }
-        if (iy == kInstanceRows) {
-            iy = 0;
-            iz += 1;
-        }
-
-        float4x4 scale = math::makeScale((float3){scl, scl, scl});
-        float4x4 zrot = math::makeZRotate(m_angle * sinf((float)ix));
-        float4x4 yrot = math::makeYRotate(m_angle * cosf((float)iy));
-
-        float x = ((float)ix - (float)kInstanceRows/2.0f) * (2.0f * scl) + scl;
-        float y = ((float)iy - (float)kInstanceRows/2.0f) * (2.0f * scl) + scl;
-        float z = ((float)iz - (float)kInstanceRows/2.0f) * (2.0f * scl) + scl;
-        float3 offsets = (float3){x, y, z};
-        float4x4 translate = math::makeTranslate(math::add(objectPosition, offsets));
-
-        instanceData[i].instanceTransform = fullObjectRotate * translate * yrot * zrot * scale;
-        instanceData[i].instanceNormalTransform = math::discardTranslation(instanceData[i].instanceTransform);
-
-        float divNumInstances = i / (float)kNumInstances;
-        float r = divNumInstances,
-            g = 1.0f - r,
-            b = sinf(M_PI * 2.0f * divNumInstances);
-        instanceData[i].instanceColor = (float4){r, g, b, 1.0f};
-
-        ix += 1;
-    }
-    instanceDataBuffer->didModifyRange(NS::Range::Make(0, instanceDataBuffer->length()));
+    // Colors were written once in buildBuffers, only the transforms change per frame
+    instanceBatch::Output output = {
+        instanceDataBuffer->contents(),
+        sizeof(shader_types::InstanceData),
+        offsetof(shader_types::InstanceData, instanceTransform),
+        offsetof(shader_types::InstanceData, instanceNormalTransform)
+    };
+    instanceBatch::update(m_instanceField, fullObjectRotate, objectPosition, snapshot.angle, output);
+    instanceDataBuffer->didModifyRange(NS::Range::Make(0, kNumInstances * sizeof(shader_types::InstanceData)));
 
     // Setup Camera Data
-    MTL::Buffer* cameraDataBuffer = m_cameraDataBuffer[m_frame];
-    shader_types::CameraData* cameraData = reinterpret_cast<shader_types::CameraData*>(cameraDataBuffer->contents());
-    cameraData->view = m_camera.getViewMatrix();
-    cameraData->perspective = m_camera.getPerspectiveMatrix(1280.0 / 720.0);
-    cameraData->position = m_camera.getPosition();
-    cameraDataBuffer->didModifyRange(NS::Range::Make(0, sizeof(shader_types::CameraData)));
+    FrameAllocator::Allocation cameraData = m_frameAllocator.allocate(sizeof(shader_types::CameraData));
+    cameraData.as<shader_types::CameraData>()->view = snapshot.view;
+    cameraData.as<shader_types::CameraData>()->perspective = snapshot.perspective;
+    cameraData.as<shader_types::CameraData>()->position = snapshot.cameraPosition;
     
     generateMandelbrotTexture(cmd);
 
@@ -638,7 +956,7 @@ void Renderer::draw(CA::MetalDrawable* drawable) {
 
     encoder->setVertexBuffer(m_vertexBuffer, 0, 0);
     encoder->setVertexBuffer(instanceDataBuffer, 0, 1);
-    encoder->setVertexBuffer(cameraDataBuffer, 0, 2);
+    encoder->setVertexBuffer(cameraData.buffer, cameraData.offset, 2);
     
     encoder->setFragmentTexture(m_texture, 0);
 
@@ -660,13 +978,14 @@ void Renderer::draw(CA::MetalDrawable* drawable) {
     ImGui_ImplMetal_RenderDrawData(ImGui::GetDrawData(), cmd, encoder);
 
     encoder->endEncoding();
+    m_frameAllocator.flush();
     cmd->presentDrawable(drawable);
     cmd->commit();
 
     pool->release();
 }
 
-void Renderer::drawModelOnly(CA::MetalDrawable* drawable) {
+void Renderer::drawModelOnly(CA::MetalDrawable* drawable, const FrameSnapshot& snapshot) {
     using simd::float4x4;
     using simd::float4;
     using simd::float3;
@@ -682,43 +1001,51 @@ void Renderer::drawModelOnly(CA::MetalDrawable* drawable) {
     cmd->addCompletedHandler([renderer](MTL::CommandBuffer* cmd) {
         dispatch_semaphore_signal(renderer->m_semaphore);
     });
+    m_frameAllocator.beginFrame(m_frame);
+    // Only the last kMaxFramesInFlight frames can still be running, scenes retired before them can go
+    if (m_scenePinnedFrame > (uint64_t)kMaxFramesInFlight) m_sceneModels.reclaim(m_scenePinnedFrame - kMaxFramesInFlight);
 
     // Setup Camera Data
-    MTL::Buffer* cameraDataBuffer = m_cameraDataBuffer[m_frame];
-    shader_types::CameraData* cameraData = reinterpret_cast<shader_types::CameraData*>(cameraDataBuffer->contents());
-    cameraData->view = m_camera.getViewMatrix();
-    cameraData->perspective = m_camera.getPerspectiveMatrix(1280.0 / 720.0);
-    cameraData->position = m_camera.getPosition();
-    cameraData->modifiedView = m_camera.getModifiedView();
-    cameraDataBuffer->didModifyRange(NS::Range::Make(0, sizeof(shader_types::CameraData)));
-    
-    size_t numDirLights = m_dirLights.size();
-    for (size_t i = 0; i < numDirLights; i++) {
-        directionalLight &dirLightInfo = m_dirLights[i];
-        shader_types::DirectionalLight* dirLight = reinterpret_cast<shader_types::DirectionalLight*>(m_dirLightsBuffer->contents());
-        dirLight += i;
-        dirLight->direction = simd_make_float3(dirLightInfo.direction[0], dirLightInfo.direction[1], dirLightInfo.direction[2]);
-        dirLight->ambient = simd_make_float3(dirLightInfo.ambient[0], dirLightInfo.ambient[1], dirLightInfo.ambient[2]);
-        dirLight->specular = simd_make_float3(dirLightInfo.specular[0], dirLightInfo.specular[1], dirLightInfo.specular[2]);
-        dirLight->diffuse = simd_make_float3(dirLightInfo.diffuse[0], dirLightInfo.diffuse[1], dirLightInfo.diffuse[2]);
-    }
-    if (numDirLights > 0) m_dirLightsBuffer->didModifyRange(NS::Range::Make(0, sizeof(shader_types::DirectionalLight) * numDirLights));
-    
-    size_t numPointLights = m_pointLights.size();
-    for (size_t i = 0; i < numPointLights; i++) {
-        pointLight &pointLightInfo = m_pointLights[i];
-        shader_types::PointLight* pointLight = reinterpret_cast<shader_types::PointLight*>(m_pointLightsBuffer->contents());
-        pointLight += i;
-        pointLight->position = simd_make_float3(pointLightInfo.position[0], pointLightInfo.position[1], pointLightInfo.position[2]);
-        pointLight->ambient = simd_make_float3(pointLightInfo.ambient[0], pointLightInfo.ambient[1], pointLightInfo.ambient[2]);
-        pointLight->specular = simd_make_float3(pointLightInfo.specular[0], pointLightInfo.specular[1], pointLightInfo.specular[2]);
-        pointLight->diffuse = simd_make_float3(pointLightInfo.diffuse[0], pointLightInfo.diffuse[1], pointLightInfo.diffuse[2]);
-    }
-    if (numPointLights > 0) m_pointLightsBuffer->didModifyRange(NS::Range::Make(0, sizeof(shader_types::PointLight) * numPointLights));
+    FrameAllocator::Allocation cameraData = m_frameAllocator.allocate(sizeof(shader_types::CameraData));
+    cameraData.as<shader_types::CameraData>()->view = snapshot.view;
+    cameraData.as<shader_types::CameraData>()->perspective = snapshot.perspective;
+    cameraData.as<shader_types::CameraData>()->position = snapshot.cameraPosition;
+    cameraData.as<shader_types::CameraData>()->modifiedView = snapshot.modifiedView;
+    
+    // Only lights edited since this frame's buffers were last uploaded get copied
+    MTL::Buffer* dirLightBuffer = m_dirLights.upload(m_device, m_frame);
+    MTL::Buffer* pointLightBuffer = m_pointLights.upload(m_device, m_frame);
+    const size_t lightUploadBytes = m_dirLights.uploadedBytes() + m_pointLights.uploadedBytes();
+    
+    // Point lights are binned into the froxels of this view, fragments only shade their froxel's list
+    const MTL::Viewport viewport = { 0.0f, 0.0f, 2560, 1440, 0.0f, 1.0f };
+    const bool projectionChanged = m_lightClusters.setProjection(snapshot.perspective, NEAR_PLANE, FAR_PLANE);
+    const bool lightsChanged = m_clusteredLights != m_pointLights.version();
+    if (lightsChanged) {
+        m_clusterLights.resize(m_pointLights.size());
+        for (size_t i = 0; i < m_pointLights.size(); i++) m_clusterLights[i] = { m_pointLights[i].position, m_pointLights[i].range };
+    }
+    if (projectionChanged || lightsChanged || std::memcmp(&m_clusteredView, &snapshot.view, sizeof(snapshot.view)) != 0) {
+        m_lightClusters.assign(snapshot.view, m_clusterLights.data(), m_clusterLights.size());
+        m_clusteredLights = m_pointLights.version();
+        m_clusteredView = snapshot.view;
+        m_clusterRanges.assign(m_lightClusters.clusters().data(), m_lightClusters.clusters().size());
+        m_clusterIndices.assign(m_lightClusters.indices().data(), m_lightClusters.indices().size());
+    }
+    MTL::Buffer* clusterBuffer = m_clusterRanges.upload(m_device, m_frame);
+    MTL::Buffer* clusterIndexBuffer = m_clusterIndices.upload(m_device, m_frame);
+    const size_t clusterUploadBytes = m_clusterRanges.uploadedBytes() + m_clusterIndices.uploadedBytes();
     
     shader_types::LightInfo lightInfo = {};
-    lightInfo.numDirections = numDirLights;
-    lightInfo.numPoints = numPointLights;
+    lightInfo.numDirections = m_dirLights.size();
+    lightInfo.numPoints = m_pointLights.size();
+    lightInfo.tileScale = simd_make_float2(LightClusters::kTilesX / viewport.width, LightClusters::kTilesY / viewport.height);
+    lightInfo.tilesX = LightClusters::kTilesX;
+    lightInfo.tilesY = LightClusters::kTilesY;
+    lightInfo.slices = LightClusters::kSlices;
+    lightInfo.sliceScale = m_lightClusters.sliceScale();
+    lightInfo.sliceBias = m_lightClusters.sliceBias();
+    FrameAllocator::Allocation lightInfoData = m_frameAllocator.push(lightInfo);
 
     // Start actual rendering
     MTL::RenderPassDescriptor* descriptor = MTL::RenderPassDescriptor::renderPassDescriptor();
@@ -747,43 +1074,47 @@ void Renderer::drawModelOnly(CA::MetalDrawable* drawable) {
     descriptor->depthAttachment()->setTexture(m_depthTexture);
     
     MTL::RenderCommandEncoder* encoder = cmd->renderCommandEncoder(descriptor);
+    m_stateEncoder.resetStats();
+    m_stateEncoder.begin(encoder);
     
-    encoder->setViewport(MTL::Viewport {
-        0.0f, 0.0f,
-        2560, 1440,
-        0.0f, 1.0f
-    });
+    encoder->setViewport(viewport);
     
     // Rendering model
-    encoder->setDepthStencilState(m_stencilState);
-    encoder->setRenderPipelineState(m_state);
+    m_stateEncoder.setDepthStencilState(m_stencilState);
+    m_stateEncoder.setRenderPipelineState(m_state);
     
-    encoder->setVertexBuffer(cameraDataBuffer, 0, 2);
+    m_stateEncoder.setVertexBuffer(cameraData.buffer, cameraData.offset, 2);
     
-    encoder->setFragmentBuffer(m_pointLightsBuffer, 0, 2);
-    encoder->setFragmentBuffer(m_dirLightsBuffer, 0, 3);
-    encoder->setFragmentBytes(&lightInfo, sizeof(shader_types::LightInfo), 4);
+    m_stateEncoder.setFragmentBuffer(pointLightBuffer, 0, 2);
+    m_stateEncoder.setFragmentBuffer(dirLightBuffer, 0, 3);
+    m_stateEncoder.setFragmentBuffer(lightInfoData.buffer, lightInfoData.offset, 4);
+    m_stateEncoder.setFragmentBuffer(clusterBuffer, 0, 6);
+    m_stateEncoder.setFragmentBuffer(clusterIndexBuffer, 0, 7);
 
     encoder->setCullMode(MTL::CullModeNone);
     encoder->setFrontFacingWinding(MTL::Winding::WindingCounterClockwise);
 
-    for (Model& model : m_importedModels) {
-        model.draw(encoder);
-    }
+    m_materials.bind(m_stateEncoder, m_device, m_fragmentFunction);
+    m_sceneBvh.queryFrustum(snapshot.frustum, m_sceneVisible);
+    std::sort(m_sceneVisible.begin(), m_sceneVisible.end());
+    const size_t occludedInstances = m_occlusionCulling ? cullOccluded(snapshot) : 0;
+    const size_t drawnInstances = m_sceneVisible.size(), totalInstances = m_sceneBvh.size();
+    drawVisible(m_stateEncoder, snapshot);
     
-    encoder->setRenderPipelineState(m_gizmoState);
-    encoder->setVertexBuffer(cameraDataBuffer, 0, 2);
+    m_stateEncoder.setRenderPipelineState(m_gizmoState);
+    m_stateEncoder.setVertexBuffer(cameraData.buffer, cameraData.offset, 2);
     
-    m_gizmo.draw(encoder);
+    m_gizmo.draw(m_stateEncoder, m_frameAllocator);
     
     // Rendering cubemap
-    encoder->setRenderPipelineState(m_cubemapState);
+    m_stateEncoder.setRenderPipelineState(m_cubemapState);
     
-    encoder->setVertexBuffer(m_cubeMapBuffer, 0, 0);
-    encoder->setVertexBuffer(cameraDataBuffer, 0, 1);
-    encoder->setFragmentTexture(m_cubeMapTexture, 0);
+    m_stateEncoder.setVertexBuffer(m_cubeMapBuffer, 0, 0);
+    m_stateEncoder.setVertexBuffer(cameraData.buffer, cameraData.offset, 1);
+    m_stateEncoder.setFragmentTexture(m_cubeMapTexture, 0);
     
-    encoder->drawPrimitives(MTL::PrimitiveTypeTriangle, NS::UInteger(0), 36);
+    m_stateEncoder.drawPrimitives(MTL::PrimitiveTypeTriangle, NS::UInteger(0), 36);
+    const StateEncoder::Stats encoderStats = m_stateEncoder.stats();
     
     // Rendering ImGui
     ImGui_ImplMetal_NewFrame(descriptor);
@@ -791,34 +1122,48 @@ void Renderer::drawModelOnly(CA::MetalDrawable* drawable) {
     ImGui::NewFrame();
     
     ImGui::Begin("Info");
-    size_t numLights = m_dirLights.size();
-    
+    ImGui::Text("Instances drawn: %zu of %zu", drawnInstances, totalInstances);
+    ImGui::Text("Draw calls: %zu, state changes: %zu", m_drawCalls, m_stateChanges);
+    ImGui::Text("Encoder calls: %zu, redundant dropped: %zu", encoderStats.calls, encoderStats.redundant);
+    ImGui::Text("Residency batches: %zu, repeats dropped: %zu", encoderStats.residencyBatches, encoderStats.redundantResidency);
+    ImGui::Text("Clustered light indices: %zu, dropped: %zu", m_lightClusters.indices().size(), m_lightClusters.droppedLights());
+    ImGui::Text("Light upload: %zu bytes, clusters: %zu bytes", lightUploadBytes, clusterUploadBytes);
+    ImGui::Text("Transient data: %lu of %lu KB", (unsigned long)m_frameAllocator.used() / 1024, (unsigned long)m_frameAllocator.capacity() / 1024);
+    ImGui::Checkbox("Validate command lists", &m_validateCommands);
+    ImGui::Checkbox("Occlusion culling", &m_occlusionCulling);
+    if (m_occlusionCulling) {
+        ImGui::Text("Occluded: %zu, occluder triangles: %zu", occludedInstances, m_occlusionBuffer.triangleCount());
+        if (ImGui::Button("Dump Occlusion Buffer")) m_occlusionBuffer.writePgm("occlusion.pgm");
+    }
+    // Lights are edited on a copy, so only lights that actually changed are marked for upload
     if (ImGui::CollapsingHeader("Directional Lights")) {
-        for (size_t i = 0; i < numLights; i++) {
-            directionalLight &currentLight = m_dirLights[i];
+        for (size_t i = 0; i < m_dirLights.size(); i++) {
+            directionalLight currentLight = m_dirLights[i];
             
             std::string name = "D Light " + std::to_string(i);
             if (ImGui::TreeNode(name.c_str())) {
-                ImGui::SliderFloat3("Direction", &currentLight.direction[0], -1.0f, 1.0f);
-                ImGui::SliderFloat3("Ambient", &currentLight.ambient[0], 0.0, 1.0);
-                ImGui::SliderFloat3("Diffuse", &currentLight.diffuse[0], 0.0, 1.0);
-                ImGui::SliderFloat3("Specular", &currentLight.specular[0], 0.0, 1.0);
+                bool changed = ImGui::SliderFloat3("Direction", reinterpret_cast<float*>(&currentLight.direction), -1.0f, 1.0f);
+                changed |= ImGui::SliderFloat3("Ambient", reinterpret_cast<float*>(&currentLight.ambient), 0.0, 1.0);
+                changed |= ImGui::SliderFloat3("Diffuse", reinterpret_cast<float*>(&currentLight.diffuse), 0.0, 1.0);
+                changed |= ImGui::SliderFloat3("Specular", reinterpret_cast<float*>(&currentLight.specular), 0.0, 1.0);
+                if (changed) m_dirLights.edit(i) = currentLight;
                 ImGui::TreePop();
             }
         }
     }
     
-    numLights = m_pointLights.size();
     if (ImGui::CollapsingHeader("Point Lights")) {
-        for (size_t i = 0; i < numLights; i++) {
-            auto &currentPoint = m_pointLights[i];
+        for (size_t i = 0; i < m_pointLights.size(); i++) {
+            pointLight currentPoint = m_pointLights[i];
             
             std::string name = "P Light " + std::to_string(i);
             if (ImGui::TreeNode(name.c_str())) {
-                ImGui::SliderFloat3("Position", &currentPoint.position[0], -10.0f, 10.0f);
-                ImGui::SliderFloat3("Ambient", &currentPoint.ambient[0], 0.0, 1.0);
-                ImGui::SliderFloat3("Diffuse", &currentPoint.diffuse[0], 0.0, 1.0);
-                ImGui::SliderFloat3("Specular", &currentPoint.specular[0], 0.0, 1.0);
+                bool changed = ImGui::SliderFloat3("Position", reinterpret_cast<float*>(&currentPoint.position), -10.0f, 10.0f);
+                changed |= ImGui::SliderFloat("Range", &currentPoint.range, 0.0f, 50.0f);
+                changed |= ImGui::SliderFloat3("Ambient", reinterpret_cast<float*>(&currentPoint.ambient), 0.0, 1.0);
+                changed |= ImGui::SliderFloat3("Diffuse", reinterpret_cast<float*>(&currentPoint.diffuse), 0.0, 1.0);
+                changed |= ImGui::SliderFloat3("Specular", reinterpret_cast<float*>(&currentPoint.specular), 0.0, 1.0);
+                if (changed) m_pointLights.edit(i) = currentPoint;
                 ImGui::TreePop();
             }
         }
@@ -833,13 +1178,53 @@ void Renderer::drawModelOnly(CA::MetalDrawable* drawable) {
         m_dirLights.push_back(newLight);
     }
     
-    if (ImGui::Button("Open File Dialog")) ImGuiFileDialog::Instance()->OpenDialog("ChooseFileKey", "Choose File", ".obj", ".");
+    if (ImGui::CollapsingHeader("Textures")) {
+        constexpr size_t kMegabyte = 1024 * 1024;
+        int budgetMegabytes = (int)(textureBudget::budget() / kMegabyte);
+        ImGui::Text("Used: %zu MB", textureBudget::committed() / kMegabyte);
+        if (ImGui::SliderInt("Budget (MB)", &budgetMegabytes, 64, 8192)) {
+            textureBudget::setBudget((size_t)budgetMegabytes * kMegabyte);
+        }
+    }
+    
+    if (ImGui::CollapsingHeader("Models")) {
+        for (size_t i = 0; i < m_scene->models.size(); i++) {
+            const std::string& path = sceneModel(i).path();
+            ImGui::Text("%s", path.substr(path.find_last_of('/') + 1).c_str());
+            ImGui::SameLine();
+            std::string label = "Add Copy##" + std::to_string(i);
+            if (ImGui::Button(label.c_str())) placeCopy(i);
+            
+            const TransformHierarchy& transforms = sceneModel(i).transforms();
+            std::string nodesLabel = "Nodes##" + std::to_string(i);
+            if (transforms.size() > 0 && ImGui::TreeNode(nodesLabel.c_str())) {
+                for (uint32_t node = 0; node < transforms.size(); node++) {
+                    std::string name = "Node " + std::to_string(node);
+                    if (!ImGui::TreeNode(name.c_str())) continue;
+                    
+                    simd::float3 translation = transforms.translation(node);
+                    simd::quatf rotation = transforms.rotation(node);
+                    simd::float3 scale = transforms.scale(node);
+                    bool changed = ImGui::DragFloat3("Translation", reinterpret_cast<float*>(&translation), 0.05f);
+                    changed |= ImGui::DragFloat4("Rotation", reinterpret_cast<float*>(&rotation), 0.01f, -1.0f, 1.0f);
+                    changed |= ImGui::DragFloat3("Scale", reinterpret_cast<float*>(&scale), 0.01f);
+                    if (changed && simd::length(rotation.vector) > 0.0f) setNodeTransform(i, node, translation, simd_normalize(rotation), scale);
+                    ImGui::TreePop();
+                }
+                ImGui::TreePop();
+            }
+        }
+    }
+    
+    if (ImGui::Button("Open File Dialog")) ImGuiFileDialog::Instance()->OpenDialog("ChooseFileKey", "Choose File", ".obj,.gltf,.glb,.mcache", ".");
     
     if (ImGuiFileDialog::Instance()->Display("ChooseFileKey")) {
         if (ImGuiFileDialog::Instance()->IsOk()) {
             std::string filePath = ImGuiFileDialog::Instance()->GetFilePathName();
             
-            auto result = std::async(std::launch::async, &Renderer::asyncImportModel, this, filePath);
+            auto imported = std::find_if(m_scene->models.begin(), m_scene->models.end(), [&filePath](const std::shared_ptr<const Model>& model) { return model->path() == filePath; });
+            if (imported != m_scene->models.end()) placeCopy(imported - m_scene->models.begin());
+            else jobs::run([this, filePath]() { asyncImportModel(filePath); });
         }
         ImGuiFileDialog::Instance()->Close();
     }
@@ -849,7 +1234,8 @@ void Renderer::drawModelOnly(CA::MetalDrawable* drawable) {
     ImGui::Render();
     ImGui_ImplMetal_RenderDrawData(ImGui::GetDrawData(), cmd, encoder);
     
-    encoder->endEncoding();
+    m_stateEncoder.end();
+    m_frameAllocator.flush();
     cmd->presentDrawable(drawable);
     cmd->commit();
 
@@ -857,15 +1243,16 @@ void Renderer::drawModelOnly(CA::MetalDrawable* drawable) {
 }
 
 void Renderer::asyncImportModel(std::string path) {
-    Model importedModel(path, m_device);
-    importedModel.setupMeshBuffers(m_device, m_fragmentFunction);
+    auto importedModel = std::make_shared<Model>(path, m_device);
+    importedModel->setupMeshBuffers(m_device, m_materials);
     
-    m_importedModels.push_back(importedModel);
+    // Published straight from the import job, the frame loop sees it from its next pin on
+    m_sceneModels.update([&importedModel](Scene& scene) { scene.models.push_back(std::move(importedModel)); });
 }
 
-void asyncImportModel(std::string& path, std::vector<Model>& importedModels, MTL::Device* device, MTL::Function* fragmentFn) {
+void asyncImportModel(std::string& path, std::vector<Model>& importedModels, MTL::Device* device, MaterialTable& materials) {
     Model importedModel(path, device);
-    importedModel.setupMeshBuffers(device, fragmentFn);
+    importedModel.setupMeshBuffers(device, materials);
     
     importedModels.push_back(importedModel);
 }
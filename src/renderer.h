@@ -1,5 +1,9 @@
 #pragma once
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <Metal/Metal.hpp>
 #include <MetalKit/MetalKit.hpp>
@@ -8,7 +12,20 @@
 
 #include "utility/model.hpp"
 #include "utility/camera.hpp"
+#include "utility/commandList.hpp"
+#include "utility/drawSort.hpp"
+#include "utility/frameAllocator.hpp"
+#include "utility/frustumCulling.hpp"
+#include "utility/gpuArray.hpp"
 #include "utility/gizmo.hpp"
+#include "utility/instanceBatch.hpp"
+#include "utility/lightClusters.hpp"
+#include "utility/materialTable.hpp"
+#include "utility/occlusionBuffer.hpp"
+#include "utility/rcu.hpp"
+#include "utility/sceneBvh.hpp"
+#include "utility/stateEncoder.hpp"
+#include "utility/tripleBuffer.hpp"
 
 static constexpr size_t kInstanceRows = 10;
 static constexpr size_t kInstanceColumns = 10;
@@ -27,18 +44,50 @@ struct cameraInfo {
     bool firstMouse = true;
 };
 
+// Laid out like PointLight and DirectionalLight in modelShader.metal, they upload as they are
 struct pointLight {
-    float position[3];
-    float ambient[3];
-    float specular[3];
-    float diffuse[3];
+    simd::float3 position;
+    simd::float3 diffuse;
+    simd::float3 specular;
+    simd::float3 ambient;
+    // Light falls off to nothing at this distance
+    float range = 10.0f;
 };
 
 struct directionalLight {
-    float direction[3];
-    float ambient[3];
-    float specular[3];
-    float diffuse[3];
+    simd::float3 direction;
+    simd::float3 diffuse;
+    simd::float3 specular;
+    simd::float3 ambient;
+};
+
+// Imported models, never changed once published. Snapshots share the models they have in common.
+struct Scene {
+    std::vector<std::shared_ptr<const Model>> models;
+};
+
+// What the event loop hands the simulation thread for one step
+struct FrameInput {
+    struct CameraEvent {
+        enum Type { Move, Look, Zoom } type;
+        Camera_Movement direction;
+        float x, y;
+    };
+
+    float deltaTime = 0.0f;
+    std::vector<CameraEvent> cameraEvents;
+};
+
+// Everything one frame is encoded from. Filled by the simulation thread and never
+// written again once published, so the render thread reads it without locks.
+struct FrameSnapshot {
+    uint64_t frame = 0;
+    simd::float3 cameraPosition;
+    simd::float4x4 view;
+    simd::float4x4 perspective;
+    simd::float4x4 modifiedView;
+    culling::Frustum frustum;
+    float angle = 0.0f;
 };
 
 
@@ -59,15 +108,30 @@ public:
 
     void createLights();
     void buildCubemap();
+    void updateSceneBvh();
+    const Model& sceneModel(size_t model) const { return *m_scene->models[model]; }
+    size_t cullOccluded(const FrameSnapshot& snapshot);
+    void drawVisible(StateEncoder& encoder, const FrameSnapshot& snapshot);
+    void recordDraws(gfx::CommandList& commands, size_t begin, size_t end, MeshInstance* instances) const;
+    void placeCopy(size_t model);
+    void setNodeTransform(size_t model, uint32_t node, simd::float3 translation, simd::quatf rotation, simd::float3 scale);
 
-    void draw(CA::MetalDrawable* drawable);
-    void drawModelOnly(CA::MetalDrawable* drawable);
+    void draw(CA::MetalDrawable* drawable, const FrameSnapshot& snapshot);
+    void drawModelOnly(CA::MetalDrawable* drawable, const FrameSnapshot& snapshot);
 
     void initWindow();
     void run();
 
+    void startSimulation();
+    void stopSimulation();
+    void requestSimulation(FrameInput& input);
+    const FrameSnapshot& waitForSnapshot(uint64_t frame);
+    void simulationLoop();
+    void simulate(const FrameInput& input, FrameSnapshot& snapshot);
+
     void generateMandelbrotTexture(MTL::CommandBuffer* cmd);
     
+    // Owned by the simulation thread while run() is going
     Camera m_camera;
     
 private:
@@ -90,15 +154,45 @@ private:
     MTL::Buffer* m_indexBuffer;
 
     MTL::Buffer* m_instanceDataBuffer[kMaxFramesInFlight];
-    MTL::Buffer* m_cameraDataBuffer[kMaxFramesInFlight];
+    instanceBatch::Field m_instanceField;
+    // Camera constants, light counts and the instance data of sorted draws, rewound every frame
+    FrameAllocator m_frameAllocator;
 
     MTL::Texture* m_texture;
     MTL::Buffer* m_textureAnimationBuffer;
 
     MTL::Texture* m_depthTexture = nullptr;
 
-    std::vector<Model> m_importedModels;
+    // Import jobs and the UI publish new scenes, the frame loop pins one per frame
+    Rcu<Scene> m_sceneModels;
+    const Scene* m_scene = nullptr;
+    uint64_t m_scenePinnedFrame = 0;
     Model m_importedModel;
+    MaterialTable m_materials;
+
+    // Every instance of every imported model, numbered model by model from m_sceneFirstItem
+    SceneBvh m_sceneBvh;
+    std::vector<uint32_t> m_sceneFirstItem;
+    std::vector<uint32_t> m_sceneVersions;
+    std::vector<const Model*> m_sceneRefs;
+    std::vector<uint32_t> m_sceneVisible;
+    // Where each model's meshes start in the scene-wide mesh numbering, and the geometry every
+    // mesh draws. Copies of a model share geometry, draw keys use it so their instances batch.
+    std::vector<uint32_t> m_sceneFirstMesh;
+    std::vector<uint32_t> m_sceneMeshGeometry;
+    std::vector<drawSort::Item> m_drawItems;
+    std::vector<drawSort::Item> m_drawScratch;
+    // Sorted draws are recorded in chunks of kDrawsPerCommandList, one list each
+    static constexpr size_t kDrawsPerCommandList = 512;
+    std::vector<gfx::CommandList> m_commandLists;
+    bool m_validateCommands = false;
+    StateEncoder m_stateEncoder;
+    size_t m_drawCalls = 0;
+    size_t m_stateChanges = 0;
+    // Occluders are the visible instances that look largest from the camera, up to a triangle budget
+    OcclusionBuffer m_occlusionBuffer;
+    std::vector<std::pair<float, uint32_t>> m_occluders;
+    bool m_occlusionCulling = true;
 
     MTL::Buffer* m_frameData[3];
     float m_angle;
@@ -107,11 +201,17 @@ private:
     static const int kMaxFramesInFlight;
     uint m_animationIndex;
 
-    std::vector<directionalLight> m_dirLights;
-    MTL::Buffer* m_dirLightsBuffer;
-    
-    std::vector<pointLight> m_pointLights;
-    MTL::Buffer* m_pointLightsBuffer;
+    // Edited on the main thread, which also encodes, so only edited lights upload
+    GpuArray<directionalLight> m_dirLights;
+    GpuArray<pointLight> m_pointLights;
+    LightClusters m_lightClusters;
+    std::vector<LightClusters::Light> m_clusterLights;
+    // Cluster lists as last assigned, uploaded to a frame's buffers only after they change
+    GpuArray<LightClusters::Cluster> m_clusterRanges;
+    GpuArray<uint32_t> m_clusterIndices;
+    // What the clusters were last assigned for, unchanged lights and view keep them
+    uint64_t m_clusteredLights = UINT64_MAX;
+    simd::float4x4 m_clusteredView = {};
     
     MTL::Texture* m_cubeMapTexture;
     MTL::Buffer* m_cubeMapBuffer;
@@ -119,6 +219,16 @@ private:
     
     Gizmo m_gizmo;
     MTL::RenderPipelineState* m_gizmoState;
+
+    // The simulation thread builds frame N+1 while the render thread encodes frame N
+    std::thread m_simulationThread;
+    std::mutex m_simulationMutex;
+    std::condition_variable m_simulationWake;
+    FrameInput m_simulationInput;
+    uint64_t m_simulationRequested = 0;
+    uint64_t m_simulationCompleted = 0;
+    bool m_simulationStopping = false;
+    TripleBuffer<FrameSnapshot> m_snapshots;
 };
 
-void asyncImportModel(std::string& path, std::vector<Model>& importedModels, MTL::Device* device, MTL::Function* fragmentFn);
+void asyncImportModel(std::string& path, std::vector<Model>& importedModels, MTL::Device* device, MaterialTable& materials);
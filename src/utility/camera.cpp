@@ -60,7 +60,7 @@ simd::float4x4 Camera::getModifiedView() {
 }
 
 simd::float4x4 Camera::getPerspectiveMatrix(float aspect) {
-    glm::mat4 perspective = glm::perspective(glm::radians(zoom), aspect, 0.1f, 100.0f);
+    glm::mat4 perspective = glm::perspective(glm::radians(zoom), aspect, NEAR_PLANE, FAR_PLANE);
     
     simd::float4x4 perspectiveSimd = simd_matrix_from_rows(
        (simd::float4) {perspective[0][0], perspective[1][0], perspective[2][0], perspective[3][0]},
@@ -0,0 +1,95 @@
+#include "commandList.hpp"
+
+#include <cstring>
+#include <iostream>
+
+void gfx::CommandList::clear() {
+    m_bytes.clear();
+    m_commandCount = 0;
+    m_drawCount = 0;
+}
+
+void* gfx::CommandList::allocate(CommandType type, size_t size) {
+    size = (size + 7) & ~size_t(7);
+    const size_t offset = m_bytes.size();
+    m_bytes.resize(offset + size);
+
+    CommandHeader* header = reinterpret_cast<CommandHeader*>(m_bytes.data() + offset);
+    header->type = type;
+    header->padding = 0;
+    header->size = (uint16_t)size;
+    m_commandCount++;
+    return header;
+}
+
+void gfx::CommandList::setVertexBuffer(BufferHandle buffer, uint64_t offset, uint32_t index) {
+    SetVertexBuffer* command = static_cast<SetVertexBuffer*>(allocate(CommandType::SetVertexBuffer, sizeof(SetVertexBuffer)));
+    command->index = index;
+    command->buffer = buffer;
+    command->offset = offset;
+}
+
+void gfx::CommandList::setFragmentBytes(const void* data, uint32_t size, uint32_t index) {
+    if (size > kMaxInlineBytes) {
+        std::cout << "Error::CommandList::Fragment bytes of " << size << " exceed " << kMaxInlineBytes << "\n";
+        return;
+    }
+
+    SetFragmentBytes* command = static_cast<SetFragmentBytes*>(allocate(CommandType::SetFragmentBytes, sizeof(SetFragmentBytes) + size));
+    command->index = index;
+    command->size = size;
+    std::memcpy(command + 1, data, size);
+}
+
+void gfx::CommandList::drawIndexed(BufferHandle indexBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t baseInstance) {
+    DrawIndexed* command = static_cast<DrawIndexed*>(allocate(CommandType::DrawIndexed, sizeof(DrawIndexed)));
+    command->indexCount = indexCount;
+    command->indexBuffer = indexBuffer;
+    command->instanceCount = instanceCount;
+    command->baseInstance = baseInstance;
+    m_drawCount++;
+}
+
+gfx::ValidationResult gfx::validate(const std::vector<CommandList>& lists) {
+    ValidationResult result;
+    bool vertexBound[kMaxBufferIndex + 1] = {};
+
+    auto fail = [&result](const std::string& message) {
+        if (result.errors++ == 0) result.firstError = "Command " + std::to_string(result.commands) + ": " + message;
+    };
+
+    for (const CommandList& list : lists) {
+        list.forEach([&](const CommandHeader& header) {
+            switch (header.type) {
+                case CommandType::SetVertexBuffer: {
+                    const SetVertexBuffer& command = reinterpret_cast<const SetVertexBuffer&>(header);
+                    if (command.index > kMaxBufferIndex) fail("vertex buffer index " + std::to_string(command.index) + " out of range");
+                    else vertexBound[command.index] = command.buffer != nullptr;
+                    result.vertexBufferBinds++;
+                    break;
+                }
+                case CommandType::SetFragmentBytes: {
+                    const SetFragmentBytes& command = reinterpret_cast<const SetFragmentBytes&>(header);
+                    if (command.index > kMaxBufferIndex) fail("fragment buffer index " + std::to_string(command.index) + " out of range");
+                    result.fragmentByteBinds++;
+                    break;
+                }
+                case CommandType::DrawIndexed: {
+                    const DrawIndexed& command = reinterpret_cast<const DrawIndexed&>(header);
+                    if (!vertexBound[0] || !vertexBound[1]) fail("draw without vertex and instance buffers");
+                    if (command.indexBuffer == nullptr) fail("draw without an index buffer");
+                    if (command.indexCount == 0 || command.indexCount % 3 != 0) fail("index count " + std::to_string(command.indexCount) + " is not whole triangles");
+                    if (command.instanceCount == 0) fail("draw without instances");
+                    result.draws++;
+                    result.instances += command.instanceCount;
+                    break;
+                }
+                default:
+                    fail("unknown command type " + std::to_string((int)header.type));
+                    break;
+            }
+            result.commands++;
+        });
+    }
+    return result;
+}
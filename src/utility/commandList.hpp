@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class StateEncoder;
+
+// Backend-agnostic draw recording. Commands are plain structs packed into one growing byte
+// array, so any thread can record its own list without touching the GPU API. Lists are
+// replayed in order through a backend: Metal for real frames, or validate, which only walks
+// the commands and checks binding state and needs no GPU.
+namespace gfx {
+    // Native buffer object, MTL::Buffer* on Metal
+    using BufferHandle = void*;
+
+    enum class CommandType : uint8_t {
+        SetVertexBuffer,
+        SetFragmentBytes,
+        DrawIndexed,
+    };
+
+    // Every command starts with its header, size covers the header and any inline data
+    struct CommandHeader {
+        CommandType type;
+        uint8_t padding;
+        uint16_t size;
+    };
+
+    struct SetVertexBuffer {
+        CommandHeader header;
+        uint32_t index;
+        BufferHandle buffer;
+        uint64_t offset;
+    };
+
+    // size bytes of data follow the struct, 8-byte aligned
+    struct SetFragmentBytes {
+        CommandHeader header;
+        uint32_t index;
+        uint32_t size;
+        uint32_t padding;
+    };
+
+    // 32-bit indices, the whole index count starting at the buffer's beginning
+    struct DrawIndexed {
+        CommandHeader header;
+        uint32_t indexCount;
+        BufferHandle indexBuffer;
+        uint32_t instanceCount;
+        uint32_t baseInstance;
+    };
+
+    // Metal's limit for setFragmentBytes
+    constexpr uint32_t kMaxInlineBytes = 4096;
+    constexpr uint32_t kMaxBufferIndex = 30;
+
+    class CommandList {
+    public:
+        void clear();
+
+        void setVertexBuffer(BufferHandle buffer, uint64_t offset, uint32_t index);
+        // Data over kMaxInlineBytes is rejected
+        void setFragmentBytes(const void* data, uint32_t size, uint32_t index);
+        void drawIndexed(BufferHandle indexBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t baseInstance);
+
+        size_t commandCount() const { return m_commandCount; }
+        size_t drawCount() const { return m_drawCount; }
+        size_t byteSize() const { return m_bytes.size(); }
+
+        // Calls visit(const CommandHeader&) for every command in recording order
+        template <typename Visit>
+        void forEach(Visit visit) const {
+            for (size_t offset = 0; offset < m_bytes.size();) {
+                const CommandHeader& header = *reinterpret_cast<const CommandHeader*>(m_bytes.data() + offset);
+                visit(header);
+                offset += header.size;
+            }
+        }
+
+    private:
+        // Command sizes are rounded up to 8 bytes, so every command stays aligned
+        std::vector<uint8_t> m_bytes;
+        size_t m_commandCount = 0;
+        size_t m_drawCount = 0;
+
+        void* allocate(CommandType type, size_t size);
+    };
+
+    // Replays onto a render encoder in order, binds the encoder already has are dropped there
+    void replay(const CommandList& list, StateEncoder& encoder);
+
+    // Null backend. Walks the lists as if they were one encoder's worth of commands and checks
+    // that every draw has vertex buffers 0 and 1 and an index buffer, with sane counts.
+    struct ValidationResult {
+        size_t commands = 0;
+        size_t draws = 0;
+        size_t vertexBufferBinds = 0;
+        size_t fragmentByteBinds = 0;
+        size_t instances = 0;
+        size_t errors = 0;
+        // Only the first problem is described
+        std::string firstError;
+    };
+    ValidationResult validate(const std::vector<CommandList>& lists);
+}
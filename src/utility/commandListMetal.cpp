@@ -0,0 +1,26 @@
+#include "commandList.hpp"
+#include "stateEncoder.hpp"
+
+void gfx::replay(const CommandList& list, StateEncoder& encoder) {
+    list.forEach([&encoder](const CommandHeader& header) {
+        switch (header.type) {
+            case CommandType::SetVertexBuffer: {
+                const SetVertexBuffer& command = reinterpret_cast<const SetVertexBuffer&>(header);
+                encoder.setVertexBuffer(static_cast<MTL::Buffer*>(command.buffer), command.offset, command.index);
+                break;
+            }
+            case CommandType::SetFragmentBytes: {
+                const SetFragmentBytes& command = reinterpret_cast<const SetFragmentBytes&>(header);
+                encoder.setFragmentBytes(&command + 1, command.size, command.index);
+                break;
+            }
+            case CommandType::DrawIndexed: {
+                const DrawIndexed& command = reinterpret_cast<const DrawIndexed&>(header);
+                encoder.drawIndexedPrimitives(MTL::PrimitiveTypeTriangle, command.indexCount, MTL::IndexTypeUInt32,
+                                              static_cast<MTL::Buffer*>(command.indexBuffer), 0, command.instanceCount, 0,
+                                              command.baseInstance);
+                break;
+            }
+        }
+    });
+}
@@ -0,0 +1,88 @@
+#include "cookedTexture.hpp"
+
+#include <cstring>
+#include <fstream>
+
+namespace {
+    constexpr uint32_t kTextureMagic = 0x3158544D; // "MTX1"
+    constexpr uint32_t kTextureVersion = 1;
+
+    void writeU32(std::ofstream& stream, uint32_t value) {
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(uint32_t));
+    }
+
+    bool readU32(const unsigned char* data, size_t size, size_t& offset, uint32_t& value) {
+        if (offset + sizeof(uint32_t) > size) return false;
+        std::memcpy(&value, data + offset, sizeof(uint32_t));
+        offset += sizeof(uint32_t);
+        return true;
+    }
+}
+
+bool cookedTexture::isBlockCompressed(Format format) {
+    return format == Format::BC1 || format == Format::BC3 || format == Format::BC4;
+}
+
+uint32_t cookedTexture::bytesPerRow(Format format, uint32_t width) {
+    uint32_t blocksWide = (width + 3) / 4;
+    switch (format) {
+        case Format::RGBA8: return width * 4;
+        case Format::R8: return width;
+        case Format::BC1:
+        case Format::BC4: return blocksWide * 8;
+        case Format::BC3: return blocksWide * 16;
+    }
+    return 0;
+}
+
+uint32_t cookedTexture::levelSize(Format format, uint32_t width, uint32_t height) {
+    uint32_t rows = isBlockCompressed(format) ? (height + 3) / 4 : height;
+    return bytesPerRow(format, width) * rows;
+}
+
+bool cookedTexture::isCookedTexturePath(const std::string& path) {
+    const std::string extension = ".mtex";
+    return path.size() > extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+bool cookedTexture::write(const std::string& path, const Image& image) {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream) return false;
+
+    writeU32(stream, kTextureMagic);
+    writeU32(stream, kTextureVersion);
+    writeU32(stream, (uint32_t)image.format);
+    writeU32(stream, (uint32_t)image.mips.size());
+
+    for (const MipLevel& mip : image.mips) {
+        writeU32(stream, mip.width);
+        writeU32(stream, mip.height);
+        writeU32(stream, (uint32_t)mip.data.size());
+        stream.write(reinterpret_cast<const char*>(mip.data.data()), (std::streamsize)mip.data.size());
+    }
+
+    return (bool)stream;
+}
+
+bool cookedTexture::parse(const unsigned char* data, size_t size, Format& format, std::vector<MipView>& mips) {
+    size_t offset = 0;
+    uint32_t magic, version, formatValue, mipCount;
+    if (!readU32(data, size, offset, magic) || magic != kTextureMagic) return false;
+    if (!readU32(data, size, offset, version) || version != kTextureVersion) return false;
+    if (!readU32(data, size, offset, formatValue) || formatValue > (uint32_t)Format::BC4) return false;
+    if (!readU32(data, size, offset, mipCount) || mipCount == 0 || mipCount > 16) return false;
+
+    format = (Format)formatValue;
+    mips.resize(mipCount);
+    for (MipView& mip : mips) {
+        if (!readU32(data, size, offset, mip.width) || !readU32(data, size, offset, mip.height) ||
+            !readU32(data, size, offset, mip.size)) return false;
+        if (mip.width == 0 || mip.height == 0 || mip.size != levelSize(format, mip.width, mip.height)) return false;
+        if (offset + mip.size > size) return false;
+
+        mip.data = data + offset;
+        offset += mip.size;
+    }
+
+    return true;
+}
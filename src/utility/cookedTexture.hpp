@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Cooked texture container (.mtex) written by metal_engine_cook. Holds a full mip
+// chain, already block compressed where the role allows it, so the runtime only
+// has to copy each level into the texture.
+namespace cookedTexture {
+    enum class Format : uint32_t {
+        RGBA8 = 0,
+        R8 = 1,
+        BC1 = 2,
+        BC3 = 3,
+        BC4 = 4
+    };
+
+    struct MipLevel {
+        uint32_t width;
+        uint32_t height;
+        std::vector<unsigned char> data;
+    };
+
+    struct Image {
+        Format format = Format::RGBA8;
+        std::vector<MipLevel> mips;
+    };
+
+    // Points into the buffer handed to parse, which has to outlive the view
+    struct MipView {
+        uint32_t width;
+        uint32_t height;
+        const unsigned char* data;
+        uint32_t size;
+    };
+
+    bool write(const std::string& path, const Image& image);
+    bool parse(const unsigned char* data, size_t size, Format& format, std::vector<MipView>& mips);
+
+    bool isBlockCompressed(Format format);
+    uint32_t bytesPerRow(Format format, uint32_t width);
+    uint32_t levelSize(Format format, uint32_t width, uint32_t height);
+
+    bool isCookedTexturePath(const std::string& path);
+}
@@ -0,0 +1,104 @@
+#include "drawSort.hpp"
+#include "jobSystem.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+    constexpr int kDepthShift = 0;
+    constexpr int kMeshShift = 8;
+    constexpr int kMaterialShift = 36;
+    constexpr int kPipelineShift = 52;
+    constexpr int kPassShift = 60;
+
+    constexpr int kDigits = 8;
+    constexpr size_t kRadix = 256;
+    // Below this a pass is cheaper than handing chunks to workers
+    constexpr size_t kMinChunk = 16384;
+
+    using Histogram = std::array<uint32_t, kRadix>;
+
+    uint64_t field(uint32_t value, int bits, int shift) {
+        return (uint64_t)(value & ((1u << bits) - 1)) << shift;
+    }
+
+    uint32_t digit(uint64_t key, int pass) {
+        return (uint32_t)(key >> (pass * 8)) & 0xFF;
+    }
+}
+
+uint64_t drawSort::makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depthBucket) {
+    return field(pass, 4, kPassShift) | field(pipeline, 8, kPipelineShift) | field(material, kMaterialBits, kMaterialShift) |
+           field(mesh, kMeshBits, kMeshShift) | field(depthBucket, 8, kDepthShift);
+}
+
+uint32_t drawSort::material(uint64_t key) {
+    return (uint32_t)(key >> kMaterialShift) & ((1u << kMaterialBits) - 1);
+}
+
+uint32_t drawSort::mesh(uint64_t key) {
+    return (uint32_t)(key >> kMeshShift) & ((1u << kMeshBits) - 1);
+}
+
+uint64_t drawSort::batch(uint64_t key) {
+    return key >> kMeshShift;
+}
+
+uint32_t drawSort::depthBucket(float distance, float nearPlane, float farPlane) {
+    if (!(distance > nearPlane)) return 0;
+    if (distance >= farPlane) return kDepthBuckets - 1;
+    float t = std::log(distance / nearPlane) / std::log(farPlane / nearPlane);
+    return std::min(kDepthBuckets - 1, (uint32_t)(t * kDepthBuckets));
+}
+
+void drawSort::radixSort(std::vector<Item>& items, std::vector<Item>& scratch) {
+    const size_t count = items.size();
+    if (count < 2) return;
+    scratch.resize(count);
+
+    // One sweep finds the bytes that differ anywhere, the rest would be identity passes
+    uint64_t differing = 0;
+    for (size_t i = 1; i < count; i++) differing |= items[i].key ^ items[0].key;
+
+    const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(count / kMinChunk, jobs::workerCount() + 1));
+    const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+    std::vector<Histogram> histograms(chunkCount);
+
+    for (int pass = 0; pass < kDigits; pass++) {
+        if (digit(differing, pass) == 0) continue;
+        Item* source = items.data();
+        Item* destination = scratch.data();
+
+        jobs::parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++) {
+                Histogram& histogram = histograms[chunk];
+                histogram.fill(0);
+                for (size_t i = chunk * chunkSize; i < std::min(count, (chunk + 1) * chunkSize); i++) {
+                    histogram[digit(source[i].key, pass)]++;
+                }
+            }
+        });
+
+        // Turn counts into where each chunk's run of every digit starts, chunk order keeps it stable
+        uint32_t offset = 0;
+        for (size_t value = 0; value < kRadix; value++) {
+            for (Histogram& histogram : histograms) {
+                uint32_t digitCount = histogram[value];
+                histogram[value] = offset;
+                offset += digitCount;
+            }
+        }
+
+        jobs::parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++) {
+                Histogram& histogram = histograms[chunk];
+                for (size_t i = chunk * chunkSize; i < std::min(count, (chunk + 1) * chunkSize); i++) {
+                    destination[histogram[digit(source[i].key, pass)]++] = source[i];
+                }
+            }
+        });
+
+        items.swap(scratch);
+    }
+}
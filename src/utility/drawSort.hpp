@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Draw ordering. Every draw gets a 64-bit key, most significant field first:
+//   pass (4) | pipeline (8) | material (16) | mesh (28) | depth (8)
+// so sorting groups draws by state, then by mesh for instancing, and each mesh's instances
+// go front to back.
+namespace drawSort {
+    constexpr uint32_t kDepthBuckets = 256;
+
+    struct Item {
+        uint64_t key;
+        // What the key stands for, opaque to the sort
+        uint32_t value;
+    };
+
+    // Fields wider than their bits are truncated. Sorting stays correct, but draws whose
+    // material or mesh only differ above those bits compare equal in batch(), callers
+    // merging draws have to check the full values too.
+    constexpr uint32_t kMaterialBits = 16;
+    constexpr uint32_t kMeshBits = 28;
+    uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depthBucket);
+    uint32_t material(uint64_t key);
+    uint32_t mesh(uint64_t key);
+    // Keys of draws that can be one instanced draw compare equal here
+    uint64_t batch(uint64_t key);
+
+    // Logarithmic in view distance between near and far, so nearby draws get the finer buckets
+    uint32_t depthBucket(float distance, float nearPlane, float farPlane);
+
+    // Stable LSD radix sort by key, a byte per pass. Passes whose byte is the same for every
+    // item are skipped, large inputs split counting and scattering across the job system.
+    // scratch is resized as needed and can be kept around between calls.
+    void radixSort(std::vector<Item>& items, std::vector<Item>& scratch);
+}
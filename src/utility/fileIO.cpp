@@ -1,5 +1,10 @@
 #include "fileIO.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 std::string util::readFileIntoString(const std::string& fileName) {
     std::string data;
 
@@ -14,4 +19,45 @@ std::string util::readFileIntoString(const std::string& fileName) {
     shaderFile.close();
 
     return data;
-}
\ No newline at end of file
+}
+
+util::MappedFile::MappedFile(const std::string& fileName) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            m_data = static_cast<const unsigned char*>(mapping);
+            m_size = (size_t)info.st_size;
+        }
+    }
+    close(fd);
+}
+
+util::MappedFile::~MappedFile() {
+    unmap();
+}
+
+util::MappedFile::MappedFile(MappedFile&& other) noexcept : m_data(other.m_data), m_size(other.m_size) {
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+util::MappedFile& util::MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+void util::MappedFile::unmap() {
+    if (m_data) munmap(const_cast<unsigned char*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
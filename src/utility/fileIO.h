@@ -6,4 +6,26 @@
 
 namespace util {
     std::string readFileIntoString(const std::string& fileName);
-}
\ No newline at end of file
+
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        MappedFile(const std::string& fileName);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        bool isValid() const { return m_data != nullptr; }
+        const unsigned char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+    private:
+        void unmap();
+
+        const unsigned char* m_data = nullptr;
+        size_t m_size = 0;
+    };
+}
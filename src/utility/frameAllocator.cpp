@@ -0,0 +1,71 @@
+#include "frameAllocator.hpp"
+
+#include <algorithm>
+
+FrameAllocator::~FrameAllocator() {
+    for (std::vector<Chunk>& ring : m_rings) {
+        for (Chunk& chunk : ring) chunk.buffer->release();
+    }
+}
+
+MTL::Buffer* FrameAllocator::newBuffer(NS::UInteger capacity) {
+    capacity = (capacity + kAlignment - 1) & ~(kAlignment - 1);
+    return m_device->newBuffer(capacity, MTL::ResourceStorageModeManaged);
+}
+
+void FrameAllocator::init(MTL::Device* device, size_t framesInFlight, NS::UInteger capacity) {
+    m_device = device;
+    m_rings.resize(framesInFlight);
+    for (std::vector<Chunk>& ring : m_rings) {
+        ring.push_back({ newBuffer(capacity), 0 });
+    }
+}
+
+void FrameAllocator::beginFrame(size_t frame) {
+    m_frame = frame;
+    std::vector<Chunk>& ring = m_rings[frame];
+
+    // The last frame outgrew its ring, the GPU is done with it so it can be replaced whole
+    if (ring.size() > 1) {
+        NS::UInteger capacity = 0;
+        for (Chunk& chunk : ring) {
+            capacity += chunk.buffer->length();
+            chunk.buffer->release();
+        }
+        ring.assign(1, { newBuffer(capacity), 0 });
+    }
+    ring.front().used = 0;
+}
+
+FrameAllocator::Allocation FrameAllocator::allocate(NS::UInteger size, NS::UInteger alignment) {
+    std::vector<Chunk>& ring = m_rings[m_frame];
+
+    Chunk* chunk = &ring.back();
+    NS::UInteger offset = (chunk->used + alignment - 1) / alignment * alignment;
+    if (offset + size > chunk->buffer->length()) {
+        ring.push_back({ newBuffer(std::max(chunk->buffer->length() * 2, size)), 0 });
+        chunk = &ring.back();
+        offset = 0;
+    }
+    chunk->used = offset + size;
+
+    return { chunk->buffer, offset, static_cast<uint8_t*>(chunk->buffer->contents()) + offset };
+}
+
+void FrameAllocator::flush() {
+    for (const Chunk& chunk : m_rings[m_frame]) {
+        if (chunk.used > 0) chunk.buffer->didModifyRange(NS::Range::Make(0, chunk.used));
+    }
+}
+
+NS::UInteger FrameAllocator::used() const {
+    NS::UInteger used = 0;
+    for (const Chunk& chunk : m_rings[m_frame]) used += chunk.used;
+    return used;
+}
+
+NS::UInteger FrameAllocator::capacity() const {
+    NS::UInteger capacity = 0;
+    for (const Chunk& chunk : m_rings[m_frame]) capacity += chunk.buffer->length();
+    return capacity;
+}
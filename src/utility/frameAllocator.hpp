@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <Metal/Metal.hpp>
+
+// Bump allocator for data that only lives for one frame: camera constants, light counts,
+// instance data of the sorted draws. Every frame in flight owns a persistently mapped ring,
+// beginFrame rewinds it once the frame semaphore says the GPU is done with it.
+// Allocations that do not fit add a chunk, the next time the frame comes around its chunks
+// are merged into one buffer big enough for all of them. Not thread safe, allocate up front
+// and hand the pointers to jobs.
+class FrameAllocator {
+public:
+    // Offset alignment Metal wants for constant address space buffers on macOS
+    static constexpr NS::UInteger kAlignment = 256;
+
+    struct Allocation {
+        MTL::Buffer* buffer = nullptr;
+        NS::UInteger offset = 0;
+        void* data = nullptr;
+
+        template <typename T>
+        T* as() const { return static_cast<T*>(data); }
+    };
+
+    FrameAllocator() = default;
+    ~FrameAllocator();
+
+    FrameAllocator(const FrameAllocator&) = delete;
+    FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+    void init(MTL::Device* device, size_t framesInFlight, NS::UInteger capacity);
+
+    // Call after waiting on the frame semaphore for this frame
+    void beginFrame(size_t frame);
+    Allocation allocate(NS::UInteger size, NS::UInteger alignment = kAlignment);
+    template <typename T>
+    Allocation push(const T& value) {
+        Allocation allocation = allocate(sizeof(T));
+        std::memcpy(allocation.data, &value, sizeof(T));
+        return allocation;
+    }
+    // Marks what this frame wrote as modified, before the command buffer is committed
+    void flush();
+
+    NS::UInteger used() const;
+    NS::UInteger capacity() const;
+
+private:
+    struct Chunk {
+        MTL::Buffer* buffer;
+        NS::UInteger used;
+    };
+
+    MTL::Device* m_device = nullptr;
+    std::vector<std::vector<Chunk>> m_rings;
+    size_t m_frame = 0;
+
+    MTL::Buffer* newBuffer(NS::UInteger capacity);
+};
@@ -0,0 +1,202 @@
+#include "frustumCulling.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FRUSTUM_CULLING_AVX2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FRUSTUM_CULLING_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define FRUSTUM_CULLING_SSE2 1
+#endif
+
+namespace {
+    constexpr size_t kBatch = 8;
+
+    // Plane normals, their absolute values for the box extents, and offsets
+    struct Planes {
+        float normal[6][3];
+        float absNormal[6][3];
+        float offset[6];
+    };
+
+    Planes unpack(const culling::Frustum& frustum) {
+        Planes planes;
+        for (int p = 0; p < 6; p++) {
+            for (int axis = 0; axis < 3; axis++) {
+                planes.normal[p][axis] = frustum.planes[p][axis];
+                planes.absNormal[p][axis] = std::fabs(frustum.planes[p][axis]);
+            }
+            planes.offset[p] = frustum.planes[p].w;
+        }
+        return planes;
+    }
+
+    // A box is outside a plane when its centre is further behind it than the box's extent
+    // projected onto the normal. One bit per box of the batch starting at i.
+#if FRUSTUM_CULLING_AVX2
+    uint32_t insideMask(const culling::BoxSet& boxes, size_t i, const Planes& planes) {
+        __m256 cx = _mm256_loadu_ps(boxes.centerX.data() + i);
+        __m256 cy = _mm256_loadu_ps(boxes.centerY.data() + i);
+        __m256 cz = _mm256_loadu_ps(boxes.centerZ.data() + i);
+        __m256 ex = _mm256_loadu_ps(boxes.extentX.data() + i);
+        __m256 ey = _mm256_loadu_ps(boxes.extentY.data() + i);
+        __m256 ez = _mm256_loadu_ps(boxes.extentZ.data() + i);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m256 distance = _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(planes.normal[p][0])), _mm256_set1_ps(planes.offset[p]));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(cy, _mm256_set1_ps(planes.normal[p][1])));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(cz, _mm256_set1_ps(planes.normal[p][2])));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(ex, _mm256_set1_ps(planes.absNormal[p][0])));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(ey, _mm256_set1_ps(planes.absNormal[p][1])));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(ez, _mm256_set1_ps(planes.absNormal[p][2])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        return (uint32_t)_mm256_movemask_ps(inside);
+    }
+#elif FRUSTUM_CULLING_NEON
+    uint32_t insideMask4(const culling::BoxSet& boxes, size_t i, const Planes& planes) {
+        float32x4_t cx = vld1q_f32(boxes.centerX.data() + i);
+        float32x4_t cy = vld1q_f32(boxes.centerY.data() + i);
+        float32x4_t cz = vld1q_f32(boxes.centerZ.data() + i);
+        float32x4_t ex = vld1q_f32(boxes.extentX.data() + i);
+        float32x4_t ey = vld1q_f32(boxes.extentY.data() + i);
+        float32x4_t ez = vld1q_f32(boxes.extentZ.data() + i);
+
+        uint32x4_t inside = vdupq_n_u32(0xFFFFFFFF);
+        for (int p = 0; p < 6; p++) {
+            float32x4_t distance = vmlaq_n_f32(vdupq_n_f32(planes.offset[p]), cx, planes.normal[p][0]);
+            distance = vmlaq_n_f32(distance, cy, planes.normal[p][1]);
+            distance = vmlaq_n_f32(distance, cz, planes.normal[p][2]);
+            distance = vmlaq_n_f32(distance, ex, planes.absNormal[p][0]);
+            distance = vmlaq_n_f32(distance, ey, planes.absNormal[p][1]);
+            distance = vmlaq_n_f32(distance, ez, planes.absNormal[p][2]);
+            inside = vandq_u32(inside, vcgeq_f32(distance, vdupq_n_f32(0.0f)));
+        }
+        const uint32_t bits[4] = { 1, 2, 4, 8 };
+        return vaddvq_u32(vandq_u32(inside, vld1q_u32(bits)));
+    }
+
+    uint32_t insideMask(const culling::BoxSet& boxes, size_t i, const Planes& planes) {
+        return insideMask4(boxes, i, planes) | insideMask4(boxes, i + 4, planes) << 4;
+    }
+#elif FRUSTUM_CULLING_SSE2
+    uint32_t insideMask4(const culling::BoxSet& boxes, size_t i, const Planes& planes) {
+        __m128 cx = _mm_loadu_ps(boxes.centerX.data() + i);
+        __m128 cy = _mm_loadu_ps(boxes.centerY.data() + i);
+        __m128 cz = _mm_loadu_ps(boxes.centerZ.data() + i);
+        __m128 ex = _mm_loadu_ps(boxes.extentX.data() + i);
+        __m128 ey = _mm_loadu_ps(boxes.extentY.data() + i);
+        __m128 ez = _mm_loadu_ps(boxes.extentZ.data() + i);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(planes.normal[p][0])), _mm_set1_ps(planes.offset[p]));
+            distance = _mm_add_ps(distance, _mm_mul_ps(cy, _mm_set1_ps(planes.normal[p][1])));
+            distance = _mm_add_ps(distance, _mm_mul_ps(cz, _mm_set1_ps(planes.normal[p][2])));
+            distance = _mm_add_ps(distance, _mm_mul_ps(ex, _mm_set1_ps(planes.absNormal[p][0])));
+            distance = _mm_add_ps(distance, _mm_mul_ps(ey, _mm_set1_ps(planes.absNormal[p][1])));
+            distance = _mm_add_ps(distance, _mm_mul_ps(ez, _mm_set1_ps(planes.absNormal[p][2])));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+        }
+        return (uint32_t)_mm_movemask_ps(inside);
+    }
+
+    uint32_t insideMask(const culling::BoxSet& boxes, size_t i, const Planes& planes) {
+        return insideMask4(boxes, i, planes) | insideMask4(boxes, i + 4, planes) << 4;
+    }
+#else
+    uint32_t insideMask(const culling::BoxSet& boxes, size_t i, const Planes& planes) {
+        uint32_t mask = 0;
+        for (size_t lane = 0; lane < kBatch; lane++) {
+            const size_t box = i + lane;
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; p++) {
+                float distance = boxes.centerX[box] * planes.normal[p][0] + boxes.centerY[box] * planes.normal[p][1] +
+                                 boxes.centerZ[box] * planes.normal[p][2] + planes.offset[p] +
+                                 boxes.extentX[box] * planes.absNormal[p][0] + boxes.extentY[box] * planes.absNormal[p][1] +
+                                 boxes.extentZ[box] * planes.absNormal[p][2];
+                inside = distance >= 0.0f;
+            }
+            if (inside) mask |= 1u << lane;
+        }
+        return mask;
+    }
+#endif
+}
+
+void culling::transformBox(const Bounds& bounds, const simd::float4x4& transform, simd::float3& center, simd::float3& extent) {
+    simd::float3 localCenter = (bounds.min + bounds.max) * 0.5f;
+    simd::float3 localExtent = (bounds.max - bounds.min) * 0.5f;
+
+    center = simd_mul(transform, simd_make_float4(localCenter, 1.0f)).xyz;
+    extent = simd::abs(transform.columns[0].xyz) * localExtent.x +
+             simd::abs(transform.columns[1].xyz) * localExtent.y +
+             simd::abs(transform.columns[2].xyz) * localExtent.z;
+}
+
+culling::Frustum culling::makeFrustum(const simd::float4x4& viewProjection) {
+    simd::float4 rows[4];
+    for (int row = 0; row < 4; row++) {
+        rows[row] = simd_make_float4(viewProjection.columns[0][row], viewProjection.columns[1][row],
+                                     viewProjection.columns[2][row], viewProjection.columns[3][row]);
+    }
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[3] + rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+
+    // Unit normals so plane distances are real distances, which the sphere test needs
+    for (simd::float4& plane : frustum.planes) {
+        float length = simd::length(plane.xyz);
+        if (length > 0.0f) plane = plane / length;
+    }
+    return frustum;
+}
+
+bool culling::intersects(const Frustum& frustum, simd::float3 center, float radius) {
+    for (const simd::float4& plane : frustum.planes) {
+        if (simd::dot(plane.xyz, center) + plane.w < -radius) return false;
+    }
+    return true;
+}
+
+void culling::BoxSet::resize(size_t count) {
+    const size_t padded = (count + kBatch - 1) / kBatch * kBatch;
+    for (std::vector<float>* channel : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+        channel->assign(padded, 0.0f);
+    }
+    this->count = count;
+}
+
+void culling::BoxSet::set(size_t index, simd::float3 center, simd::float3 extent) {
+    centerX[index] = center.x;
+    centerY[index] = center.y;
+    centerZ[index] = center.z;
+    extentX[index] = extent.x;
+    extentY[index] = extent.y;
+    extentZ[index] = extent.z;
+}
+
+size_t culling::cull(const Frustum& frustum, const BoxSet& boxes, uint32_t* visible) {
+    const Planes planes = unpack(frustum);
+
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < boxes.count; i += kBatch) {
+        uint32_t mask = insideMask(boxes, i, planes);
+        // Padding lanes past count hold empty boxes at the origin, drop them
+        if (boxes.count - i < kBatch) mask &= (1u << (boxes.count - i)) - 1;
+
+        while (mask) {
+            visible[visibleCount++] = (uint32_t)(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    return visibleCount;
+}
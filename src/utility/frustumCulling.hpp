@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <simd/simd.h>
+
+// View frustum tests for mesh instances. Meshes get local bounds at import, models keep
+// the world-space boxes of all their instances in SoA form and cull them eight at a time.
+namespace culling {
+    struct Bounds {
+        simd::float3 min = simd_make_float3(0.0f, 0.0f, 0.0f);
+        simd::float3 max = simd_make_float3(0.0f, 0.0f, 0.0f);
+        // Sphere centred on the box, radius reaches the farthest point rather than the corners
+        simd::float3 center = simd_make_float3(0.0f, 0.0f, 0.0f);
+        float radius = 0.0f;
+    };
+
+    // pointAt(i) returns the position of point i
+    template <typename PointAt>
+    Bounds computeBounds(size_t count, PointAt pointAt) {
+        Bounds bounds;
+        if (count == 0) return bounds;
+
+        bounds.min = bounds.max = pointAt(0);
+        for (size_t i = 1; i < count; i++) {
+            simd::float3 point = pointAt(i);
+            bounds.min = simd::min(bounds.min, point);
+            bounds.max = simd::max(bounds.max, point);
+        }
+
+        bounds.center = (bounds.min + bounds.max) * 0.5f;
+        float radiusSquared = 0.0f;
+        for (size_t i = 0; i < count; i++) {
+            radiusSquared = std::max(radiusSquared, simd::length_squared(pointAt(i) - bounds.center));
+        }
+        bounds.radius = std::sqrt(radiusSquared);
+        return bounds;
+    }
+
+    // Centre and half extents of the box around bounds after transform
+    void transformBox(const Bounds& bounds, const simd::float4x4& transform, simd::float3& center, simd::float3& extent);
+
+    // Planes point inwards, a point p is inside when dot(plane.xyz, p) + plane.w >= 0
+    struct Frustum {
+        simd::float4 planes[6];
+    };
+
+    // Planes of a projection * view matrix. The near plane uses the -w..w depth range,
+    // which also holds everything in Metal's 0..w.
+    Frustum makeFrustum(const simd::float4x4& viewProjection);
+
+    bool intersects(const Frustum& frustum, simd::float3 center, float radius);
+
+    // World-space boxes as centre and half extents, channels padded to whole batches of eight
+    struct BoxSet {
+        std::vector<float> centerX, centerY, centerZ;
+        std::vector<float> extentX, extentY, extentZ;
+        size_t count = 0;
+
+        void resize(size_t count);
+        void set(size_t index, simd::float3 center, simd::float3 extent);
+    };
+
+    // Writes the indices of boxes that touch the frustum to visible in ascending order and
+    // returns how many there are. visible needs room for boxes.count entries. AVX2, NEON or SSE2
+    // where available.
+    size_t cull(const Frustum& frustum, const BoxSet& boxes, uint32_t* visible);
+}
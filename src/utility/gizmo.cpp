@@ -92,7 +92,7 @@ float gizmo_utils::closestDistanceBetweenLines(Ray& line1, Ray& line2) {
     }
 }
 
-void Gizmo::draw(MTL::RenderCommandEncoder* encoder) {
+void Gizmo::draw(StateEncoder& encoder, FrameAllocator& allocator) {
     simd::float3 vertices[] = {
         simd_make_float3(0.0, 0.0, 0.0),
         simd_make_float3(0.0, 1.0, 0.0),
@@ -101,7 +101,8 @@ void Gizmo::draw(MTL::RenderCommandEncoder* encoder) {
         simd_make_float3(0.0, 0.0, 0.0),
         simd_make_float3(-1.0, 0.0, 1.0),
     };
-    encoder->setVertexBytes(&vertices, sizeof(vertices), 0);
+    FrameAllocator::Allocation vertexData = allocator.push(vertices);
+    encoder.setVertexBuffer(vertexData.buffer, vertexData.offset, 0);
     
     simd::float4x4 transformation = simd_matrix_from_rows(
       (simd::float4) {m_transformation[0][0], m_transformation[1][0], m_transformation[2][0], 0},
@@ -109,7 +110,8 @@ void Gizmo::draw(MTL::RenderCommandEncoder* encoder) {
       (simd::float4) {m_transformation[0][2], m_transformation[1][2], m_transformation[2][2], 0},
       (simd::float4) {m_transformation[0][3], m_transformation[1][3], m_transformation[2][3], m_transformation[3][3]}
       );
-    encoder->setVertexBytes(&transformation, sizeof(transformation), 1);
+    FrameAllocator::Allocation transformData = allocator.push(transformation);
+    encoder.setVertexBuffer(transformData.buffer, transformData.offset, 1);
     
-    encoder->drawPrimitives(MTL::PrimitiveTypeLine, NS::UInteger(0), 6);
+    encoder.drawPrimitives(MTL::PrimitiveTypeLine, NS::UInteger(0), 6);
 }
@@ -11,6 +11,9 @@
 #include <glm/glm/glm.hpp>
 #include <vector>
 
+#include "frameAllocator.hpp"
+#include "stateEncoder.hpp"
+
 struct Ray {
     glm::vec3 origin;
     glm::vec3 direction;
@@ -42,7 +45,7 @@ public:
     Gizmo();
     void manipulateGizmo(Ray& line);
     bool findIntersection(Ray& line);
-    void draw(MTL::RenderCommandEncoder* encoder);
+    void draw(StateEncoder& encoder, FrameAllocator& allocator);
     
 private:
     std::vector<Ray> m_axes;
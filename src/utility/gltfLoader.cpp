@@ -0,0 +1,600 @@
+#include "gltfLoader.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <stb/stb_image.h>
+
+#include "fileIO.h"
+#include "importUtils.hpp"
+#include "jobSystem.hpp"
+#include "json.hpp"
+#include "normalGeneration.hpp"
+#include "tangentFrame.hpp"
+#include "textureBudget.hpp"
+#include "vertexFormat.hpp"
+
+namespace {
+    constexpr uint32_t kGlbMagic = 0x46546C67;
+    constexpr uint32_t kGlbChunkJson = 0x4E4F534A;
+    constexpr uint32_t kGlbChunkBin = 0x004E4942;
+
+    constexpr int kComponentByte = 5120;
+    constexpr int kComponentUnsignedByte = 5121;
+    constexpr int kComponentShort = 5122;
+    constexpr int kComponentUnsignedShort = 5123;
+    constexpr int kComponentUnsignedInt = 5125;
+    constexpr int kComponentFloat = 5126;
+
+    constexpr int kModeTriangles = 4;
+
+    struct BufferData {
+        util::MappedFile file;
+        std::vector<unsigned char> owned;
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+    };
+
+    struct AccessorView {
+        const unsigned char* data = nullptr;
+        size_t count = 0;
+        size_t stride = 0;
+        size_t elementSize = 0;
+        int componentType = 0;
+        int components = 0;
+        bool normalized = false;
+        int bufferView = -1;
+    };
+
+    struct DecodedImage {
+        unsigned char* pixels = nullptr;
+        int width = 0;
+        int height = 0;
+    };
+
+    simd::float4x4 nodeTransform(const json::Value& node) {
+        const json::Value& matrix = node["matrix"];
+        if (matrix.size() == 16) {
+            simd::float4x4 result;
+            for (int c = 0; c < 4; c++) {
+                result.columns[c] = simd_make_float4(matrix[c * 4].asNumber(), matrix[c * 4 + 1].asNumber(),
+                                                     matrix[c * 4 + 2].asNumber(), matrix[c * 4 + 3].asNumber());
+            }
+            return result;
+        }
+
+        const json::Value& translation = node["translation"];
+        const json::Value& rotation = node["rotation"];
+        const json::Value& scale = node["scale"];
+
+        auto element = [](const json::Value& array, size_t index, double fallback) {
+            return (float)array[index].asNumber(fallback);
+        };
+
+        simd::quatf orientation = rotation.size() == 4
+            ? simd_quaternion(element(rotation, 0, 0.0), element(rotation, 1, 0.0), element(rotation, 2, 0.0), element(rotation, 3, 1.0))
+            : simd_quaternion(0.0f, 0.0f, 0.0f, 1.0f);
+        simd::float4x4 result = simd_matrix4x4(orientation);
+        if (scale.size() == 3) {
+            for (size_t c = 0; c < 3; c++) result.columns[c] *= element(scale, c, 1.0);
+        }
+        if (translation.size() == 3) {
+            result.columns[3] = simd_make_float4(element(translation, 0, 0.0), element(translation, 1, 0.0), element(translation, 2, 0.0), 1.0f);
+        }
+        return result;
+    }
+
+    // Every node that references a glTF mesh adds an instance to each of its primitives
+    void collectInstances(const json::Value& document, int nodeIndex, const simd::float4x4& parentTransform, size_t depth,
+                          const std::vector<std::vector<size_t>>& primitiveMeshes, std::vector<std::vector<simd::float4x4>>& instances) {
+        const json::Value& nodes = document["nodes"];
+        if (nodeIndex < 0 || (size_t)nodeIndex >= nodes.size() || depth > nodes.size()) return;
+
+        const json::Value& node = nodes[nodeIndex];
+        simd::float4x4 transform = simd_mul(parentTransform, nodeTransform(node));
+
+        int meshIndex = node["mesh"].asInt(-1);
+        if (meshIndex >= 0 && (size_t)meshIndex < primitiveMeshes.size()) {
+            for (size_t mesh : primitiveMeshes[meshIndex]) instances[mesh].push_back(transform);
+        }
+
+        const json::Value& children = node["children"];
+        for (size_t i = 0; i < children.size(); i++) {
+            collectInstances(document, children[i].asInt(-1), transform, depth + 1, primitiveMeshes, instances);
+        }
+    }
+
+    size_t componentSize(int componentType) {
+        switch (componentType) {
+            case kComponentByte:
+            case kComponentUnsignedByte: return 1;
+            case kComponentShort:
+            case kComponentUnsignedShort: return 2;
+            case kComponentUnsignedInt:
+            case kComponentFloat: return 4;
+            default: return 0;
+        }
+    }
+
+    int componentCount(const std::string& type) {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        if (type == "MAT4") return 16;
+        return 0;
+    }
+
+    bool decodeBase64(const std::string& input, size_t start, std::vector<unsigned char>& out) {
+        static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        int table[256];
+        for (int i = 0; i < 256; i++) table[i] = -1;
+        for (int i = 0; i < 64; i++) table[(unsigned char)alphabet[i]] = i;
+
+        out.clear();
+        out.reserve((input.size() - start) * 3 / 4);
+
+        unsigned int accumulator = 0;
+        int bits = 0;
+        for (size_t i = start; i < input.size(); i++) {
+            char c = input[i];
+            if (c == '=') break;
+            int value = table[(unsigned char)c];
+            if (value < 0) return false;
+
+            accumulator = (accumulator << 6) | (unsigned int)value;
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                out.push_back((unsigned char)((accumulator >> bits) & 0xFF));
+            }
+        }
+        return true;
+    }
+
+    bool loadUri(const std::string& uri, const std::string& directory, BufferData& buffer) {
+        if (uri.compare(0, 5, "data:") == 0) {
+            size_t comma = uri.find(',');
+            if (comma == std::string::npos || uri.find(";base64") > comma) return false;
+            if (!decodeBase64(uri, comma + 1, buffer.owned)) return false;
+
+            buffer.data = buffer.owned.data();
+            buffer.size = buffer.owned.size();
+            return true;
+        }
+
+        buffer.file = util::MappedFile(directory + "/" + uri);
+        buffer.data = buffer.file.data();
+        buffer.size = buffer.file.size();
+        return buffer.file.isValid();
+    }
+
+    bool resolveAccessor(const json::Value& document, std::vector<BufferData>& buffers, int index, AccessorView& view) {
+        const json::Value& accessor = document["accessors"][index];
+        if (!accessor.isObject()) return false;
+
+        if (accessor.has("sparse")) {
+            std::cout << "Error::glTF::Sparse accessors are not supported" << std::endl;
+            return false;
+        }
+
+        view.bufferView = accessor["bufferView"].asInt(-1);
+        if (view.bufferView < 0) return false;
+
+        const json::Value& bufferView = document["bufferViews"][view.bufferView];
+        const int count = accessor["count"].asInt(-1);
+        const int accessorOffset = accessor["byteOffset"].asInt();
+        const int viewOffset = bufferView["byteOffset"].asInt();
+        const int viewLength = bufferView["byteLength"].asInt(-1);
+        const int stride = bufferView["byteStride"].asInt();
+        if (count < 0 || accessorOffset < 0 || viewOffset < 0 || viewLength < 0 || stride < 0) {
+            std::cout << "Error::glTF::Accessor " << index << " has a negative count, offset or length" << std::endl;
+            return false;
+        }
+
+        view.componentType = accessor["componentType"].asInt();
+        view.components = componentCount(accessor["type"].asString());
+        view.count = (size_t)count;
+        view.normalized = accessor["normalized"].asBool();
+        view.elementSize = componentSize(view.componentType) * view.components;
+        if (view.elementSize == 0) return false;
+
+        int bufferIndex = bufferView["buffer"].asInt(-1);
+        if (bufferIndex < 0 || bufferIndex >= (int)buffers.size()) return false;
+        const BufferData& buffer = buffers[bufferIndex];
+
+        view.stride = stride == 0 ? view.elementSize : (size_t)stride;
+
+        // offset + stride * (count - 1) + elementSize <= length, rearranged so nothing can overflow
+        const size_t length = (size_t)viewLength;
+        const size_t offset = (size_t)accessorOffset;
+        bool inBounds = (size_t)viewOffset <= buffer.size && length <= buffer.size - (size_t)viewOffset && offset <= length;
+        if (inBounds && view.count > 0) {
+            inBounds = view.elementSize <= length - offset && view.count - 1 <= (length - offset - view.elementSize) / view.stride;
+        }
+        if (!inBounds) {
+            std::cout << "Error::glTF::Accessor " << index << " is out of bounds" << std::endl;
+            return false;
+        }
+
+        view.data = buffer.data + viewOffset + accessorOffset;
+        return true;
+    }
+
+    float readComponent(const unsigned char* source, int componentType, bool normalized) {
+        switch (componentType) {
+            case kComponentFloat: {
+                float value;
+                std::memcpy(&value, source, sizeof(float));
+                return value;
+            }
+            case kComponentUnsignedByte:
+                return normalized ? source[0] / 255.0f : source[0];
+            case kComponentByte: {
+                float value = (float)(int8_t)source[0];
+                return normalized ? std::max(value / 127.0f, -1.0f) : value;
+            }
+            case kComponentUnsignedShort: {
+                uint16_t value;
+                std::memcpy(&value, source, sizeof(uint16_t));
+                return normalized ? value / 65535.0f : value;
+            }
+            case kComponentShort: {
+                int16_t value;
+                std::memcpy(&value, source, sizeof(int16_t));
+                return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+            }
+            default:
+                return 0.0f;
+        }
+    }
+
+    uint32_t readIndex(const unsigned char* source, int componentType) {
+        switch (componentType) {
+            case kComponentUnsignedByte:
+                return source[0];
+            case kComponentUnsignedShort: {
+                uint16_t value;
+                std::memcpy(&value, source, sizeof(uint16_t));
+                return value;
+            }
+            case kComponentUnsignedInt: {
+                uint32_t value;
+                std::memcpy(&value, source, sizeof(uint32_t));
+                return value;
+            }
+            default:
+                return 0;
+        }
+    }
+
+    // Widens an accessor into the engine layout. Float data is moved with whole-vector
+    // loads, quantized data is widened component by component.
+    template <int Components, typename Store>
+    void convertAttribute(const AccessorView& view, size_t vertexCount, Store store) {
+        const size_t componentBytes = componentSize(view.componentType);
+        const size_t count = std::min(view.count, vertexCount);
+
+        if (view.componentType == kComponentFloat && view.components >= Components) {
+            for (size_t i = 0; i < count; i++) {
+                simd::float4 value = { 0.0f, 0.0f, 0.0f, 0.0f };
+                std::memcpy(&value, view.data + i * view.stride, sizeof(float) * Components);
+                store(i, value);
+            }
+            return;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            const unsigned char* element = view.data + i * view.stride;
+            simd::float4 value = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (int c = 0; c < Components && c < view.components; c++) {
+                value[c] = readComponent(element + c * componentBytes, view.componentType, view.normalized);
+            }
+            store(i, value);
+        }
+    }
+
+    int imageSource(const json::Value& document, const json::Value& textureInfo) {
+        if (!textureInfo.isObject()) return -1;
+        return document["textures"][textureInfo["index"].asInt()]["source"].asInt(-1);
+    }
+
+    int textureSource(const json::Value& document, const json::Value& textureInfo, const std::vector<Texture>& imageTextures) {
+        int source = imageSource(document, textureInfo);
+        if (source < 0 || source >= (int)imageTextures.size() || !imageTextures[source].actualTexture) return -1;
+        return source;
+    }
+
+    DecodedImage decodeImage(const unsigned char* bytes, size_t length) {
+        DecodedImage image;
+        int components;
+        image.pixels = stbi_load_from_memory(bytes, (int)length, &image.width, &image.height, &components, 4);
+        return image;
+    }
+}
+
+bool gltf::isGltfPath(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return false;
+
+    std::string extension = path.substr(dot + 1);
+    for (char& c : extension) c = (char)std::tolower(c);
+    return extension == "gltf" || extension == "glb";
+}
+
+bool gltf::loadModel(const std::string& path, MTL::Device* device, std::vector<Mesh>& meshes, std::vector<std::vector<simd::float4x4>>& instances,
+                     std::vector<Texture>& texturesLoaded) {
+    std::string directory = path.substr(0, path.find_last_of('/'));
+
+    util::MappedFile file(path);
+    if (!file.isValid()) {
+        std::cout << "Error::glTF::Could not open " << path << std::endl;
+        return false;
+    }
+
+    const char* jsonText = reinterpret_cast<const char*>(file.data());
+    size_t jsonLength = file.size();
+    const unsigned char* binChunk = nullptr;
+    size_t binLength = 0;
+
+    uint32_t magic = 0;
+    if (file.size() >= 12) std::memcpy(&magic, file.data(), sizeof(uint32_t));
+
+    if (magic == kGlbMagic) {
+        size_t offset = 12;
+        jsonText = nullptr;
+        while (offset + 8 <= file.size()) {
+            uint32_t chunkLength, chunkType;
+            std::memcpy(&chunkLength, file.data() + offset, sizeof(uint32_t));
+            std::memcpy(&chunkType, file.data() + offset + 4, sizeof(uint32_t));
+            offset += 8;
+            if (offset + chunkLength > file.size()) break;
+
+            if (chunkType == kGlbChunkJson && !jsonText) {
+                jsonText = reinterpret_cast<const char*>(file.data() + offset);
+                jsonLength = chunkLength;
+            } else if (chunkType == kGlbChunkBin && !binChunk) {
+                binChunk = file.data() + offset;
+                binLength = chunkLength;
+            }
+            offset += (chunkLength + 3) & ~3u;
+        }
+        if (!jsonText) {
+            std::cout << "Error::glTF::Missing JSON chunk in " << path << std::endl;
+            return false;
+        }
+    }
+
+    json::Value document;
+    std::string error;
+    if (!json::parse(jsonText, jsonLength, document, &error)) {
+        std::cout << "Error::glTF::" << error << std::endl;
+        return false;
+    }
+
+    const json::Value& bufferList = document["buffers"];
+    std::vector<BufferData> buffers(bufferList.size());
+    for (size_t i = 0; i < bufferList.size(); i++) {
+        const json::Value& buffer = bufferList[i];
+        if (!buffer.has("uri")) {
+            buffers[i].data = binChunk;
+            buffers[i].size = binLength;
+        } else if (!loadUri(buffer["uri"].asString(), directory, buffers[i])) {
+            std::cout << "Error::glTF::Could not load buffer " << buffer["uri"].asString() << std::endl;
+            return false;
+        }
+    }
+
+    // Decode every image in parallel straight from memory, Metal uploads stay on this thread
+    const json::Value& imageList = document["images"];
+    std::vector<BufferData> imageSources(imageList.size());
+    std::vector<DecodedImage> decodes(imageList.size());
+    jobs::Counter decoding;
+
+    for (size_t i = 0; i < imageList.size(); i++) {
+        const json::Value& image = imageList[i];
+        BufferData& source = imageSources[i];
+
+        if (image.has("bufferView")) {
+            const json::Value& view = document["bufferViews"][image["bufferView"].asInt()];
+            int bufferIndex = view["buffer"].asInt(-1);
+            int offset = view["byteOffset"].asInt();
+            int length = view["byteLength"].asInt(-1);
+            if (bufferIndex >= 0 && bufferIndex < (int)buffers.size() && offset >= 0 && length >= 0 &&
+                (size_t)offset <= buffers[bufferIndex].size && (size_t)length <= buffers[bufferIndex].size - (size_t)offset) {
+                source.data = buffers[bufferIndex].data + offset;
+                source.size = length;
+            }
+        } else if (image.has("uri")) {
+            loadUri(image["uri"].asString(), directory, source);
+        }
+
+        if (!source.data) continue;
+        jobs::run([&source, &decoded = decodes[i]]() {
+            decoded = decodeImage(source.data, source.size);
+        }, &decoding);
+    }
+    jobs::wait(decoding);
+
+    std::vector<Texture> imageTextures(imageList.size());
+    std::vector<texturePacker::Image> decodedImages;
+    std::vector<Texture*> decodedTextures;
+    for (size_t i = 0; i < decodes.size(); i++) {
+        const DecodedImage& decoded = decodes[i];
+        std::string name = imageList[i].has("uri") ? imageList[i]["uri"].asString() : "image" + std::to_string(i);
+
+        Texture& texture = imageTextures[i];
+        texture.actualTexture = nullptr;
+        texture.type = "diffuse";
+        texture.path = name;
+
+        if (decoded.pixels) {
+            texturePacker::Image image;
+            image.width = decoded.width;
+            image.height = decoded.height;
+            image.channels = 4;
+            image.pixels.assign(decoded.pixels, decoded.pixels + (size_t)decoded.width * decoded.height * 4);
+            decodedImages.push_back(std::move(image));
+            decodedTextures.push_back(&texture);
+        } else {
+            std::cout << "Texture failed to load at path: " << name << std::endl;
+        }
+        stbi_image_free(decoded.pixels);
+    }
+
+    // Images only referenced as normal maps give way to base colour under the texture budget
+    std::vector<bool> normalOnly(imageList.size(), false), baseColor(imageList.size(), false);
+    const json::Value& materialList = document["materials"];
+    for (size_t i = 0; i < materialList.size(); i++) {
+        int normalSource = imageSource(document, materialList[i]["normalTexture"]);
+        int colorSource = imageSource(document, materialList[i]["pbrMetallicRoughness"]["baseColorTexture"]);
+        if (normalSource >= 0 && normalSource < (int)imageList.size()) normalOnly[normalSource] = true;
+        if (colorSource >= 0 && colorSource < (int)imageList.size()) baseColor[colorSource] = true;
+    }
+
+    std::vector<textureBudget::Usage> usage;
+    for (const Texture* texture : decodedTextures) {
+        size_t image = texture - imageTextures.data();
+        usage.push_back({ normalOnly[image] && !baseColor[image] ? "normal" : "diffuse", 1.0f });
+    }
+    textureBudget::fit(decodedImages, usage);
+    importUtils::uploadPacked(decodedImages, decodedTextures, device);
+    for (const Texture* texture : decodedTextures) {
+        if (texture->actualTexture) texturesLoaded.push_back(*texture);
+    }
+
+    const json::Value& meshList = document["meshes"];
+    std::vector<std::vector<size_t>> primitiveMeshes(meshList.size());
+    for (size_t m = 0; m < meshList.size(); m++) {
+        const json::Value& primitives = meshList[m]["primitives"];
+
+        for (size_t p = 0; p < primitives.size(); p++) {
+            const json::Value& primitive = primitives[p];
+            if (primitive["mode"].asInt(kModeTriangles) != kModeTriangles) {
+                std::cout << "Error::glTF::Skipping non-triangle primitive in mesh " << m << std::endl;
+                continue;
+            }
+
+            std::vector<Texture> textures;
+            TypeEndpoints endpoints = {
+                -1, -1, -1, -1
+            };
+
+            if (primitive.has("material")) {
+                const json::Value& material = document["materials"][primitive["material"].asInt()];
+                int baseColor = textureSource(document, material["pbrMetallicRoughness"]["baseColorTexture"], imageTextures);
+                if (baseColor >= 0) {
+                    endpoints.diffuse = (int)textures.size();
+                    textures.push_back(imageTextures[baseColor]);
+                }
+
+                int normalMap = textureSource(document, material["normalTexture"], imageTextures);
+                if (normalMap >= 0) {
+                    endpoints.normal = (int)textures.size();
+                    textures.push_back(imageTextures[normalMap]);
+                    textures.back().type = "normal";
+                }
+            }
+
+            const json::Value& attributes = primitive["attributes"];
+            AccessorView position, normal, texCoord, tangent;
+            if (!resolveAccessor(document, buffers, attributes["POSITION"].asInt(-1), position)) {
+                std::cout << "Error::glTF::Primitive without usable POSITION in mesh " << m << std::endl;
+                continue;
+            }
+            const size_t vertexCount = position.count;
+            if (vertexCount == 0) continue;
+
+            // Normals and tangents that don't cover every vertex are treated as missing
+            bool hasNormal = resolveAccessor(document, buffers, attributes["NORMAL"].asInt(-1), normal) && normal.count >= vertexCount;
+            bool hasTexCoord = resolveAccessor(document, buffers, attributes["TEXCOORD_0"].asInt(-1), texCoord);
+            // The spec has provided tangents ignored when normals are generated, which may also split vertices
+            bool hasTangent = hasNormal && resolveAccessor(document, buffers, attributes["TANGENT"].asInt(-1), tangent) &&
+                              tangent.components == 4 && tangent.count >= vertexCount;
+
+            AccessorView indices;
+            std::vector<uint32_t> indexData;
+            if (primitive.has("indices")) {
+                if (!resolveAccessor(document, buffers, primitive["indices"].asInt(-1), indices)) {
+                    std::cout << "Error::glTF::Primitive with unusable indices in mesh " << m << std::endl;
+                    continue;
+                }
+                // readIndex would read anything else as zeros, which passes the range check
+                const bool indexType = indices.componentType == kComponentUnsignedByte || indices.componentType == kComponentUnsignedShort ||
+                                       indices.componentType == kComponentUnsignedInt;
+                if (indices.components != 1 || !indexType) {
+                    std::cout << "Error::glTF::Primitive with indices that are not unsigned SCALAR in mesh " << m << std::endl;
+                    continue;
+                }
+                indexData.resize(indices.count);
+                for (size_t i = 0; i < indices.count; i++) {
+                    indexData[i] = readIndex(indices.data + i * indices.stride, indices.componentType);
+                }
+            } else {
+                indexData.resize(vertexCount);
+                for (uint32_t i = 0; i < vertexCount; i++) indexData[i] = i;
+            }
+
+            bool validIndices = !indexData.empty() && indexData.size() % 3 == 0;
+            for (size_t i = 0; i < indexData.size() && validIndices; i++) validIndices = indexData[i] < vertexCount;
+            if (!validIndices) {
+                std::cout << "Error::glTF::Primitive with out of range or partial triangle indices in mesh " << m << std::endl;
+                continue;
+            }
+
+            std::vector<Vertex> vertices(vertexCount);
+            std::memset(vertices.data(), 0, vertices.size() * sizeof(Vertex));
+
+            convertAttribute<3>(position, vertexCount, [&](size_t i, simd::float4 value) {
+                vertexFormat::write<Vertex, vertexFormat::Semantic::Position>(vertices[i], value);
+            });
+            if (hasNormal) {
+                convertAttribute<3>(normal, vertexCount, [&](size_t i, simd::float4 value) {
+                    vertexFormat::write<Vertex, vertexFormat::Semantic::Normal>(vertices[i], value);
+                });
+            }
+            if (hasTexCoord) {
+                convertAttribute<2>(texCoord, vertexCount, [&](size_t i, simd::float4 value) {
+                    vertexFormat::write<Vertex, vertexFormat::Semantic::TexCoord>(vertices[i], value);
+                });
+            }
+
+            if (!hasNormal) {
+                // The spec asks for flat normals when NORMAL is missing, only coplanar faces get smoothed
+                normalGeneration::Options options;
+                options.smoothingAngleDegrees = 0.0f;
+                normalGeneration::generateNormals(vertices, indexData, options);
+            }
+
+            if (hasTangent) {
+                convertAttribute<4>(tangent, vertexCount, [&](size_t i, simd::float4 value) {
+                    vertexFormat::writeQTangent(vertices[i], tangentFrame::encodeQTangent(vertices[i].normal, value.xyz, value.w));
+                });
+            } else {
+                tangentFrame::generateTangents(vertices, indexData);
+            }
+
+            // Normal generation can split vertices and rewrite indices, so indices go up after vertices
+            MTL::Buffer* vertexBuffer = device->newBuffer(vertices.data(), vertices.size() * sizeof(Vertex), MTL::ResourceStorageModeManaged);
+            MTL::Buffer* indexBuffer = device->newBuffer(indexData.data(), indexData.size() * sizeof(uint32_t), MTL::ResourceStorageModeManaged);
+            const unsigned int indexCount = (unsigned int)indexData.size();
+            const culling::Bounds bounds = culling::computeBounds(vertices.size(), [&](size_t i) { return vertices[i].position; });
+
+            primitiveMeshes[m].push_back(meshes.size());
+            meshes.push_back(Mesh(vertexBuffer, indexBuffer, indexCount, textures, endpoints));
+            meshes.back().bounds = bounds;
+        }
+    }
+
+    // Without a scene every mesh keeps its single identity instance
+    instances.resize(meshes.size());
+    const json::Value& scene = document["scenes"][document["scene"].asInt(0)];
+    const json::Value& roots = scene["nodes"];
+    for (size_t i = 0; i < roots.size(); i++) {
+        collectInstances(document, roots[i].asInt(-1), matrix_identity_float4x4, 0, primitiveMeshes, instances);
+    }
+
+    return true;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <Metal/Metal.hpp>
+
+#include "mesh.h"
+
+namespace gltf {
+    // Loads a .gltf or .glb file without going through Assimp. Accessors are read in
+    // place from the mapped file and converted into the Vertex layout, primitives with
+    // out of bounds accessors or indices are skipped. instances gets the node transforms
+    // of every mesh, empty for meshes no node references.
+    bool loadModel(const std::string& path, MTL::Device* device, std::vector<Mesh>& meshes, std::vector<std::vector<simd::float4x4>>& instances,
+                   std::vector<Texture>& texturesLoaded);
+
+    bool isGltfPath(const std::string& path);
+}
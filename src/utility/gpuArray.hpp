@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <Metal/Metal.hpp>
+
+// Array of structs already laid out the way a shader reads them, mirrored into one Metal
+// buffer per frame in flight. Writes go through push_back and edit, which mark entries dirty
+// in every mirror; upload only copies what changed since that mirror was last uploaded, so an
+// array nobody touched costs nothing per frame. Mirrors grow on demand by doubling.
+template <typename T>
+class GpuArray {
+public:
+    explicit GpuArray(size_t framesInFlight) : m_mirrors(framesInFlight) {}
+    ~GpuArray() {
+        for (Mirror& mirror : m_mirrors) {
+            if (mirror.buffer) mirror.buffer->release();
+        }
+    }
+
+    GpuArray(const GpuArray&) = delete;
+    GpuArray& operator=(const GpuArray&) = delete;
+
+    size_t size() const { return m_items.size(); }
+    const T& operator[](size_t index) const { return m_items[index]; }
+
+    void push_back(const T& item) {
+        m_items.push_back(item);
+        markDirty(m_items.size() - 1, m_items.size());
+    }
+
+    // Marks the entry dirty, only call it for entries that actually change
+    T& edit(size_t index) {
+        markDirty(index, index + 1);
+        return m_items[index];
+    }
+
+    // Replaces every entry, for arrays rebuilt as a whole. Identical contents change nothing.
+    void assign(const T* items, size_t count) {
+        if (count == m_items.size() && (count == 0 || std::memcmp(m_items.data(), items, count * sizeof(T)) == 0)) return;
+        m_items.assign(items, items + count);
+        // Ranges left from a longer array would reach past the new end, start them over
+        for (Mirror& mirror : m_mirrors) {
+            mirror.dirtyBegin = 0;
+            mirror.dirtyEnd = count;
+        }
+        m_version++;
+    }
+
+    // Bumped by every change, for data derived from the entries
+    uint64_t version() const { return m_version; }
+
+    // Call once the frame semaphore says the GPU is done with this frame's mirror.
+    // Always returns a buffer, even for an empty array.
+    MTL::Buffer* upload(MTL::Device* device, size_t frame) {
+        Mirror& mirror = m_mirrors[frame];
+        const size_t requiredSize = std::max<size_t>(1, m_items.size()) * sizeof(T);
+        if (!mirror.buffer || mirror.buffer->length() < requiredSize) {
+            size_t capacity = mirror.buffer ? mirror.buffer->length() : 16 * sizeof(T);
+            while (capacity < requiredSize) capacity *= 2;
+
+            if (mirror.buffer) mirror.buffer->release();
+            mirror.buffer = device->newBuffer(capacity, MTL::ResourceStorageModeManaged);
+            mirror.dirtyBegin = 0;
+            mirror.dirtyEnd = m_items.size();
+        }
+
+        m_uploadedBytes = 0;
+        mirror.dirtyEnd = std::min(mirror.dirtyEnd, m_items.size());
+        if (mirror.dirtyBegin < mirror.dirtyEnd) {
+            const size_t offset = mirror.dirtyBegin * sizeof(T);
+            m_uploadedBytes = (mirror.dirtyEnd - mirror.dirtyBegin) * sizeof(T);
+            std::memcpy(static_cast<uint8_t*>(mirror.buffer->contents()) + offset, m_items.data() + mirror.dirtyBegin, m_uploadedBytes);
+            mirror.buffer->didModifyRange(NS::Range::Make(offset, m_uploadedBytes));
+        }
+        mirror.dirtyBegin = mirror.dirtyEnd = 0;
+        return mirror.buffer;
+    }
+
+    // What the last upload copied
+    size_t uploadedBytes() const { return m_uploadedBytes; }
+
+private:
+    // Entries dirtyBegin to dirtyEnd changed since this mirror was uploaded
+    struct Mirror {
+        MTL::Buffer* buffer = nullptr;
+        size_t dirtyBegin = 0;
+        size_t dirtyEnd = 0;
+    };
+
+    std::vector<T> m_items;
+    std::vector<Mirror> m_mirrors;
+    uint64_t m_version = 0;
+    size_t m_uploadedBytes = 0;
+
+    void markDirty(size_t begin, size_t end) {
+        for (Mirror& mirror : m_mirrors) {
+            if (mirror.dirtyBegin == mirror.dirtyEnd) {
+                mirror.dirtyBegin = begin;
+                mirror.dirtyEnd = end;
+            } else {
+                mirror.dirtyBegin = std::min(mirror.dirtyBegin, begin);
+                mirror.dirtyEnd = std::max(mirror.dirtyEnd, end);
+            }
+        }
+        m_version++;
+    }
+};
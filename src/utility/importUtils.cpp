@@ -1,46 +1,175 @@
 #include "importUtils.hpp"
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <iostream>
 #include <vector>
 
+#include "cookedTexture.hpp"
+#include "fileIO.h"
+#include "normalGeneration.hpp"
+#include "tangentFrame.hpp"
+#include "textureBudget.hpp"
+#include "vertexFormat.hpp"
+
 MTL::Texture* importUtils::textureFromFile(std::string& path, std::string& directory, MTL::Device* device) {
-    std::string filename = directory + "/" + path;
-    
+    texturePacker::Image image;
+    if (!imageFromFile(directory + "/" + path, image)) {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        return nullptr;
+    }
+    return textureFromPixels(image.pixels.data(), image.width, image.height, image.channels, device);
+}
+
+bool importUtils::imageFromFile(const std::string& filename, texturePacker::Image& image) {
     int width, height, nrComponents;
     
-    stbi_info(filename.c_str(), &width, &height, &nrComponents);
-    int numComponents = nrComponents;
-    if (nrComponents == 3) numComponents = 4;
+    if (!stbi_info(filename.c_str(), &width, &height, &nrComponents)) return false;
+    int numComponents = nrComponents == 1 ? 1 : 4;
     
     unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, numComponents);
+    if (!data) return false;
     
-    MTL::Texture* texture = nullptr;
-    if (data) {
-        MTL::PixelFormat format;
-        if (nrComponents == 1) format = MTL::PixelFormatR8Unorm;
-        else if (nrComponents == 3 || nrComponents == 4) format = MTL::PixelFormatRGBA8Unorm;
-        
-        MTL::TextureDescriptor* descriptor = MTL::TextureDescriptor::alloc()->init();
-        descriptor->setWidth(width);
-        descriptor->setHeight(height);
-        descriptor->setPixelFormat(format);
-        descriptor->setTextureType(MTL::TextureType2D);
-        descriptor->setStorageMode(MTL::StorageModeManaged);
-        descriptor->setUsage(MTL::ResourceUsageSample | MTL::ResourceUsageRead | MTL::ResourceUsageWrite);
-        
+    image.width = width;
+    image.height = height;
+    image.channels = numComponents;
+    image.pixels.assign(data, data + (size_t)width * height * numComponents);
+    stbi_image_free(data);
+    return true;
+}
+
+MTL::Texture* importUtils::textureFromPage(const texturePacker::Page& page, MTL::Device* device) {
+    MTL::TextureDescriptor* descriptor = MTL::TextureDescriptor::alloc()->init();
+    descriptor->setWidth(page.width);
+    descriptor->setHeight(page.height);
+    descriptor->setPixelFormat(page.channels == 1 ? MTL::PixelFormatR8Unorm : MTL::PixelFormatRGBA8Unorm);
+    descriptor->setTextureType(MTL::TextureType2D);
+    descriptor->setMipmapLevelCount(page.levels.size());
+    descriptor->setStorageMode(MTL::StorageModeManaged);
+    descriptor->setUsage(MTL::ResourceUsageSample | MTL::ResourceUsageRead);
+    
+    MTL::Texture* texture = device->newTexture(descriptor);
+    for (size_t level = 0; level < page.levels.size(); level++) {
+        NS::UInteger width = std::max(1, page.width >> level);
+        NS::UInteger height = std::max(1, page.height >> level);
         MTL::Region region = MTL::Region(0, 0, 0, width, height, 1);
-        NS::Integer bytesPerRow = 4 * width;
+        texture->replaceRegion(region, level, page.levels[level].data(), width * page.channels);
+    }
+    
+    descriptor->release();
+    return texture;
+}
+
+void importUtils::uploadPacked(const std::vector<texturePacker::Image>& images, const std::vector<Texture*>& textures, MTL::Device* device) {
+    std::vector<const texturePacker::Image*> packable;
+    std::vector<size_t> packableIndices;
+    for (size_t i = 0; i < images.size(); i++) {
+        if (!texturePacker::isPackable(images[i])) continue;
+        packable.push_back(&images[i]);
+        packableIndices.push_back(i);
+    }
+    
+    // A lone small texture gains nothing from a page of its own
+    std::vector<texturePacker::Page> pages;
+    std::vector<texturePacker::Placement> placements;
+    if (packable.size() > 1) {
+        texturePacker::pack(packable, pages, placements);
+    }
+    
+    std::vector<MTL::Texture*> pageTextures;
+    for (const texturePacker::Page& page : pages) {
+        pageTextures.push_back(textureFromPage(page, device));
+    }
+    
+    std::vector<int> pageOf(images.size(), -1);
+    for (size_t i = 0; i < placements.size(); i++) {
+        if (placements[i].page < 0) continue;
         
-        texture = device->newTexture(descriptor);
-        texture->replaceRegion(region, 0, data, bytesPerRow);
-    } else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
+        Texture* texture = textures[packableIndices[i]];
+        texture->actualTexture = pageTextures[placements[i].page];
+        texture->uvTransform = placements[i].uvTransform;
+        pageOf[packableIndices[i]] = placements[i].page;
     }
-    stbi_image_free(data);
+    
+    for (size_t i = 0; i < images.size(); i++) {
+        if (pageOf[i] >= 0) continue;
+        const texturePacker::Image& image = images[i];
+        textures[i]->actualTexture = textureFromPixels(image.pixels.data(), image.width, image.height, image.channels, device);
+    }
+}
+
+MTL::Texture* importUtils::textureFromPixels(const unsigned char* data, int width, int height, int nrComponents, MTL::Device* device) {
+    MTL::PixelFormat format = MTL::PixelFormatRGBA8Unorm;
+    NS::Integer bytesPerPixel = 4;
+    if (nrComponents == 1) {
+        format = MTL::PixelFormatR8Unorm;
+        bytesPerPixel = 1;
+    }
+    
+    MTL::TextureDescriptor* descriptor = MTL::TextureDescriptor::alloc()->init();
+    descriptor->setWidth(width);
+    descriptor->setHeight(height);
+    descriptor->setPixelFormat(format);
+    descriptor->setTextureType(MTL::TextureType2D);
+    descriptor->setStorageMode(MTL::StorageModeManaged);
+    descriptor->setUsage(MTL::ResourceUsageSample | MTL::ResourceUsageRead | MTL::ResourceUsageWrite);
+    
+    MTL::Region region = MTL::Region(0, 0, 0, width, height, 1);
+    NS::Integer bytesPerRow = bytesPerPixel * width;
+    
+    MTL::Texture* texture = device->newTexture(descriptor);
+    texture->replaceRegion(region, 0, data, bytesPerRow);
+    
+    descriptor->release();
     return texture;
 }
 
+MTL::Texture* importUtils::textureFromCooked(const std::string& path, MTL::Device* device) {
+    util::MappedFile file(path);
+    
+    cookedTexture::Format format;
+    std::vector<cookedTexture::MipView> mips;
+    if (!file.isValid() || !cookedTexture::parse(file.data(), file.size(), format, mips)) {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        return nullptr;
+    }
+    
+    MTL::PixelFormat pixelFormat = MTL::PixelFormatRGBA8Unorm;
+    switch (format) {
+        case cookedTexture::Format::RGBA8: pixelFormat = MTL::PixelFormatRGBA8Unorm; break;
+        case cookedTexture::Format::R8: pixelFormat = MTL::PixelFormatR8Unorm; break;
+        case cookedTexture::Format::BC1: pixelFormat = MTL::PixelFormatBC1_RGBA; break;
+        case cookedTexture::Format::BC3: pixelFormat = MTL::PixelFormatBC3_RGBA; break;
+        case cookedTexture::Format::BC4: pixelFormat = MTL::PixelFormatBC4_RUnorm; break;
+    }
+    if (cookedTexture::isBlockCompressed(format) && !device->supportsBCTextureCompression()) {
+        std::cout << "Error::CookedTexture::Device cannot sample BC textures in " << path << std::endl;
+        return nullptr;
+    }
+    
+    MTL::TextureDescriptor* descriptor = MTL::TextureDescriptor::alloc()->init();
+    descriptor->setWidth(mips[0].width);
+    descriptor->setHeight(mips[0].height);
+    descriptor->setPixelFormat(pixelFormat);
+    descriptor->setTextureType(MTL::TextureType2D);
+    descriptor->setMipmapLevelCount(mips.size());
+    descriptor->setStorageMode(MTL::StorageModeManaged);
+    descriptor->setUsage(MTL::ResourceUsageSample | MTL::ResourceUsageRead);
+    
+    MTL::Texture* texture = device->newTexture(descriptor);
+    size_t totalSize = 0;
+    for (size_t level = 0; level < mips.size(); level++) {
+        MTL::Region region = MTL::Region(0, 0, 0, mips[level].width, mips[level].height, 1);
+        texture->replaceRegion(region, level, mips[level].data, cookedTexture::bytesPerRow(format, mips[level].width));
+        totalSize += mips[level].size;
+    }
+    textureBudget::commit(totalSize);
+    
+    descriptor->release();
+    return texture;
+}
 
 MTL::Texture* importUtils::cubemapFromFile(std::string path, MTL::Device* device) {
     std::vector<std::string> facePaths = {
@@ -85,6 +214,114 @@ MTL::Texture* importUtils::cubemapFromFile(std::string path, MTL::Device* device
     return cubeMapTexture;
 }
 
+namespace {
+    // One instantiation per vertex format and source attribute set, chosen once per
+    // mesh so the per-vertex loop carries no branches on what the aiMesh provides
+    template <typename VertexType, bool HasNormals, bool HasTexCoords, bool HasTangents>
+    void convertVertices(const aiMesh* mesh, VertexType* vertices) {
+        using vertexFormat::Semantic;
+        
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+            VertexType& vertex = vertices[i];
+            const aiVector3D& position = mesh->mVertices[i];
+            vertexFormat::write<VertexType, Semantic::Position>(vertex, simd_make_float4(position.x, position.y, position.z, 1.0f));
+            
+            simd::float3 normal = { 0, 0, 0 };
+            if constexpr (HasNormals) {
+                normal = simd_make_float3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+                vertexFormat::write<VertexType, Semantic::Normal>(vertex, simd_make_float4(normal, 0.0f));
+            }
+            
+            if constexpr (HasTexCoords) {
+                const aiVector3D& texCoord = mesh->mTextureCoords[0][i];
+                vertexFormat::write<VertexType, Semantic::TexCoord>(vertex, simd_make_float4(texCoord.x, texCoord.y, 0.0f, 0.0f));
+            }
+            
+            if constexpr (HasNormals && HasTangents && vertexFormat::has<VertexType>(Semantic::QTangent)) {
+                simd::float3 tangent = { mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z };
+                simd::float3 bitangent = { mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z };
+                float handedness = simd::dot(simd::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+                vertexFormat::writeQTangent(vertex, tangentFrame::encodeQTangent(normal, tangent, handedness));
+            }
+        }
+    }
+    
+    template <typename VertexType>
+    using VertexConverter = void (*)(const aiMesh*, VertexType*);
+    
+    template <typename VertexType>
+    VertexConverter<VertexType> selectConverter(const aiMesh* mesh) {
+        static constexpr VertexConverter<VertexType> converters[8] = {
+            convertVertices<VertexType, false, false, false>, convertVertices<VertexType, true, false, false>,
+            convertVertices<VertexType, false, true, false>, convertVertices<VertexType, true, true, false>,
+            convertVertices<VertexType, false, false, true>, convertVertices<VertexType, true, false, true>,
+            convertVertices<VertexType, false, true, true>, convertVertices<VertexType, true, true, true>
+        };
+        
+        unsigned int selector = (mesh->HasNormals() ? 1 : 0) | (mesh->mTextureCoords[0] ? 2 : 0) |
+                                (mesh->HasTangentsAndBitangents() ? 4 : 0);
+        return converters[selector];
+    }
+}
+
+void importUtils::extractGeometry(aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    // Attributes the mesh does not provide stay zero, which is what normal and tangent generation look for
+    vertices.resize(mesh->mNumVertices);
+    std::memset(vertices.data(), 0, vertices.size() * sizeof(Vertex));
+    selectConverter<Vertex>(mesh)(mesh, vertices.data());
+    
+    indices.clear();
+    indices.reserve(mesh->mNumFaces * 3);
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+        const aiFace& face = mesh->mFaces[i];
+        indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+    }
+    
+    if (!mesh->HasNormals()) {
+        normalGeneration::generateNormals(vertices, indices);
+    }
+}
+
+// Assimp matrices are row major with the translation in the last column
+simd::float4x4 importUtils::toMatrix(const aiMatrix4x4& matrix) {
+    return simd_matrix_from_rows(simd_make_float4(matrix.a1, matrix.a2, matrix.a3, matrix.a4),
+                                 simd_make_float4(matrix.b1, matrix.b2, matrix.b3, matrix.b4),
+                                 simd_make_float4(matrix.c1, matrix.c2, matrix.c3, matrix.c4),
+                                 simd_make_float4(matrix.d1, matrix.d2, matrix.d3, matrix.d4));
+}
+
+void importUtils::materialTextures(aiMaterial* material, std::vector<meshCache::CachedTexture>& textures, TypeEndpoints& endpoints) {
+    auto appendTextures = [&](aiTextureType type, const char* typeName, unsigned int limit) {
+        unsigned int count = std::min(material->GetTextureCount(type), limit);
+        for (unsigned int i = 0; i < count; i++) {
+            aiString str;
+            material->GetTexture(type, i, &str);
+            textures.push_back({ typeName, std::string(str.C_Str()) });
+        }
+        return count;
+    };
+    
+    int textureAmount = (int)textures.size();
+    unsigned int added = appendTextures(aiTextureType_DIFFUSE, "diffuse", UINT_MAX);
+    if (added > 0) {
+        endpoints.diffuse = textureAmount;
+        textureAmount += added;
+    }
+    
+    added = appendTextures(aiTextureType_SPECULAR, "specular", UINT_MAX);
+    if (added > 0) {
+        endpoints.specular = textureAmount;
+        textureAmount += added;
+    }
+    
+    // OBJ files declare normal maps through map_Bump, which Assimp reports as a height map
+    added = appendTextures(aiTextureType_NORMALS, "normal", 1);
+    if (added == 0) added = appendTextures(aiTextureType_HEIGHT, "normal", 1);
+    if (added > 0) {
+        endpoints.normal = textureAmount;
+    }
+}
+
 void addModel(MTL::Device* device, std::string& path, std::vector<Model>& importedModels) {
     Model newModel(path, device);
     
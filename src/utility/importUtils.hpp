@@ -12,11 +12,33 @@
 #include <Metal/Metal.hpp>
 
 #include "model.hpp"
+#include "meshCache.hpp"
+#include "texturePacker.hpp"
 
 namespace importUtils {
 MTL::Texture* textureFromFile(std::string& path, std::string& directory, MTL::Device* device);
 
+MTL::Texture* textureFromPixels(const unsigned char* data, int width, int height, int nrComponents, MTL::Device* device);
+
+// Decodes to 1 or 4 channels, the same way textureFromFile does
+bool imageFromFile(const std::string& filename, texturePacker::Image& image);
+
+MTL::Texture* textureFromPage(const texturePacker::Page& page, MTL::Device* device);
+
+// Packs the images small enough to share atlas pages and uploads the rest on their own.
+// textures[i] receives the texture and uv transform for images[i].
+void uploadPacked(const std::vector<texturePacker::Image>& images, const std::vector<Texture*>& textures, MTL::Device* device);
+
+MTL::Texture* textureFromCooked(const std::string& path, MTL::Device* device);
+
 MTL::Texture* cubemapFromFile(std::string path, MTL::Device* device);
 
+// Device-free halves of Model::processMesh, shared with the asset cooker
+void extractGeometry(aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+simd::float4x4 toMatrix(const aiMatrix4x4& matrix);
+
+void materialTextures(aiMaterial* material, std::vector<meshCache::CachedTexture>& textures, TypeEndpoints& endpoints);
+
 void addModel(std::string& path, std::vector<Model>& importedModels);
 }
@@ -0,0 +1,119 @@
+#include "instanceBatch.hpp"
+#include "jobSystem.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    simd::float4 load4(const float* values) {
+        simd::float4 result;
+        std::memcpy(&result, values, sizeof(float) * 4);
+        return result;
+    }
+
+    // Below this the whole grid is cheaper to write than to hand out
+    constexpr size_t kParallelThreshold = 4096;
+
+    size_t paddedCount(size_t count) {
+        return (count + 3) & ~size_t(3);
+    }
+}
+
+void instanceBatch::resize(Field& field, size_t count) {
+    // Padded with zeros to whole batches, the kernel only stores the first count lanes
+    const size_t padded = paddedCount(count);
+    for (std::vector<float>* channel : { &field.offsetX, &field.offsetY, &field.offsetZ, &field.zSpin, &field.ySpin }) {
+        channel->assign(padded, 0.0f);
+    }
+    field.count = count;
+}
+
+void instanceBatch::sincos(simd::float4 x, simd::float4& sine, simd::float4& cosine) {
+    constexpr float kTwoOverPi = 0.636619772367581343f;
+    constexpr float kHalfPi0 = 1.5703125f;
+    constexpr float kHalfPi1 = 4.837512969970703125e-4f;
+    constexpr float kHalfPi2 = 7.54978995489188216e-8f;
+
+    // x = quadrant * pi/2 + r with |r| <= pi/4
+    simd::float4 quadrant = simd::floor(x * kTwoOverPi + 0.5f);
+    simd::float4 r = x - quadrant * kHalfPi0;
+    r = r - quadrant * kHalfPi1;
+    r = r - quadrant * kHalfPi2;
+
+    simd::float4 r2 = r * r;
+    simd::float4 s = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+    simd::float4 c = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+    // Odd quadrants swap sine and cosine, the sign pattern repeats every four quadrants
+    simd::float4 q = quadrant - 4.0f * simd::floor(quadrant * 0.25f);
+    simd::float4 swap = q - 2.0f * simd::floor(q * 0.5f);
+    simd::float4 sineSign = 1.0f - 2.0f * simd::floor(q * 0.5f);
+    simd::float4 shifted = q + 1.0f - 4.0f * simd::floor((q + 1.0f) * 0.25f);
+    simd::float4 cosineSign = 1.0f - 2.0f * simd::floor(shifted * 0.5f);
+
+    sine = sineSign * (s + swap * (c - s));
+    cosine = cosineSign * (c + swap * (s - c));
+}
+
+void instanceBatch::update(const Field& field, const simd::float4x4& objectTransform, const simd::float3& position, float angle, const Output& output) {
+    const size_t count = field.size();
+    if (count > kParallelThreshold) {
+        // Whole batches per range so no two ranges share a step of four
+        jobs::parallelFor(paddedCount(count) / 4, kParallelThreshold / 4, [&](size_t begin, size_t end) {
+            updateRange(field, objectTransform, position, angle, output, begin * 4, std::min(count, end * 4));
+        });
+    } else {
+        updateRange(field, objectTransform, position, angle, output, 0, count);
+    }
+}
+
+void instanceBatch::updateRange(const Field& field, const simd::float4x4& objectTransform, const simd::float3& position, float angle, const Output& output, size_t begin, size_t end) {
+    const size_t count = end;
+    const simd::float4x4& f = objectTransform;
+    unsigned char* base = static_cast<unsigned char*>(output.base);
+
+    for (size_t i = begin; i < count; i += 4) {
+        simd::float4 sinY, cosY, sinZ, cosZ;
+        sincos(load4(field.ySpin.data() + i) * angle, sinY, cosY);
+        sincos(load4(field.zSpin.data() + i) * angle, sinZ, cosZ);
+
+        // rotateY * rotateZ * scale in closed form, l[column][row]
+        const float scale = field.scale;
+        const simd::float4 zero = simd_make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+        const simd::float4 l[3][3] = {
+            { cosY * cosZ * scale, -sinZ * scale, -sinY * cosZ * scale },
+            { cosY * sinZ * scale, cosZ * scale, -sinY * sinZ * scale },
+            { sinY * scale, zero, cosY * scale }
+        };
+
+        simd::float4 px = load4(field.offsetX.data() + i) + position.x;
+        simd::float4 py = load4(field.offsetY.data() + i) + position.y;
+        simd::float4 pz = load4(field.offsetZ.data() + i) + position.z;
+
+        // objectTransform applied to the linear part and the translation, one element per lane
+        simd::float4 w[3][3];
+        for (int column = 0; column < 3; column++) {
+            for (int row = 0; row < 3; row++) {
+                w[column][row] = l[column][0] * f.columns[0][row] + l[column][1] * f.columns[1][row] + l[column][2] * f.columns[2][row];
+            }
+        }
+        simd::float4 t[3];
+        for (int row = 0; row < 3; row++) {
+            t[row] = px * f.columns[0][row] + py * f.columns[1][row] + pz * f.columns[2][row] + f.columns[3][row];
+        }
+
+        const size_t lanes = std::min<size_t>(4, count - i);
+        for (size_t lane = 0; lane < lanes; lane++) {
+            unsigned char* instance = base + (i + lane) * output.stride;
+            simd::float4x4* transform = reinterpret_cast<simd::float4x4*>(instance + output.transformOffset);
+            simd::float3x3* normalTransform = reinterpret_cast<simd::float3x3*>(instance + output.normalTransformOffset);
+
+            for (int column = 0; column < 3; column++) {
+                simd::float3 axis = simd_make_float3(w[column][0][lane], w[column][1][lane], w[column][2][lane]);
+                transform->columns[column] = simd_make_float4(axis, 0.0f);
+                normalTransform->columns[column] = axis;
+            }
+            transform->columns[3] = simd_make_float4(t[0][lane], t[1][lane], t[2][lane], 1.0f);
+        }
+    }
+}
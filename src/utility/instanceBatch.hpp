@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <simd/simd.h>
+
+// Per-frame update of the spinning instance grid drawn by Renderer::draw. Everything
+// that doesn't change between frames is computed once into SoA arrays; each frame
+// only evaluates the two spin rotations and the object rotation, four instances per
+// step, and writes the matrices straight into the mapped instance buffer.
+namespace instanceBatch {
+    struct Field {
+        // Grid position relative to the object centre
+        std::vector<float> offsetX, offsetY, offsetZ;
+        // Multipliers of the animation angle for the Z and Y spin
+        std::vector<float> zSpin, ySpin;
+        float scale = 1.0f;
+        size_t count = 0;
+
+        size_t size() const { return count; }
+    };
+
+    // Where the kernel writes inside each instance struct
+    struct Output {
+        void* base;
+        size_t stride;
+        size_t transformOffset;
+        size_t normalTransformOffset;
+    };
+
+    // Channels hold whole batches of four, fill the first count entries
+    void resize(Field& field, size_t count);
+
+    // Cody-Waite reduction to [-pi/4, pi/4] with minimax polynomials, about 1e-7 absolute error
+    void sincos(simd::float4 x, simd::float4& sine, simd::float4& cosine);
+
+    // Writes objectTransform * translate(position + offset) * rotateY(angle * ySpin) *
+    // rotateZ(angle * zSpin) * scale for every instance, with the math::make*Rotate conventions
+    void update(const Field& field, const simd::float4x4& objectTransform, const simd::float3& position, float angle, const Output& output);
+
+    // update for instances [begin, end), begin a multiple of four
+    void updateRange(const Field& field, const simd::float4x4& objectTransform, const simd::float3& position, float angle, const Output& output, size_t begin, size_t end);
+}
@@ -0,0 +1,272 @@
+#include "jobSystem.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+namespace jobs {
+    struct Job {
+        std::function<void()> function;
+        Counter* counter;
+    };
+
+    class Scheduler {
+    public:
+        static Scheduler& instance();
+
+        explicit Scheduler(unsigned int threadCount);
+        ~Scheduler();
+
+        unsigned int workerCount() const { return (unsigned int)m_threads.size(); }
+
+        void push(Job job);
+        void pushMain(Job job);
+        void pumpMain();
+        // With only set, runs nothing but jobs of that counter
+        bool runOne(Counter* only = nullptr);
+
+        static void add(Counter* counter) {
+            if (counter) counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+        }
+        void schedule(Counter& dependency, Job job);
+        void wait(Counter& counter);
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+        };
+
+        // One queue per worker, the last one takes jobs pushed from outside the pool
+        std::vector<std::unique_ptr<Queue>> m_queues;
+        std::vector<std::thread> m_threads;
+        Queue m_mainQueue;
+
+        std::atomic<size_t> m_queued{ 0 };
+        std::mutex m_sleepMutex;
+        std::condition_variable m_wake;
+        bool m_stopping = false;
+
+        void workerLoop(unsigned int index);
+        void execute(Job& job);
+        void finish(Counter* counter);
+        bool pop(Queue& queue, bool back, Counter* only, Job& job);
+    };
+
+    namespace {
+        std::atomic<unsigned int> requestedThreads{ 0 };
+        thread_local int workerIndex = -1;
+    }
+
+    Scheduler& Scheduler::instance() {
+        static Scheduler scheduler(requestedThreads.load());
+        return scheduler;
+    }
+
+    Scheduler::Scheduler(unsigned int threadCount) {
+        if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+        // The thread calling wait() makes up the last one, but never run without a worker
+        unsigned int workers = std::max(1u, threadCount - 1);
+
+        for (unsigned int i = 0; i <= workers; i++) m_queues.push_back(std::make_unique<Queue>());
+        for (unsigned int i = 0; i < workers; i++) m_threads.emplace_back(&Scheduler::workerLoop, this, i);
+    }
+
+    Scheduler::~Scheduler() {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& thread : m_threads) thread.join();
+    }
+
+    void Scheduler::push(Job job) {
+        Queue& queue = workerIndex >= 0 ? *m_queues[workerIndex] : *m_queues.back();
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(std::move(job));
+        }
+        m_queued.fetch_add(1, std::memory_order_release);
+
+        // Taking the lock orders this against a worker between its check and its wait
+        { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+        m_wake.notify_one();
+    }
+
+    void Scheduler::pushMain(Job job) {
+        std::lock_guard<std::mutex> lock(m_mainQueue.mutex);
+        m_mainQueue.jobs.push_back(std::move(job));
+    }
+
+    void Scheduler::pumpMain() {
+        std::deque<Job> jobs;
+        {
+            std::lock_guard<std::mutex> lock(m_mainQueue.mutex);
+            jobs.swap(m_mainQueue.jobs);
+        }
+        for (Job& job : jobs) execute(job);
+    }
+
+    bool Scheduler::pop(Queue& queue, bool back, Counter* only, Job& job) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) return false;
+
+        auto take = [&](std::deque<Job>::iterator it) {
+            job = std::move(*it);
+            queue.jobs.erase(it);
+        };
+        if (!only) {
+            take(back ? queue.jobs.end() - 1 : queue.jobs.begin());
+            return true;
+        }
+
+        auto matches = [only](const Job& queued) { return queued.counter == only; };
+        if (back) {
+            auto it = std::find_if(queue.jobs.rbegin(), queue.jobs.rend(), matches);
+            if (it == queue.jobs.rend()) return false;
+            take(std::next(it).base());
+        } else {
+            auto it = std::find_if(queue.jobs.begin(), queue.jobs.end(), matches);
+            if (it == queue.jobs.end()) return false;
+            take(it);
+        }
+        return true;
+    }
+
+    bool Scheduler::runOne(Counter* only) {
+        if (m_queued.load(std::memory_order_acquire) == 0) return false;
+
+        Job job;
+        bool found = workerIndex >= 0 && pop(*m_queues[workerIndex], true, only, job);
+        if (!found) found = pop(*m_queues.back(), false, only, job);
+
+        const size_t workers = m_threads.size();
+        const size_t start = workerIndex >= 0 ? workerIndex + 1 : 0;
+        for (size_t i = 0; i < workers && !found; i++) {
+            size_t victim = (start + i) % workers;
+            if ((int)victim != workerIndex) found = pop(*m_queues[victim], false, only, job);
+        }
+        if (!found) return false;
+
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+        execute(job);
+        return true;
+    }
+
+    void Scheduler::execute(Job& job) {
+        job.function();
+        finish(job.counter);
+    }
+
+    // The last decrement happens under the counter's mutex and wait() takes it once more
+    // before returning, so a waiter can't destroy the counter while it is being drained
+    void Scheduler::finish(Counter* counter) {
+        if (!counter) return;
+
+        int pending = counter->m_pending.load(std::memory_order_relaxed);
+        while (pending > 1) {
+            if (counter->m_pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel)) return;
+        }
+
+        std::vector<Counter::Continuation> continuations;
+        {
+            std::lock_guard<std::mutex> lock(counter->m_mutex);
+            if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                continuations.swap(counter->m_continuations);
+            }
+        }
+        for (Counter::Continuation& continuation : continuations) {
+            push({ std::move(continuation.function), continuation.counter });
+        }
+    }
+
+    void Scheduler::schedule(Counter& dependency, Job job) {
+        {
+            std::lock_guard<std::mutex> lock(dependency.m_mutex);
+            if (!dependency.done()) {
+                dependency.m_continuations.push_back({ std::move(job.function), job.counter });
+                return;
+            }
+        }
+        push(std::move(job));
+    }
+
+    // Only the counter's own jobs are helped with. Anything else could be a long job, an
+    // asset import say, that would stall the waiter far past the point its counter finished.
+    void Scheduler::wait(Counter& counter) {
+        while (!counter.done()) {
+            if (!runOne(&counter)) std::this_thread::yield();
+        }
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+    }
+
+    void Scheduler::workerLoop(unsigned int index) {
+        workerIndex = (int)index;
+
+        while (true) {
+            if (runOne()) continue;
+
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_wake.wait(lock, [this]() { return m_stopping || m_queued.load(std::memory_order_acquire) > 0; });
+            if (m_stopping && m_queued.load() == 0) return;
+        }
+    }
+}
+
+void jobs::initialize(unsigned int threadCount) {
+    requestedThreads = threadCount;
+}
+
+unsigned int jobs::workerCount() {
+    return Scheduler::instance().workerCount();
+}
+
+void jobs::run(std::function<void()> job, Counter* counter) {
+    Scheduler::add(counter);
+    Scheduler::instance().push({ std::move(job), counter });
+}
+
+void jobs::runAfter(Counter& dependency, std::function<void()> job, Counter* counter) {
+    Scheduler::add(counter);
+    Scheduler::instance().schedule(dependency, { std::move(job), counter });
+}
+
+void jobs::runOnMainThread(std::function<void()> job, Counter* counter) {
+    Scheduler::add(counter);
+    Scheduler::instance().pushMain({ std::move(job), counter });
+}
+
+void jobs::pumpMainThread() {
+    Scheduler::instance().pumpMain();
+}
+
+void jobs::wait(Counter& counter) {
+    Scheduler::instance().wait(counter);
+}
+
+void jobs::parallelFor(size_t count, size_t minGrain, const std::function<void(size_t, size_t)>& function) {
+    if (count == 0) return;
+
+    // Around eight ranges per thread leaves thieves something to take when work is uneven
+    const size_t threads = workerCount() + 1;
+    const size_t grain = std::max<size_t>(std::max<size_t>(1, minGrain), count / (threads * 8));
+    if (count <= grain) {
+        function(0, count);
+        return;
+    }
+
+    Counter counter;
+    std::function<void(size_t, size_t)> split = [&](size_t begin, size_t end) {
+        while (end - begin > grain) {
+            size_t middle = begin + (end - begin) / 2;
+            run([&split, middle, end]() { split(middle, end); }, &counter);
+            end = middle;
+        }
+        function(begin, end);
+    };
+    split(0, count);
+    wait(counter);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Engine-wide job system. Every worker owns a deque it pushes to and pops from at
+// the back; idle workers steal from the front of the others, so they take the
+// oldest, largest pieces of split work. Jobs queued from outside the pool go through
+// a shared injection queue. Threads that wait on a counter run that counter's queued
+// jobs meanwhile, never unrelated ones, so jobs may freely wait on jobs they spawn.
+namespace jobs {
+    class Scheduler;
+
+    // Tracks outstanding jobs. Jobs scheduled with runAfter start once it drops to zero.
+    // Only destroy a counter that had jobs after wait() returned for it.
+    class Counter {
+    public:
+        Counter() = default;
+        Counter(const Counter&) = delete;
+        Counter& operator=(const Counter&) = delete;
+
+        bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class Scheduler;
+
+        struct Continuation {
+            std::function<void()> function;
+            Counter* counter;
+        };
+
+        std::atomic<int> m_pending{ 0 };
+        std::mutex m_mutex;
+        std::vector<Continuation> m_continuations;
+    };
+
+    // Total threads including the caller of wait(), 0 uses every hardware thread.
+    // Only takes effect before the first job is scheduled.
+    void initialize(unsigned int threadCount = 0);
+    unsigned int workerCount();
+
+    void run(std::function<void()> job, Counter* counter = nullptr);
+    void runAfter(Counter& dependency, std::function<void()> job, Counter* counter = nullptr);
+
+    // For work that has to happen on the main thread (ImGui, scene containers the
+    // renderer iterates). Runs inside pumpMainThread, which the main loop calls once per frame.
+    void runOnMainThread(std::function<void()> job, Counter* counter = nullptr);
+    void pumpMainThread();
+
+    // Runs counter's queued jobs until it is done. Don't wait on main thread jobs from the main thread.
+    void wait(Counter& counter);
+
+    // Calls function(begin, end) over [0, count). Ranges are split in halves until they
+    // reach the grain, which adapts to the worker count but never goes below minGrain.
+    void parallelFor(size_t count, size_t minGrain, const std::function<void(size_t, size_t)>& function);
+}
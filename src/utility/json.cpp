@@ -0,0 +1,258 @@
+#include "json.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace {
+    const json::Value kNullValue;
+
+    struct Parser {
+        const char* current;
+        const char* end;
+        std::string error;
+
+        void skipWhitespace() {
+            while (current < end && (*current == ' ' || *current == '\n' || *current == '\r' || *current == '\t')) current++;
+        }
+
+        bool fail(const char* message) {
+            if (error.empty()) error = message;
+            return false;
+        }
+
+        bool expect(const char* literal) {
+            size_t length = std::strlen(literal);
+            if ((size_t)(end - current) < length || std::strncmp(current, literal, length) != 0) return fail("Unexpected token");
+            current += length;
+            return true;
+        }
+
+        static void appendUtf8(std::string& out, unsigned int codepoint) {
+            if (codepoint < 0x80) {
+                out.push_back((char)codepoint);
+            } else if (codepoint < 0x800) {
+                out.push_back((char)(0xC0 | (codepoint >> 6)));
+                out.push_back((char)(0x80 | (codepoint & 0x3F)));
+            } else if (codepoint < 0x10000) {
+                out.push_back((char)(0xE0 | (codepoint >> 12)));
+                out.push_back((char)(0x80 | ((codepoint >> 6) & 0x3F)));
+                out.push_back((char)(0x80 | (codepoint & 0x3F)));
+            } else {
+                out.push_back((char)(0xF0 | (codepoint >> 18)));
+                out.push_back((char)(0x80 | ((codepoint >> 12) & 0x3F)));
+                out.push_back((char)(0x80 | ((codepoint >> 6) & 0x3F)));
+                out.push_back((char)(0x80 | (codepoint & 0x3F)));
+            }
+        }
+
+        bool parseHex4(unsigned int& out) {
+            if (end - current < 4) return fail("Truncated escape");
+            out = 0;
+            for (int i = 0; i < 4; i++) {
+                char c = *current++;
+                out <<= 4;
+                if (c >= '0' && c <= '9') out |= c - '0';
+                else if (c >= 'a' && c <= 'f') out |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') out |= c - 'A' + 10;
+                else return fail("Invalid escape");
+            }
+            return true;
+        }
+
+        bool parseString(std::string& out) {
+            current++;
+            while (current < end && *current != '"') {
+                char c = *current++;
+                if (c != '\\') {
+                    out.push_back(c);
+                    continue;
+                }
+                if (current >= end) return fail("Truncated string");
+
+                char escaped = *current++;
+                switch (escaped) {
+                    case '"': out.push_back('"'); break;
+                    case '\\': out.push_back('\\'); break;
+                    case '/': out.push_back('/'); break;
+                    case 'b': out.push_back('\b'); break;
+                    case 'f': out.push_back('\f'); break;
+                    case 'n': out.push_back('\n'); break;
+                    case 'r': out.push_back('\r'); break;
+                    case 't': out.push_back('\t'); break;
+                    case 'u': {
+                        unsigned int codepoint;
+                        if (!parseHex4(codepoint)) return false;
+                        if (codepoint >= 0xD800 && codepoint < 0xDC00 && end - current >= 6 && current[0] == '\\' && current[1] == 'u') {
+                            current += 2;
+                            unsigned int low;
+                            if (!parseHex4(low)) return false;
+                            codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        appendUtf8(out, codepoint);
+                        break;
+                    }
+                    default: return fail("Invalid escape");
+                }
+            }
+            if (current >= end) return fail("Unterminated string");
+            current++;
+            return true;
+        }
+
+        bool parseValue(json::Value& value, int depth) {
+            if (depth > 256) return fail("Nesting too deep");
+            skipWhitespace();
+            if (current >= end) return fail("Unexpected end of input");
+
+            switch (*current) {
+                case '{': {
+                    value.type = json::Type::Object;
+                    current++;
+                    skipWhitespace();
+                    if (current < end && *current == '}') {
+                        current++;
+                        return true;
+                    }
+                    while (true) {
+                        skipWhitespace();
+                        if (current >= end || *current != '"') return fail("Expected key");
+
+                        value.object.emplace_back();
+                        if (!parseString(value.object.back().first)) return false;
+
+                        skipWhitespace();
+                        if (current >= end || *current != ':') return fail("Expected ':'");
+                        current++;
+                        if (!parseValue(value.object.back().second, depth + 1)) return false;
+
+                        skipWhitespace();
+                        if (current < end && *current == ',') {
+                            current++;
+                            continue;
+                        }
+                        if (current < end && *current == '}') {
+                            current++;
+                            return true;
+                        }
+                        return fail("Expected ',' or '}'");
+                    }
+                }
+                case '[': {
+                    value.type = json::Type::Array;
+                    current++;
+                    skipWhitespace();
+                    if (current < end && *current == ']') {
+                        current++;
+                        return true;
+                    }
+                    while (true) {
+                        value.array.emplace_back();
+                        if (!parseValue(value.array.back(), depth + 1)) return false;
+
+                        skipWhitespace();
+                        if (current < end && *current == ',') {
+                            current++;
+                            continue;
+                        }
+                        if (current < end && *current == ']') {
+                            current++;
+                            return true;
+                        }
+                        return fail("Expected ',' or ']'");
+                    }
+                }
+                case '"':
+                    value.type = json::Type::String;
+                    return parseString(value.string);
+                case 't':
+                    value.type = json::Type::Bool;
+                    value.boolean = true;
+                    return expect("true");
+                case 'f':
+                    value.type = json::Type::Bool;
+                    value.boolean = false;
+                    return expect("false");
+                case 'n':
+                    value.type = json::Type::Null;
+                    return expect("null");
+                default: {
+                    // strtod needs a terminated buffer, numbers are short so copy them out first
+                    char buffer[64];
+                    size_t length = 0;
+                    while (current + length < end && length < sizeof(buffer) - 1 &&
+                           std::strchr("+-0123456789.eE", current[length]) != nullptr) {
+                        buffer[length] = current[length];
+                        length++;
+                    }
+                    if (length == 0) return fail("Unexpected character");
+                    buffer[length] = '\0';
+
+                    value.type = json::Type::Number;
+                    value.number = std::strtod(buffer, nullptr);
+                    current += length;
+                    return true;
+                }
+            }
+        }
+    };
+}
+
+bool json::Value::has(const char* key) const {
+    for (const auto& member : object) {
+        if (member.first == key) return true;
+    }
+    return false;
+}
+
+const json::Value& json::Value::operator[](const char* key) const {
+    for (const auto& member : object) {
+        if (member.first == key) return member.second;
+    }
+    return kNullValue;
+}
+
+const json::Value& json::Value::operator[](size_t index) const {
+    if (index >= array.size()) return kNullValue;
+    return array[index];
+}
+
+size_t json::Value::size() const {
+    if (type == Type::Object) return object.size();
+    return array.size();
+}
+
+// Out of range numbers saturate instead of overflowing the cast
+int json::Value::asInt(int fallback) const {
+    if (type != Type::Number || std::isnan(number)) return fallback;
+    if (number >= (double)std::numeric_limits<int>::max()) return std::numeric_limits<int>::max();
+    if (number <= (double)std::numeric_limits<int>::min()) return std::numeric_limits<int>::min();
+    return (int)number;
+}
+
+double json::Value::asNumber(double fallback) const {
+    return type == Type::Number ? number : fallback;
+}
+
+bool json::Value::asBool(bool fallback) const {
+    return type == Type::Bool ? boolean : fallback;
+}
+
+const std::string& json::Value::asString() const {
+    return string;
+}
+
+bool json::parse(const char* text, size_t length, Value& out, std::string* error) {
+    Parser parser = { text, text + length, "" };
+    out = Value();
+
+    bool success = parser.parseValue(out, 0);
+    if (success) {
+        parser.skipWhitespace();
+        if (parser.current != parser.end) success = parser.fail("Trailing characters");
+    }
+    if (!success && error) *error = parser.error;
+
+    return success;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace json {
+    enum class Type {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    class Value {
+    public:
+        Type type = Type::Null;
+        bool boolean = false;
+        double number = 0.0;
+        std::string string;
+        std::vector<Value> array;
+        std::vector<std::pair<std::string, Value>> object;
+
+        bool isNull() const { return type == Type::Null; }
+        bool isArray() const { return type == Type::Array; }
+        bool isObject() const { return type == Type::Object; }
+        bool has(const char* key) const;
+
+        const Value& operator[](const char* key) const;
+        const Value& operator[](size_t index) const;
+        size_t size() const;
+
+        int asInt(int fallback = 0) const;
+        double asNumber(double fallback = 0.0) const;
+        bool asBool(bool fallback = false) const;
+        const std::string& asString() const;
+    };
+
+    bool parse(const char* text, size_t length, Value& out, std::string* error = nullptr);
+}
@@ -0,0 +1,161 @@
+#include "lightClusters.hpp"
+#include "jobSystem.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+float LightClusters::sliceDepth(uint32_t slice) const {
+    return m_nearPlane * std::pow(m_farPlane / m_nearPlane, (float)slice / kSlices);
+}
+
+int LightClusters::sliceOf(float depth) const {
+    return (int)std::floor(std::log(depth) * m_sliceScale + m_sliceBias);
+}
+
+// Assumes a perspective matrix without shear, like Camera::getPerspectiveMatrix. A view ray
+// through ndc (x, y) then passes (x + P20) / P00, (y + P21) / P11 at one unit of depth.
+bool LightClusters::setProjection(const simd::float4x4& perspective, float nearPlane, float farPlane) {
+    if (!m_bounds.empty() && nearPlane == m_nearPlane && farPlane == m_farPlane &&
+        std::memcmp(&perspective, &m_perspective, sizeof(perspective)) == 0) return false;
+
+    m_perspective = perspective;
+    m_nearPlane = nearPlane;
+    m_farPlane = farPlane;
+    m_sliceScale = kSlices / std::log(farPlane / nearPlane);
+    m_sliceBias = -std::log(nearPlane) * m_sliceScale;
+
+    auto rayX = [&perspective](float ndc) { return (ndc + perspective.columns[2].x) / perspective.columns[0].x; };
+    auto rayY = [&perspective](float ndc) { return (ndc + perspective.columns[2].y) / perspective.columns[1].y; };
+
+    m_bounds.resize(kClusterCount);
+    for (uint32_t slice = 0; slice < kSlices; slice++) {
+        const float nearDepth = sliceDepth(slice), farDepth = sliceDepth(slice + 1);
+        for (uint32_t tileY = 0; tileY < kTilesY; tileY++) {
+            const float top = rayY(1.0f - 2.0f * tileY / kTilesY), bottom = rayY(1.0f - 2.0f * (tileY + 1) / kTilesY);
+            for (uint32_t tileX = 0; tileX < kTilesX; tileX++) {
+                const float left = rayX(-1.0f + 2.0f * tileX / kTilesX), right = rayX(-1.0f + 2.0f * (tileX + 1) / kTilesX);
+
+                // Sides fan out with depth, so the extremes sit on either the near or far face
+                Bounds& bounds = m_bounds[(slice * kTilesY + tileY) * kTilesX + tileX];
+                bounds.min = simd_make_float3(std::min(left * nearDepth, left * farDepth), std::min(bottom * nearDepth, bottom * farDepth), -farDepth);
+                bounds.max = simd_make_float3(std::max(right * nearDepth, right * farDepth), std::max(top * nearDepth, top * farDepth), -nearDepth);
+            }
+        }
+    }
+    return true;
+}
+
+uint32_t LightClusters::clusterAt(float ndcX, float ndcY, float depth) const {
+    const int tileX = std::clamp((int)((ndcX + 1.0f) * 0.5f * kTilesX), 0, (int)kTilesX - 1);
+    const int tileY = std::clamp((int)((1.0f - ndcY) * 0.5f * kTilesY), 0, (int)kTilesY - 1);
+    const int slice = std::clamp(sliceOf(std::max(depth, m_nearPlane)), 0, (int)kSlices - 1);
+    return (slice * kTilesY + tileY) * kTilesX + tileX;
+}
+
+void LightClusters::assign(const simd::float4x4& view, const Light* lights, size_t count) {
+    m_viewLights.resize(count);
+    m_sliceLights.resize(kSlices);
+    for (std::vector<uint32_t>& sliceLights : m_sliceLights) sliceLights.clear();
+
+    // Depth alone narrows every light down to a run of slices
+    for (size_t i = 0; i < count; i++) {
+        const float range = lights[i].range;
+        const simd::float3 center = simd_mul(view, simd_make_float4(lights[i].position, 1.0f)).xyz;
+        m_viewLights[i] = { center, range };
+
+        const float depth = -center.z;
+        if (range <= 0.0f || depth + range < m_nearPlane || depth - range > m_farPlane) continue;
+        const int first = std::max(0, sliceOf(std::max(depth - range, m_nearPlane)));
+        const int last = std::min((int)kSlices - 1, sliceOf(std::min(depth + range, m_farPlane)));
+        for (int slice = first; slice <= last; slice++) m_sliceLights[slice].push_back((uint32_t)i);
+    }
+
+    m_clusters.resize(kClusterCount);
+    m_sliceIndices.resize(kSlices);
+    m_sliceRects.resize(kSlices);
+    m_sliceHits.resize(kSlices);
+    m_sliceDropped.assign(kSlices, 0);
+    jobs::parallelFor(kSlices, 1, [this](size_t begin, size_t end) {
+        for (size_t slice = begin; slice < end; slice++) assignSlice((uint32_t)slice);
+    });
+
+    // Slices listed their clusters from zero, move them behind the slices before them
+    m_indices.clear();
+    m_dropped = 0;
+    for (uint32_t slice = 0; slice < kSlices; slice++) {
+        const uint32_t base = (uint32_t)m_indices.size();
+        for (uint32_t cluster = slice * kTilesX * kTilesY; cluster < (slice + 1) * kTilesX * kTilesY; cluster++) {
+            m_clusters[cluster].offset += base;
+        }
+        m_indices.insert(m_indices.end(), m_sliceIndices[slice].begin(), m_sliceIndices[slice].end());
+        m_dropped += m_sliceDropped[slice];
+    }
+}
+
+void LightClusters::assignSlice(uint32_t slice) {
+    std::vector<uint32_t>& indices = m_sliceIndices[slice];
+    indices.clear();
+
+    // Tiles the light's box can reach within this slice, the box tests below only run on those.
+    // x / depth is extreme at one of the two depths, and ndc follows x / depth.
+    const std::vector<uint32_t>& candidates = m_sliceLights[slice];
+    std::vector<TileRect>& rects = m_sliceRects[slice];
+    rects.resize(candidates.size());
+    const float sliceNear = sliceDepth(slice), sliceFar = sliceDepth(slice + 1);
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const Light& viewLight = m_viewLights[candidates[i]];
+        const float nearDepth = std::max(sliceNear, -viewLight.position.z - viewLight.range);
+        const float farDepth = std::min(sliceFar, -viewLight.position.z + viewLight.range);
+
+        const float left = viewLight.position.x - viewLight.range, right = viewLight.position.x + viewLight.range;
+        const float bottom = viewLight.position.y - viewLight.range, top = viewLight.position.y + viewLight.range;
+        const float ndcLeft = std::min(left / nearDepth, left / farDepth) * m_perspective.columns[0].x - m_perspective.columns[2].x;
+        const float ndcRight = std::max(right / nearDepth, right / farDepth) * m_perspective.columns[0].x - m_perspective.columns[2].x;
+        const float ndcBottom = std::min(bottom / nearDepth, bottom / farDepth) * m_perspective.columns[1].y - m_perspective.columns[2].y;
+        const float ndcTop = std::max(top / nearDepth, top / farDepth) * m_perspective.columns[1].y - m_perspective.columns[2].y;
+
+        TileRect& rect = rects[i];
+        rect.minX = (int)std::floor(std::clamp((ndcLeft + 1.0f) * 0.5f * kTilesX, 0.0f, (float)kTilesX - 1));
+        rect.maxX = (int)std::floor(std::clamp((ndcRight + 1.0f) * 0.5f * kTilesX, 0.0f, (float)kTilesX - 1));
+        rect.minY = (int)std::floor(std::clamp((1.0f - ndcTop) * 0.5f * kTilesY, 0.0f, (float)kTilesY - 1));
+        rect.maxY = (int)std::floor(std::clamp((1.0f - ndcBottom) * 0.5f * kTilesY, 0.0f, (float)kTilesY - 1));
+    }
+
+    // Lights visit only the tiles of their rect, hits are then grouped by cluster keeping light order
+    std::vector<Hit>& hits = m_sliceHits[slice];
+    hits.clear();
+    const uint32_t firstCluster = slice * kTilesX * kTilesY;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const Light& viewLight = m_viewLights[candidates[i]];
+        const TileRect& rect = rects[i];
+        for (int tileY = rect.minY; tileY <= rect.maxY; tileY++) {
+            for (int tileX = rect.minX; tileX <= rect.maxX; tileX++) {
+                const uint32_t tile = tileY * kTilesX + tileX;
+                const Bounds& bounds = m_bounds[firstCluster + tile];
+                const simd::float3 closest = simd::clamp(viewLight.position, bounds.min, bounds.max);
+                if (simd::length_squared(closest - viewLight.position) > viewLight.range * viewLight.range) continue;
+                hits.push_back({ tile, candidates[i] });
+            }
+        }
+    }
+
+    uint32_t counts[kTilesX * kTilesY] = {};
+    for (const Hit& hit : hits) counts[hit.tile]++;
+
+    uint32_t offset = 0;
+    for (uint32_t tile = 0; tile < kTilesX * kTilesY; tile++) {
+        Cluster& entry = m_clusters[firstCluster + tile];
+        entry.offset = offset;
+        entry.count = std::min(counts[tile], kMaxLightsPerCluster);
+        m_sliceDropped[slice] += counts[tile] - entry.count;
+        offset += entry.count;
+        counts[tile] = 0;
+    }
+
+    indices.resize(offset);
+    for (const Hit& hit : hits) {
+        const Cluster& entry = m_clusters[firstCluster + hit.tile];
+        if (counts[hit.tile] < entry.count) indices[entry.offset + counts[hit.tile]++] = hit.light;
+    }
+}
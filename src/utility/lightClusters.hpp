@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <simd/simd.h>
+
+// Clustered light assignment for forward shading. The view frustum is cut into screen tiles
+// and depth slices spaced logarithmically between the near and far plane. Every point light
+// is listed in each cluster its range touches, so a pixel only loops over its cluster's list.
+// Tiles count from the top left of the screen, clusters are numbered tile x first, then tile y,
+// then slice, as fragmentMain in modelShader.metal expects.
+class LightClusters {
+public:
+    static constexpr uint32_t kTilesX = 16;
+    static constexpr uint32_t kTilesY = 9;
+    static constexpr uint32_t kSlices = 24;
+    static constexpr uint32_t kClusterCount = kTilesX * kTilesY * kSlices;
+    // Lights past this many in one cluster are dropped, bounding the cost of a pixel
+    static constexpr uint32_t kMaxLightsPerCluster = 128;
+
+    // Where a cluster's lights start in indices() and how many there are
+    struct Cluster {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    struct Light {
+        simd::float3 position;
+        float range;
+    };
+
+    // Rebuilds the cluster bounds if the projection changed since the last call, returns whether it did
+    bool setProjection(const simd::float4x4& perspective, float nearPlane, float farPlane);
+    // Bins world space lights as seen through view, slices are spread across the job system
+    void assign(const simd::float4x4& view, const Light* lights, size_t count);
+
+    const std::vector<Cluster>& clusters() const { return m_clusters; }
+    const std::vector<uint32_t>& indices() const { return m_indices; }
+    // Lights left out of clusters that were already full
+    size_t droppedLights() const { return m_dropped; }
+
+    // slice = log(depth) * sliceScale + sliceBias, for view distance along the camera axis
+    float sliceScale() const { return m_sliceScale; }
+    float sliceBias() const { return m_sliceBias; }
+    // Cluster of a view space position, ndc x and y in -1..1 with y up
+    uint32_t clusterAt(float ndcX, float ndcY, float depth) const;
+
+private:
+    struct Bounds {
+        simd::float3 min;
+        simd::float3 max;
+    };
+
+    // Inclusive tile range
+    struct TileRect {
+        int minX, maxX, minY, maxY;
+    };
+
+    struct Hit {
+        uint32_t tile;
+        uint32_t light;
+    };
+
+    simd::float4x4 m_perspective = {};
+    float m_nearPlane = 0.0f;
+    float m_farPlane = 0.0f;
+    float m_sliceScale = 0.0f;
+    float m_sliceBias = 0.0f;
+    // View space box around every cluster
+    std::vector<Bounds> m_bounds;
+
+    // View space lights, and which of them reach into each slice
+    std::vector<Light> m_viewLights;
+    std::vector<std::vector<uint32_t>> m_sliceLights;
+    // Each slice lists its clusters' lights on its own before they are packed into m_indices
+    std::vector<std::vector<uint32_t>> m_sliceIndices;
+    std::vector<std::vector<TileRect>> m_sliceRects;
+    std::vector<std::vector<Hit>> m_sliceHits;
+    std::vector<size_t> m_sliceDropped;
+
+    std::vector<Cluster> m_clusters;
+    std::vector<uint32_t> m_indices;
+    size_t m_dropped = 0;
+
+    float sliceDepth(uint32_t slice) const;
+    int sliceOf(float depth) const;
+    void assignSlice(uint32_t slice);
+};
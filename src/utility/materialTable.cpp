@@ -0,0 +1,131 @@
+#include "materialTable.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    uint64_t hashMaterial(const std::vector<TextureSlot>& textures, const TypeEndpoints& endpoints) {
+        uint64_t hash = 0xCBF29CE484222325ull;
+        auto combine = [&hash](uint64_t value) {
+            hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+        };
+
+        for (const TextureSlot& slot : textures) {
+            uint64_t offset, scale;
+            std::memcpy(&scale, &slot.uvTransform, sizeof(scale));
+            std::memcpy(&offset, reinterpret_cast<const char*>(&slot.uvTransform) + 8, sizeof(offset));
+            combine(reinterpret_cast<uintptr_t>(slot.texture));
+            combine(scale);
+            combine(offset);
+        }
+        combine((uint64_t)(uint32_t)endpoints.diffuse << 32 | (uint32_t)endpoints.specular);
+        combine((uint64_t)(uint32_t)endpoints.normal << 32 | (uint32_t)endpoints.height);
+        return hash;
+    }
+
+    bool sameTextures(const std::vector<TextureSlot>& a, const std::vector<TextureSlot>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].texture != b[i].texture || std::memcmp(&a[i].uvTransform, &b[i].uvTransform, sizeof(float) * 4) != 0) return false;
+        }
+        return true;
+    }
+
+    bool sameEndpoints(const TypeEndpoints& a, const TypeEndpoints& b) {
+        return a.diffuse == b.diffuse && a.specular == b.specular && a.normal == b.normal && a.height == b.height;
+    }
+}
+
+MaterialTable::~MaterialTable() {
+    if (m_materialBuffer) m_materialBuffer->release();
+    if (m_textureBuffer) m_textureBuffer->release();
+    if (m_argumentEncoder) m_argumentEncoder->release();
+    for (MTL::Buffer* buffer : m_retiredBuffers) buffer->release();
+}
+
+uint32_t MaterialTable::add(const std::vector<Texture>& textures, const TypeEndpoints& endpoints) {
+    std::vector<TextureSlot> textureSet;
+    textureSet.reserve(textures.size());
+    for (const Texture& texture : textures) textureSet.push_back({ texture.actualTexture, texture.uvTransform });
+
+    uint64_t hash = hashMaterial(textureSet, endpoints);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<uint32_t>& candidates = m_lookup[hash];
+    for (uint32_t index : candidates) {
+        const Entry& entry = m_materials[index];
+        if (sameTextures(entry.textures, textureSet) && sameEndpoints(entry.endpoints, endpoints)) return index;
+    }
+
+    uint32_t index = (uint32_t)m_materials.size();
+    candidates.push_back(index);
+    m_materialData.push_back({ endpoints, (uint32_t)m_textures.size(), (uint32_t)textureSet.size() });
+    // Atlas pages are shared by many slots but only need to be made resident once
+    for (const TextureSlot& slot : textureSet) {
+        m_textures.push_back(slot);
+        if (slot.texture && std::find(m_residentTextures.begin(), m_residentTextures.end(), slot.texture) == m_residentTextures.end()) {
+            m_residentTextures.push_back(slot.texture);
+        }
+    }
+    m_materials.push_back({ std::move(textureSet), endpoints });
+
+    return index;
+}
+
+size_t MaterialTable::size() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_materials.size();
+}
+
+void MaterialTable::grow(MTL::Buffer*& buffer, MTL::Device* device, size_t requiredSize) {
+    if (buffer && buffer->length() >= requiredSize) return;
+
+    size_t capacity = buffer ? buffer->length() : 256;
+    while (capacity < requiredSize) capacity *= 2;
+
+    MTL::Buffer* grown = device->newBuffer(capacity, MTL::ResourceStorageModeManaged);
+    if (buffer) {
+        std::memcpy(grown->contents(), buffer->contents(), buffer->length());
+        grown->didModifyRange(NS::Range::Make(0, buffer->length()));
+        m_retiredBuffers.push_back(buffer);
+    }
+    buffer = grown;
+}
+
+void MaterialTable::bind(StateEncoder& encoder, MTL::Device* device, MTL::Function* fragmentFunction) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_materials.empty()) return;
+
+    if (!m_argumentEncoder) m_argumentEncoder = fragmentFunction->newArgumentEncoder(1);
+
+    // Entries only ever get appended, so frames in flight never see their slots change
+    if (m_uploadedMaterials < m_materialData.size()) {
+        grow(m_materialBuffer, device, m_materialData.size() * sizeof(MaterialData));
+
+        size_t offset = m_uploadedMaterials * sizeof(MaterialData);
+        size_t length = (m_materialData.size() - m_uploadedMaterials) * sizeof(MaterialData);
+        std::memcpy(static_cast<char*>(m_materialBuffer->contents()) + offset, m_materialData.data() + m_uploadedMaterials, length);
+        m_materialBuffer->didModifyRange(NS::Range::Make(offset, length));
+        m_uploadedMaterials = m_materialData.size();
+    }
+
+    // Always keep a texture buffer around, even when no material has textures yet
+    const size_t stride = m_argumentEncoder->encodedLength();
+    grow(m_textureBuffer, device, std::max<size_t>(1, m_textures.size()) * stride);
+
+    if (m_uploadedTextures < m_textures.size()) {
+        for (size_t i = m_uploadedTextures; i < m_textures.size(); i++) {
+            m_argumentEncoder->setArgumentBuffer(m_textureBuffer, stride * i);
+            m_argumentEncoder->setTexture(m_textures[i].texture, 0);
+            *static_cast<simd::float4*>(m_argumentEncoder->constantData(1)) = m_textures[i].uvTransform;
+        }
+        m_textureBuffer->didModifyRange(NS::Range::Make(stride * m_uploadedTextures, stride * (m_textures.size() - m_uploadedTextures)));
+        m_uploadedTextures = m_textures.size();
+    }
+
+    encoder.setFragmentBuffer(m_materialBuffer, 0, 0);
+    encoder.setFragmentBuffer(m_textureBuffer, 0, 1);
+    if (!m_residentTextures.empty()) {
+        encoder.useResources(m_residentTextures.data(), m_residentTextures.size(), MTL::ResourceUsageSample, MTL::RenderStageFragment);
+    }
+}
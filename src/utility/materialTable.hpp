@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <Metal/Metal.hpp>
+
+#include "mesh.h"
+#include "stateEncoder.hpp"
+
+// Matches SingleTexture in modelShader.metal, uvTransform sits at argument id 1
+struct TextureSlot {
+    MTL::Texture* texture;
+    simd::float4 uvTransform;
+};
+
+// Matches MaterialData in modelShader.metal. Endpoints index into the material's
+// own run of textures, which starts at textureOffset in the shared argument buffer.
+struct MaterialData {
+    TypeEndpoints endpoints;
+    uint32_t textureOffset;
+    uint32_t textureCount;
+};
+
+// Engine-wide table of unique materials, keyed on their texture set and endpoints.
+// Meshes keep an index into it; the renderer binds the whole table once per pass.
+// add() can run on import threads, bind() belongs to the render thread.
+class MaterialTable {
+public:
+    MaterialTable() = default;
+    ~MaterialTable();
+
+    MaterialTable(const MaterialTable&) = delete;
+    MaterialTable& operator=(const MaterialTable&) = delete;
+
+    uint32_t add(const std::vector<Texture>& textures, const TypeEndpoints& endpoints);
+
+    // Uploads anything added since the last call, then binds the material buffer at
+    // fragment index 0, the texture argument buffer at 1 and queues the textures for residency
+    void bind(StateEncoder& encoder, MTL::Device* device, MTL::Function* fragmentFunction);
+
+    size_t size();
+
+private:
+    struct Entry {
+        std::vector<TextureSlot> textures;
+        TypeEndpoints endpoints;
+    };
+
+    std::mutex m_mutex;
+    std::vector<Entry> m_materials;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> m_lookup;
+    std::vector<MaterialData> m_materialData;
+    std::vector<TextureSlot> m_textures;
+    std::vector<const MTL::Resource*> m_residentTextures;
+
+    size_t m_uploadedMaterials = 0;
+    size_t m_uploadedTextures = 0;
+    MTL::Buffer* m_materialBuffer = nullptr;
+    MTL::Buffer* m_textureBuffer = nullptr;
+    MTL::ArgumentEncoder* m_argumentEncoder = nullptr;
+    // Outgrown buffers may still be read by frames in flight, they live until the table does
+    std::vector<MTL::Buffer*> m_retiredBuffers;
+
+    void grow(MTL::Buffer*& buffer, MTL::Device* device, size_t requiredSize);
+};
@@ -1,43 +1,45 @@
+#pragma once
 #include <simd/simd.h>
 #include <Metal/Metal.hpp>
 
 #include <string>
 #include <vector>
 
-struct Vertex {
-    simd::float3 position;
-    simd::float3 normal;
-    simd::float2 texCoords;
-};
+#include "commandList.hpp"
+#include "frustumCulling.hpp"
+#include "vertex.hpp"
 
 struct Texture {
     MTL::Texture* actualTexture;
     std::string type;
     std::string path;
+    // Scale in xy and offset in zw, non-identity when the texture lives in an atlas page
+    simd::float4 uvTransform = simd_make_float4(1.0f, 1.0f, 0.0f, 0.0f);
 };
 
-struct TypeEndpoints {
-    int diffuse;
-    int specular;
-    int normal;
-    int height;
-};
-
+// Geometry and material of one mesh. Never changed once setupMesh has run, models and their
+// placed copies share it; where it is drawn lives in the model.
 class Mesh {
 public:
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
     TypeEndpoints endpoints;
+    uint32_t materialIndex = 0;
+    // Object-space bounds, computed from the vertices or set by the importer that uploaded them
+    culling::Bounds bounds;
     
     Mesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<Texture>& textures, TypeEndpoints& endpoints);
-    void setupMesh(MTL::Device* device, MTL::Function* function);
-    void draw(MTL::RenderCommandEncoder* encoder);
+    Mesh(MTL::Buffer* vertexBuffer, MTL::Buffer* indexBuffer, unsigned int indexCount, std::vector<Texture>& textures, TypeEndpoints& endpoints);
+    void setupMesh(MTL::Device* device);
+    // Identifies the vertex and index buffers, which copies of a model share
+    const void* geometry() const { return m_verticesBuffer; }
+    // Recorded draws for batching, instances come from whatever buffer is bound at index 1
+    void bindVertices(gfx::CommandList& commands) const;
+    void drawInstances(gfx::CommandList& commands, uint32_t firstInstance, uint32_t instanceCount) const;
 
 private:
-    
-    MTL::Buffer* m_verticesBuffer;
-    MTL::Buffer* m_indicesBuffer;
-    MTL::Buffer* m_endpointBuffer;
-    MTL::Buffer* m_argTextureBuffer;
+    unsigned int m_indexCount;
+    MTL::Buffer* m_verticesBuffer = nullptr;
+    MTL::Buffer* m_indicesBuffer = nullptr;
 };
@@ -0,0 +1,168 @@
+#include "meshCache.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "fileIO.h"
+#include "meshCodec.hpp"
+
+namespace {
+    constexpr uint32_t kCacheMagic = 0x3148434D; // "MCH1"
+    constexpr uint32_t kCacheVersion = 3;
+
+    // Counts, endpoints, an empty texture and instance list, and two one-byte blobs
+    constexpr size_t kMinMeshBytes = 3 * sizeof(uint32_t) + sizeof(TypeEndpoints) + 2 * (sizeof(uint32_t) + 1);
+    constexpr size_t kMinTextureBytes = 2 * sizeof(uint32_t);
+
+    void writeU32(std::ofstream& stream, uint32_t value) {
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(uint32_t));
+    }
+
+    void writeString(std::ofstream& stream, const std::string& value) {
+        writeU32(stream, (uint32_t)value.size());
+        stream.write(value.data(), (std::streamsize)value.size());
+    }
+
+    void writeBlob(std::ofstream& stream, const std::vector<unsigned char>& blob) {
+        writeU32(stream, (uint32_t)blob.size());
+        stream.write(reinterpret_cast<const char*>(blob.data()), (std::streamsize)blob.size());
+    }
+
+    struct Reader {
+        const unsigned char* data;
+        size_t size;
+        size_t offset = 0;
+
+        bool readU32(uint32_t& value) {
+            if (offset + sizeof(uint32_t) > size) return false;
+            std::memcpy(&value, data + offset, sizeof(uint32_t));
+            offset += sizeof(uint32_t);
+            return true;
+        }
+
+        bool readString(std::string& value) {
+            uint32_t length;
+            if (!readU32(length) || length > remaining()) return false;
+            value.assign(reinterpret_cast<const char*>(data + offset), length);
+            offset += length;
+            return true;
+        }
+
+        size_t remaining() const { return size - offset; }
+
+        bool readBlob(const unsigned char*& blob, uint32_t& length) {
+            if (!readU32(length) || length > remaining()) return false;
+            blob = data + offset;
+            offset += length;
+            return true;
+        }
+    };
+
+    // simd::float3 carries a padding lane, zero it so the stream compresses and the
+    // cache is byte-for-byte reproducible
+    std::vector<Vertex> canonicalVertices(const std::vector<Vertex>& vertices) {
+        std::vector<Vertex> canonical(vertices.size());
+        std::memset(canonical.data(), 0, canonical.size() * sizeof(Vertex));
+
+        for (size_t i = 0; i < vertices.size(); i++) {
+            std::memcpy(&canonical[i].position, &vertices[i].position, sizeof(float) * 3);
+            std::memcpy(&canonical[i].normal, &vertices[i].normal, sizeof(float) * 3);
+            std::memcpy(&canonical[i].texCoords, &vertices[i].texCoords, sizeof(float) * 2);
+            std::memcpy(&canonical[i].qtangent, &vertices[i].qtangent, sizeof(short) * 4);
+        }
+        return canonical;
+    }
+}
+
+bool meshCache::isCachePath(const std::string& path) {
+    const std::string extension = ".mcache";
+    return path.size() > extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+bool meshCache::write(const std::string& path, const std::vector<CachedMesh>& meshes) {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream) return false;
+
+    writeU32(stream, kCacheMagic);
+    writeU32(stream, kCacheVersion);
+    writeU32(stream, (uint32_t)meshes.size());
+
+    for (const CachedMesh& mesh : meshes) {
+        writeU32(stream, (uint32_t)mesh.vertices.size());
+        writeU32(stream, (uint32_t)mesh.indices.size());
+        stream.write(reinterpret_cast<const char*>(&mesh.endpoints), sizeof(TypeEndpoints));
+
+        writeU32(stream, (uint32_t)mesh.textures.size());
+        for (const CachedTexture& texture : mesh.textures) {
+            writeString(stream, texture.type);
+            writeString(stream, texture.path);
+        }
+
+        writeU32(stream, (uint32_t)mesh.instances.size());
+        stream.write(reinterpret_cast<const char*>(mesh.instances.data()), (std::streamsize)(mesh.instances.size() * sizeof(simd::float4x4)));
+
+        std::vector<Vertex> vertices = canonicalVertices(mesh.vertices);
+        writeBlob(stream, meshCodec::encodeVertexBuffer(vertices.data(), vertices.size(), sizeof(Vertex)));
+        writeBlob(stream, meshCodec::encodeIndexBuffer(mesh.indices.data(), mesh.indices.size()));
+    }
+
+    return (bool)stream;
+}
+
+bool meshCache::read(const std::string& path, std::vector<CachedMesh>& meshes) {
+    util::MappedFile file(path);
+    if (!file.isValid()) return false;
+
+    Reader reader = { file.data(), file.size() };
+    uint32_t magic, version, meshCount;
+    if (!reader.readU32(magic) || magic != kCacheMagic) return false;
+    if (!reader.readU32(version) || version != kCacheVersion) {
+        std::cout << "Error::MeshCache::Unsupported version in " << path << std::endl;
+        return false;
+    }
+    // Counts are checked against what the rest of the file could hold before anything is
+    // allocated for them, so a corrupt header can't ask for gigabytes
+    if (!reader.readU32(meshCount) || meshCount > reader.remaining() / kMinMeshBytes) return false;
+
+    meshes.resize(meshCount);
+    for (CachedMesh& mesh : meshes) {
+        uint32_t vertexCount, indexCount, textureCount;
+        if (!reader.readU32(vertexCount) || !reader.readU32(indexCount)) return false;
+        if (reader.remaining() < sizeof(TypeEndpoints)) return false;
+        std::memcpy(&mesh.endpoints, reader.data + reader.offset, sizeof(TypeEndpoints));
+        reader.offset += sizeof(TypeEndpoints);
+
+        if (!reader.readU32(textureCount) || textureCount > reader.remaining() / kMinTextureBytes) return false;
+        mesh.textures.resize(textureCount);
+        for (CachedTexture& texture : mesh.textures) {
+            if (!reader.readString(texture.type) || !reader.readString(texture.path)) return false;
+        }
+
+        const int endpoints[4] = { mesh.endpoints.diffuse, mesh.endpoints.specular, mesh.endpoints.normal, mesh.endpoints.height };
+        for (int endpoint : endpoints) {
+            if (endpoint < -1 || endpoint >= (int)textureCount) return false;
+        }
+
+        uint32_t instanceCount;
+        if (!reader.readU32(instanceCount) || instanceCount > reader.remaining() / sizeof(simd::float4x4)) return false;
+        mesh.instances.resize(instanceCount);
+        if (instanceCount > 0) std::memcpy(mesh.instances.data(), reader.data + reader.offset, instanceCount * sizeof(simd::float4x4));
+        reader.offset += instanceCount * sizeof(simd::float4x4);
+
+        const unsigned char* blob;
+        uint32_t length;
+        if (!reader.readBlob(blob, length) || vertexCount > meshCodec::maxVertexCount(sizeof(Vertex), length)) return false;
+        mesh.vertices.resize(vertexCount);
+        if (!meshCodec::decodeVertexBuffer(mesh.vertices.data(), vertexCount, sizeof(Vertex), blob, length)) return false;
+
+        if (!reader.readBlob(blob, length) || indexCount > meshCodec::maxIndexCount(length)) return false;
+        mesh.indices.resize(indexCount);
+        if (!meshCodec::decodeIndexBuffer(mesh.indices.data(), indexCount, blob, length)) return false;
+        for (unsigned int index : mesh.indices) {
+            if (index >= vertexCount) return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vertex.hpp"
+
+// Binary mesh cache (.mcache). Geometry is stored through meshCodec, textures are
+// referenced by path relative to the cache file.
+namespace meshCache {
+    struct CachedTexture {
+        std::string type;
+        std::string path;
+    };
+
+    struct CachedMesh {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<CachedTexture> textures;
+        TypeEndpoints endpoints;
+        std::vector<simd::float4x4> instances;
+    };
+
+    bool write(const std::string& path, const std::vector<CachedMesh>& meshes);
+    bool read(const std::string& path, std::vector<CachedMesh>& meshes);
+
+    bool isCachePath(const std::string& path);
+}
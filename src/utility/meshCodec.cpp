@@ -0,0 +1,470 @@
+#include "meshCodec.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MESH_CODEC_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MESH_CODEC_SSE2 1
+#endif
+
+namespace {
+    constexpr unsigned char kVertexHeader = 0xA1;
+    constexpr unsigned char kIndexHeader = 0xE1;
+
+    constexpr size_t kBlockVertices = 256;
+    constexpr size_t kGroupSize = 16;
+    constexpr size_t kFifoSize = 16;
+
+    // Bytes of payload for a group of 16 plane bytes packed at 0, 2, 4 or 8 bits
+    constexpr size_t kGroupPayload[4] = { 0, 4, 8, 16 };
+
+    inline uint32_t zigzag(uint32_t value) {
+        return (value << 1) ^ (uint32_t)((int32_t)value >> 31);
+    }
+
+    inline uint32_t unzigzag(uint32_t value) {
+        return (value >> 1) ^ (0u - (value & 1));
+    }
+
+    void encodePlane(const unsigned char* plane, size_t groups, std::vector<unsigned char>& out) {
+        size_t headerOffset = out.size();
+        out.resize(out.size() + (groups + 3) / 4, 0);
+
+        for (size_t g = 0; g < groups; g++) {
+            const unsigned char* group = plane + g * kGroupSize;
+            unsigned char maxValue = *std::max_element(group, group + kGroupSize);
+
+            int mode = maxValue == 0 ? 0 : maxValue < 4 ? 1 : maxValue < 16 ? 2 : 3;
+            out[headerOffset + g / 4] |= (unsigned char)(mode << ((g % 4) * 2));
+
+            if (mode == 1) {
+                for (size_t i = 0; i < kGroupSize; i += 4) {
+                    out.push_back((unsigned char)(group[i] | (group[i + 1] << 2) | (group[i + 2] << 4) | (group[i + 3] << 6)));
+                }
+            } else if (mode == 2) {
+                for (size_t i = 0; i < kGroupSize; i += 2) {
+                    out.push_back((unsigned char)(group[i] | (group[i + 1] << 4)));
+                }
+            } else if (mode == 3) {
+                out.insert(out.end(), group, group + kGroupSize);
+            }
+        }
+    }
+
+    inline void unpack2(const unsigned char* source, unsigned char* group) {
+#if defined(MESH_CODEC_NEON)
+        unsigned char temp[8] = {};
+        std::memcpy(temp, source, 4);
+        uint8x8_t v = vld1_u8(temp);
+        uint8x8_t mask = vdup_n_u8(3);
+        uint8x8x2_t ab = vzip_u8(vand_u8(v, mask), vand_u8(vshr_n_u8(v, 2), mask));
+        uint8x8x2_t cd = vzip_u8(vand_u8(vshr_n_u8(v, 4), mask), vshr_n_u8(v, 6));
+        uint16x4x2_t abcd = vzip_u16(vreinterpret_u16_u8(ab.val[0]), vreinterpret_u16_u8(cd.val[0]));
+        vst1q_u8(group, vcombine_u8(vreinterpret_u8_u16(abcd.val[0]), vreinterpret_u8_u16(abcd.val[1])));
+#elif defined(MESH_CODEC_SSE2)
+        int packed;
+        std::memcpy(&packed, source, 4);
+        __m128i v = _mm_cvtsi32_si128(packed);
+        __m128i mask = _mm_set1_epi8(3);
+        __m128i a = _mm_and_si128(v, mask);
+        __m128i b = _mm_and_si128(_mm_srli_epi16(v, 2), mask);
+        __m128i c = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        __m128i d = _mm_and_si128(_mm_srli_epi16(v, 6), mask);
+        __m128i result = _mm_unpacklo_epi16(_mm_unpacklo_epi8(a, b), _mm_unpacklo_epi8(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(group), result);
+#else
+        for (size_t i = 0; i < kGroupSize; i++) {
+            group[i] = (source[i / 4] >> ((i % 4) * 2)) & 3;
+        }
+#endif
+    }
+
+    inline void unpack4(const unsigned char* source, unsigned char* group) {
+#if defined(MESH_CODEC_NEON)
+        uint8x8_t v = vld1_u8(source);
+        uint8x8x2_t zipped = vzip_u8(vand_u8(v, vdup_n_u8(15)), vshr_n_u8(v, 4));
+        vst1q_u8(group, vcombine_u8(zipped.val[0], zipped.val[1]));
+#elif defined(MESH_CODEC_SSE2)
+        __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source));
+        __m128i mask = _mm_set1_epi8(15);
+        __m128i result = _mm_unpacklo_epi8(_mm_and_si128(v, mask), _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(group), result);
+#else
+        for (size_t i = 0; i < kGroupSize; i++) {
+            group[i] = (source[i / 2] >> ((i % 2) * 4)) & 15;
+        }
+#endif
+    }
+
+    bool decodePlane(const unsigned char* data, size_t size, size_t& offset, unsigned char* plane, size_t groups) {
+        size_t headerSize = (groups + 3) / 4;
+        if (offset + headerSize > size) return false;
+
+        const unsigned char* header = data + offset;
+        offset += headerSize;
+
+        for (size_t g = 0; g < groups; g++) {
+            int mode = (header[g / 4] >> ((g % 4) * 2)) & 3;
+            size_t payload = kGroupPayload[mode];
+            if (offset + payload > size) return false;
+
+            unsigned char* group = plane + g * kGroupSize;
+            const unsigned char* source = data + offset;
+            switch (mode) {
+                case 0: std::memset(group, 0, kGroupSize); break;
+                case 1: unpack2(source, group); break;
+                case 2: unpack4(source, group); break;
+                case 3: std::memcpy(group, source, kGroupSize); break;
+            }
+            offset += payload;
+        }
+        return true;
+    }
+
+    // Rebuilds one 32-bit channel from its four byte planes: interleave, undo the
+    // zigzag and prefix-sum the deltas, four vertices per register
+    void reconstructChannel(unsigned char planes[4][kBlockVertices], size_t count, uint32_t& previous,
+                            unsigned char* destination, size_t vertexSize) {
+        uint32_t words[kBlockVertices];
+        size_t padded = (count + kGroupSize - 1) / kGroupSize * kGroupSize;
+
+#if defined(MESH_CODEC_NEON)
+        uint32x4_t zero = vdupq_n_u32(0);
+        uint32x4_t one = vdupq_n_u32(1);
+        uint32x4_t carry = vdupq_n_u32(previous);
+        for (size_t i = 0; i < padded; i += kGroupSize) {
+            uint8x16x2_t z01 = vzipq_u8(vld1q_u8(planes[0] + i), vld1q_u8(planes[1] + i));
+            uint8x16x2_t z23 = vzipq_u8(vld1q_u8(planes[2] + i), vld1q_u8(planes[3] + i));
+            uint16x8x2_t low = vzipq_u16(vreinterpretq_u16_u8(z01.val[0]), vreinterpretq_u16_u8(z23.val[0]));
+            uint16x8x2_t high = vzipq_u16(vreinterpretq_u16_u8(z01.val[1]), vreinterpretq_u16_u8(z23.val[1]));
+            uint32x4_t quads[4] = {
+                vreinterpretq_u32_u16(low.val[0]), vreinterpretq_u32_u16(low.val[1]),
+                vreinterpretq_u32_u16(high.val[0]), vreinterpretq_u32_u16(high.val[1])
+            };
+
+            for (int q = 0; q < 4; q++) {
+                uint32x4_t w = quads[q];
+                uint32x4_t d = veorq_u32(vshrq_n_u32(w, 1), vsubq_u32(zero, vandq_u32(w, one)));
+                d = vaddq_u32(d, vextq_u32(zero, d, 3));
+                d = vaddq_u32(d, vextq_u32(zero, d, 2));
+                d = vaddq_u32(d, carry);
+                carry = vdupq_n_u32(vgetq_lane_u32(d, 3));
+                vst1q_u32(words + i + q * 4, d);
+            }
+        }
+        previous = words[count - 1];
+#elif defined(MESH_CODEC_SSE2)
+        __m128i zero = _mm_setzero_si128();
+        __m128i one = _mm_set1_epi32(1);
+        __m128i carry = _mm_set1_epi32((int)previous);
+        for (size_t i = 0; i < padded; i += kGroupSize) {
+            __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[0] + i));
+            __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[1] + i));
+            __m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[2] + i));
+            __m128i p3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[3] + i));
+            __m128i low01 = _mm_unpacklo_epi8(p0, p1), high01 = _mm_unpackhi_epi8(p0, p1);
+            __m128i low23 = _mm_unpacklo_epi8(p2, p3), high23 = _mm_unpackhi_epi8(p2, p3);
+            __m128i quads[4] = {
+                _mm_unpacklo_epi16(low01, low23), _mm_unpackhi_epi16(low01, low23),
+                _mm_unpacklo_epi16(high01, high23), _mm_unpackhi_epi16(high01, high23)
+            };
+
+            for (int q = 0; q < 4; q++) {
+                __m128i w = quads[q];
+                __m128i d = _mm_xor_si128(_mm_srli_epi32(w, 1), _mm_sub_epi32(zero, _mm_and_si128(w, one)));
+                d = _mm_add_epi32(d, _mm_slli_si128(d, 4));
+                d = _mm_add_epi32(d, _mm_slli_si128(d, 8));
+                d = _mm_add_epi32(d, carry);
+                carry = _mm_shuffle_epi32(d, 0xFF);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(words + i + q * 4), d);
+            }
+        }
+        previous = words[count - 1];
+#else
+        for (size_t i = 0; i < padded; i++) {
+            uint32_t word = planes[0][i] | (planes[1][i] << 8) | (planes[2][i] << 16) | ((uint32_t)planes[3][i] << 24);
+            previous += unzigzag(word);
+            words[i] = previous;
+        }
+        previous = words[count - 1];
+#endif
+
+        for (size_t i = 0; i < count; i++) {
+            std::memcpy(destination + i * vertexSize, &words[i], sizeof(uint32_t));
+        }
+    }
+
+    void writeVarint(std::vector<unsigned char>& out, uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back((unsigned char)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((unsigned char)value);
+    }
+
+    bool readVarint(const unsigned char* data, size_t size, size_t& offset, uint32_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (offset >= size) return false;
+            unsigned char byte = data[offset++];
+            value |= (uint32_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    // Shared by the encoder and decoder so both sides evolve identically
+    struct IndexState {
+        uint32_t edges[kFifoSize][2];
+        uint32_t vertices[kFifoSize];
+        size_t edgeOffset = 0;
+        size_t vertexOffset = 0;
+        uint32_t next = 0;
+        uint32_t last = 0;
+
+        IndexState() {
+            std::memset(edges, 0xFF, sizeof(edges));
+            std::memset(vertices, 0xFF, sizeof(vertices));
+        }
+
+        void pushEdge(uint32_t a, uint32_t b) {
+            edges[edgeOffset % kFifoSize][0] = a;
+            edges[edgeOffset % kFifoSize][1] = b;
+            edgeOffset++;
+        }
+
+        int findEdge(uint32_t a, uint32_t b) const {
+            for (size_t i = 0; i < kFifoSize - 1; i++) {
+                size_t index = (edgeOffset - 1 - i) % kFifoSize;
+                if (edges[index][0] == a && edges[index][1] == b) return (int)i;
+            }
+            return -1;
+        }
+
+        const uint32_t* edge(int i) const {
+            return edges[(edgeOffset - 1 - i) % kFifoSize];
+        }
+
+        void pushVertex(uint32_t v) {
+            vertices[vertexOffset % kFifoSize] = v;
+            vertexOffset++;
+        }
+
+        int findVertex(uint32_t v) const {
+            for (size_t i = 0; i < kFifoSize - 2; i++) {
+                if (vertices[(vertexOffset - 1 - i) % kFifoSize] == v) return (int)i;
+            }
+            return -1;
+        }
+
+        uint32_t vertex(int i) const {
+            return vertices[(vertexOffset - 1 - i) % kFifoSize];
+        }
+
+        // Nibble 0 is the next unseen vertex, 1..14 the vertex FIFO, 15 an explicit delta
+        int encodeVertex(uint32_t v, std::vector<uint32_t>& explicitValues) {
+            if (v == next) {
+                next++;
+                pushVertex(v);
+                return 0;
+            }
+
+            int cached = findVertex(v);
+            if (cached >= 0) return cached + 1;
+
+            explicitValues.push_back(zigzag(v - last));
+            last = v;
+            pushVertex(v);
+            return 15;
+        }
+
+        bool decodeVertex(int nibble, const unsigned char* data, size_t size, size_t& offset, uint32_t& v) {
+            if (nibble == 0) {
+                v = next++;
+                pushVertex(v);
+                return true;
+            }
+            if (nibble < 15) {
+                v = vertex(nibble - 1);
+                return true;
+            }
+
+            uint32_t delta;
+            if (!readVarint(data, size, offset, delta)) return false;
+            v = last + unzigzag(delta);
+            last = v;
+            pushVertex(v);
+            return true;
+        }
+    };
+}
+
+std::vector<unsigned char> meshCodec::encodeVertexBuffer(const void* vertices, size_t vertexCount, size_t vertexSize) {
+    std::vector<unsigned char> out;
+    if (vertexSize == 0 || vertexSize % 4 != 0) return out;
+
+    const unsigned char* source = static_cast<const unsigned char*>(vertices);
+    const size_t channels = vertexSize / 4;
+    std::vector<uint32_t> previous(channels, 0);
+
+    out.reserve(vertexCount * vertexSize / 2 + 1);
+    out.push_back(kVertexHeader);
+
+    unsigned char planes[4][kBlockVertices];
+    for (size_t start = 0; start < vertexCount; start += kBlockVertices) {
+        const size_t count = std::min(kBlockVertices, vertexCount - start);
+        const size_t groups = (count + kGroupSize - 1) / kGroupSize;
+
+        for (size_t channel = 0; channel < channels; channel++) {
+            std::memset(planes, 0, sizeof(planes));
+
+            for (size_t i = 0; i < count; i++) {
+                uint32_t word;
+                std::memcpy(&word, source + (start + i) * vertexSize + channel * 4, sizeof(uint32_t));
+
+                uint32_t delta = zigzag(word - previous[channel]);
+                previous[channel] = word;
+
+                planes[0][i] = (unsigned char)delta;
+                planes[1][i] = (unsigned char)(delta >> 8);
+                planes[2][i] = (unsigned char)(delta >> 16);
+                planes[3][i] = (unsigned char)(delta >> 24);
+            }
+
+            for (int b = 0; b < 4; b++) {
+                encodePlane(planes[b], groups, out);
+            }
+        }
+    }
+
+    return out;
+}
+
+bool meshCodec::decodeVertexBuffer(void* destination, size_t vertexCount, size_t vertexSize, const unsigned char* data, size_t size) {
+    if (vertexSize == 0 || vertexSize % 4 != 0) return false;
+    if (size < 1 || data[0] != kVertexHeader) return false;
+
+    unsigned char* target = static_cast<unsigned char*>(destination);
+    const size_t channels = vertexSize / 4;
+    std::vector<uint32_t> previous(channels, 0);
+    size_t offset = 1;
+
+    unsigned char planes[4][kBlockVertices];
+    for (size_t start = 0; start < vertexCount; start += kBlockVertices) {
+        const size_t count = std::min(kBlockVertices, vertexCount - start);
+        const size_t groups = (count + kGroupSize - 1) / kGroupSize;
+
+        for (size_t channel = 0; channel < channels; channel++) {
+            for (int b = 0; b < 4; b++) {
+                if (!decodePlane(data, size, offset, planes[b], groups)) return false;
+            }
+            reconstructChannel(planes, count, previous[channel], target + start * vertexSize + channel * 4, vertexSize);
+        }
+    }
+
+    return offset == size;
+}
+
+// Every block of kBlockVertices stores at least one header byte per byte plane
+size_t meshCodec::maxVertexCount(size_t vertexSize, size_t size) {
+    if (vertexSize == 0 || vertexSize % 4 != 0 || size < 1) return 0;
+    return (size - 1) / vertexSize * kBlockVertices;
+}
+
+std::vector<unsigned char> meshCodec::encodeIndexBuffer(const unsigned int* indices, size_t indexCount) {
+    std::vector<unsigned char> out;
+    if (indexCount % 3 != 0) return out;
+
+    out.reserve(indexCount + 1);
+    out.push_back(kIndexHeader);
+
+    IndexState state;
+    std::vector<uint32_t> explicitValues;
+
+    for (size_t i = 0; i < indexCount; i += 3) {
+        const uint32_t triangle[3] = { indices[i], indices[i + 1], indices[i + 2] };
+        explicitValues.clear();
+
+        int rotation = -1, edgeIndex = -1;
+        for (int r = 0; r < 3 && edgeIndex < 0; r++) {
+            edgeIndex = state.findEdge(triangle[r], triangle[(r + 1) % 3]);
+            if (edgeIndex >= 0) rotation = r;
+        }
+
+        if (edgeIndex >= 0) {
+            uint32_t x = triangle[rotation], y = triangle[(rotation + 1) % 3], z = triangle[(rotation + 2) % 3];
+            int nibble = state.encodeVertex(z, explicitValues);
+
+            out.push_back((unsigned char)((edgeIndex << 4) | nibble));
+            state.pushEdge(z, y);
+            state.pushEdge(x, z);
+        } else {
+            int na = state.encodeVertex(triangle[0], explicitValues);
+            int nb = state.encodeVertex(triangle[1], explicitValues);
+            int nc = state.encodeVertex(triangle[2], explicitValues);
+
+            out.push_back(0xFF);
+            out.push_back((unsigned char)((na << 4) | nb));
+            out.push_back((unsigned char)(nc << 4));
+            state.pushEdge(triangle[1], triangle[0]);
+            state.pushEdge(triangle[2], triangle[1]);
+            state.pushEdge(triangle[0], triangle[2]);
+        }
+
+        for (uint32_t value : explicitValues) writeVarint(out, value);
+    }
+
+    return out;
+}
+
+bool meshCodec::decodeIndexBuffer(unsigned int* destination, size_t indexCount, const unsigned char* data, size_t size) {
+    if (indexCount % 3 != 0) return false;
+    if (size < 1 || data[0] != kIndexHeader) return false;
+
+    IndexState state;
+    size_t offset = 1;
+
+    for (size_t i = 0; i < indexCount; i += 3) {
+        if (offset >= size) return false;
+        unsigned char code = data[offset++];
+
+        if ((code >> 4) < 15) {
+            const uint32_t* edge = state.edge(code >> 4);
+            uint32_t x = edge[0], y = edge[1], z;
+            if (!state.decodeVertex(code & 15, data, size, offset, z)) return false;
+
+            destination[i] = x;
+            destination[i + 1] = y;
+            destination[i + 2] = z;
+            state.pushEdge(z, y);
+            state.pushEdge(x, z);
+        } else {
+            if (code != 0xFF || offset + 2 > size) return false;
+            int nibbles[3] = { data[offset] >> 4, data[offset] & 15, data[offset + 1] >> 4 };
+            offset += 2;
+
+            uint32_t triangle[3];
+            for (int v = 0; v < 3; v++) {
+                if (!state.decodeVertex(nibbles[v], data, size, offset, triangle[v])) return false;
+            }
+
+            destination[i] = triangle[0];
+            destination[i + 1] = triangle[1];
+            destination[i + 2] = triangle[2];
+            state.pushEdge(triangle[1], triangle[0]);
+            state.pushEdge(triangle[2], triangle[1]);
+            state.pushEdge(triangle[0], triangle[2]);
+        }
+    }
+
+    return offset == size;
+}
+
+// Every triangle takes at least its code byte
+size_t meshCodec::maxIndexCount(size_t size) {
+    return size < 1 ? 0 : (size - 1) * 3;
+}
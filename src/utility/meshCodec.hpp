@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lossless geometry codec used by the on-disk mesh cache.
+//
+// Vertex streams are split into 32-bit channels, delta coded against the previous
+// vertex, zigzagged and transposed into byte planes. Each plane is stored in groups
+// of 16 bytes packed at 0, 2, 4 or 8 bits per byte, which the decoder expands with
+// SSE2/NEON when available.
+//
+// Index buffers are coded per triangle against a FIFO of recently seen edges and
+// vertices. Triangles keep their winding but may come back rotated, i.e. (a, b, c)
+// can decode as (b, c, a).
+namespace meshCodec {
+    std::vector<unsigned char> encodeVertexBuffer(const void* vertices, size_t vertexCount, size_t vertexSize);
+    bool decodeVertexBuffer(void* destination, size_t vertexCount, size_t vertexSize, const unsigned char* data, size_t size);
+
+    std::vector<unsigned char> encodeIndexBuffer(const unsigned int* indices, size_t indexCount);
+    bool decodeIndexBuffer(unsigned int* destination, size_t indexCount, const unsigned char* data, size_t size);
+
+    // Most elements an encoded stream of size bytes can decode to, so counts read from a
+    // file can be checked before anything is allocated for them
+    size_t maxVertexCount(size_t vertexSize, size_t size);
+    size_t maxIndexCount(size_t size);
+}
@@ -7,37 +7,172 @@
 
 #include "model.hpp"
 #include "importUtils.hpp"
+#include "cookedTexture.hpp"
+#include "gltfLoader.hpp"
+#include "jobSystem.hpp"
+#include "meshCache.hpp"
+#include "tangentFrame.hpp"
+#include "textureBudget.hpp"
+
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+    float surfaceArea(const Mesh& mesh) {
+        float area = 0.0f;
+        const size_t vertexCount = mesh.vertices.size();
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            if (mesh.indices[i] >= vertexCount || mesh.indices[i + 1] >= vertexCount || mesh.indices[i + 2] >= vertexCount) continue;
+            simd::float3 a = mesh.vertices[mesh.indices[i]].position;
+            simd::float3 b = mesh.vertices[mesh.indices[i + 1]].position;
+            simd::float3 c = mesh.vertices[mesh.indices[i + 2]].position;
+            area += simd::length(simd::cross(b - a, c - a)) * 0.5f;
+        }
+        return area;
+    }
+}
 
 Model::Model() = default;
 
 Model::Model(std::string path, MTL::Device* device) {
     m_device = device;
+    m_path = path;
     std::cout << "Starting model loading" << std::endl;
     loadModel(path);
     std::cout << "Ending model loading" << std::endl;
 }
 
 void Model::loadModel(std::string& path) {
+    if (gltf::isGltfPath(path)) {
+        m_directory = path.substr(0, path.find_last_of('/'));
+        gltf::loadModel(path, m_device, m_pendingMeshes, m_meshInstances, m_textures_loaded);
+        return;
+    }
+    
+    if (meshCache::isCachePath(path)) {
+        loadCache(path);
+        return;
+    }
+    
     Assimp::Importer importer;
     const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
     
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         std::cout << "Error::Assimp::" << importer.GetErrorString() << std::endl;
+        return;
     }
     m_directory = path.substr(0, path.find_last_of('/'));
     
-    processNode(scene->mRootNode, scene);
+    std::vector<int> meshLookup(scene->mNumMeshes, -1);
+    processNode(scene->mRootNode, scene, TransformHierarchy::kNoParent, meshLookup);
+    updateTransforms();
+    uploadPendingTextures();
+    generateMissingTangents();
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
+void Model::generateMissingTangents() {
+    jobs::Counter tangentJobs;
+    
+    for (Mesh& mesh : m_pendingMeshes) {
+        if (mesh.vertices.empty() || tangentFrame::hasTangents(mesh.vertices)) continue;
+        
+        jobs::run([&mesh]() {
+            tangentFrame::generateTangents(mesh.vertices, mesh.indices);
+        }, &tangentJobs);
+    }
+    
+    jobs::wait(tangentJobs);
+}
+
+void Model::loadCache(std::string& path) {
+    m_directory = path.substr(0, path.find_last_of('/'));
+    
+    std::vector<meshCache::CachedMesh> cachedMeshes;
+    if (!meshCache::read(path, cachedMeshes)) {
+        std::cout << "Error::MeshCache::Could not read " << path << std::endl;
+        return;
+    }
+    
+    for (meshCache::CachedMesh& cached : cachedMeshes) {
+        std::vector<Texture> textures;
+        for (meshCache::CachedTexture& cachedTexture : cached.textures) {
+            textures.push_back(loadTexture(cachedTexture.path, cachedTexture.type));
+        }
+        m_pendingMeshes.push_back(Mesh(cached.vertices, cached.indices, textures, cached.endpoints));
+        m_meshInstances.push_back(std::move(cached.instances));
+    }
+    uploadPendingTextures();
+    generateMissingTangents();
+}
+
+bool Model::writeCache(const std::string& path) {
+    std::vector<meshCache::CachedMesh> cachedMeshes;
+    cachedMeshes.reserve(m_meshes.size());
+    
+    for (size_t i = 0; i < m_meshes.size(); i++) {
+        const Mesh& mesh = *m_meshes[i];
+        meshCache::CachedMesh cached;
+        cached.vertices = mesh.vertices;
+        cached.indices = mesh.indices;
+        cached.endpoints = mesh.endpoints;
+        cached.instances = m_meshInstances[i];
+        for (const Texture& texture : mesh.textures) {
+            cached.textures.push_back({ texture.type, texture.path });
+        }
+        cachedMeshes.push_back(std::move(cached));
+    }
+    
+    return meshCache::write(path, cachedMeshes);
+}
+
+// Each aiMesh is converted once, every node that references it only adds an instance
+void Model::processNode(aiNode* node, const aiScene* scene, uint32_t parent, std::vector<int>& meshLookup) {
+    aiVector3D scaling, position;
+    aiQuaternion rotation;
+    node->mTransformation.Decompose(scaling, rotation, position);
+    uint32_t transform = m_transforms.append(parent, simd_make_float3(position.x, position.y, position.z),
+                                             simd_quaternion(rotation.x, rotation.y, rotation.z, rotation.w),
+                                             simd_make_float3(scaling.x, scaling.y, scaling.z));
+    
+    // Decompose drops shear, whatever TRS misses of the node matrix stays on it as a residual
+    aiMatrix4x4 trs(scaling, rotation, position);
+    if (trs.Determinant() != 0.0f) {
+        aiMatrix4x4 residual = trs.Inverse() * node->mTransformation;
+        if (!residual.Equal(aiMatrix4x4(), 1e-4f)) m_transforms.setResidual(transform, importUtils::toMatrix(residual));
+    }
+    
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        m_meshes.push_back(processMesh(mesh, scene));
+        unsigned int meshIndex = node->mMeshes[i];
+        if (meshLookup[meshIndex] < 0) {
+            meshLookup[meshIndex] = (int)m_pendingMeshes.size();
+            m_pendingMeshes.push_back(processMesh(scene->mMeshes[meshIndex], scene));
+            m_instanceNodes.emplace_back();
+            m_meshInstances.emplace_back();
+        }
+        m_instanceNodes[meshLookup[meshIndex]].push_back(transform);
     }
     
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, transform, meshLookup);
+    }
+}
+
+void Model::updateTransforms() {
+    if (m_transforms.update() == 0) return;
+    
+    for (size_t i = 0; i < m_instanceNodes.size(); i++) {
+        const std::vector<uint32_t>& nodes = m_instanceNodes[i];
+        bool changed = false;
+        for (uint32_t node : nodes) changed |= m_transforms.wasUpdated(node);
+        if (!changed) continue;
+        
+        std::vector<simd::float4x4>& instances = m_meshInstances[i];
+        instances.resize(nodes.size());
+        for (size_t j = 0; j < nodes.size(); j++) {
+            instances[j] = m_transforms.world(nodes[j]);
+        }
     }
+    updateBounds();
 }
 
 Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
@@ -48,111 +183,167 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
         -1, -1, -1, -1
     };
     
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        Vertex vertex;
-        simd::float3 vector = {
-            mesh->mVertices[i].x,
-            mesh->mVertices[i].y,
-            mesh->mVertices[i].z
-        };
-        vertex.position = vector;
-        
-        if (mesh->HasNormals()) {
-            vector = {
-                mesh->mNormals[i].x,
-                mesh->mNormals[i].y,
-                mesh->mNormals[i].z
-            };
-            vertex.normal = vector;
-        }
-        
-        if (mesh->mTextureCoords[0]) {
-            simd::float2 vec;
-            vec.x = mesh->mTextureCoords[0][i].x;
-            vec.y = mesh->mTextureCoords[0][i].y;
-            vertex.texCoords = vec;
-        } else {
-            vertex.texCoords = (simd::float2) {
-                0, 0
-            };
+    importUtils::extractGeometry(mesh, vertices, indices);
+    
+    if (mesh->mMaterialIndex < scene->mNumMaterials) {
+        std::vector<meshCache::CachedTexture> materialTextures;
+        importUtils::materialTextures(scene->mMaterials[mesh->mMaterialIndex], materialTextures, endpoints);
+        for (meshCache::CachedTexture& materialTexture : materialTextures) {
+            textures.push_back(loadTexture(materialTexture.path, materialTexture.type));
         }
-        
-        vertices.push_back(vertex);
     }
     
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
-        for (unsigned int j = 0; j < face.mNumIndices; j++) {
-            indices.push_back(face.mIndices[j]);
+    return Mesh(vertices, indices, textures, endpoints);
+}
+
+Texture Model::loadTexture(const std::string& path, const std::string& typeName) {
+    for (unsigned int j = 0; j < m_textures_loaded.size(); j++) {
+        if (std::strcmp(m_textures_loaded[j].path.c_str(), path.c_str()) == 0) {
+            return m_textures_loaded[j];
         }
     }
     
-    int textureAmount = 0;
-    if (mesh->mMaterialIndex >= 0) {
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        std::string materialType = "diffuse";
-        std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, materialType);
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        if (diffuseMaps.size() > 0) {
-            endpoints.diffuse = textureAmount;
-            textureAmount += diffuseMaps.size();
-        }
-        
-        materialType = "specular";
-        std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, materialType);
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        if (specularMaps.size() > 0) {
-            endpoints.specular = textureAmount;
-            textureAmount += specularMaps.size();
+    Texture texture;
+    texture.actualTexture = nullptr;
+    texture.type = typeName;
+    texture.path = path;
+    
+    // Raw images wait for uploadPendingTextures, which fits them to the texture budget
+    // and packs the small ones into shared atlas pages
+    if (cookedTexture::isCookedTexturePath(path)) {
+        texture.actualTexture = importUtils::textureFromCooked(m_directory + "/" + path, m_device);
+    } else {
+        texturePacker::Image image;
+        if (!importUtils::imageFromFile(m_directory + "/" + path, image)) {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+        } else {
+            m_pendingImages.push_back(std::move(image));
+            m_pendingTextures.push_back(m_textures_loaded.size());
         }
     }
+    m_textures_loaded.push_back(texture);
     
-    return Mesh(vertices, indices, textures, endpoints);
+    return texture;
 }
 
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial* material, aiTextureType type, std::string& typeName) {
-    std::vector<Texture> textures;
+void Model::uploadPendingTextures() {
+    if (m_pendingImages.empty()) return;
     
-    unsigned int count = material->GetTextureCount(type);
+    // Textures covering more surface across more instances are the last to lose resolution
+    std::unordered_map<std::string, float> relevance;
+    for (size_t i = 0; i < m_pendingMeshes.size(); i++) {
+        const Mesh& mesh = m_pendingMeshes[i];
+        float area = surfaceArea(mesh) * std::max<size_t>(1, m_meshInstances[i].size());
+        for (const Texture& texture : mesh.textures) relevance[texture.path] += area;
+    }
     
-    for (unsigned int i = 0; i < count; i++) {
-        aiString str;
-        material->GetTexture(type, i, &str);
-        bool skip = false;
-        
-        for (unsigned int j = 0; j < m_textures_loaded.size(); j++) {
-            if (std::strcmp(m_textures_loaded[j].path.c_str(), str.C_Str()) == 0) {
-                textures.push_back(m_textures_loaded[j]);
-                skip = true;
+    std::vector<Texture*> targets;
+    std::vector<textureBudget::Usage> usage;
+    for (size_t index : m_pendingTextures) {
+        Texture& texture = m_textures_loaded[index];
+        targets.push_back(&texture);
+        usage.push_back({ texture.type, relevance[texture.path] });
+    }
+    textureBudget::fit(m_pendingImages, usage);
+    importUtils::uploadPacked(m_pendingImages, targets, m_device);
+    
+    // Meshes hold copies of the loaded textures, point them at the uploaded ones
+    for (Mesh& mesh : m_pendingMeshes) {
+        for (Texture& texture : mesh.textures) {
+            if (texture.actualTexture) continue;
+            for (const Texture& loaded : m_textures_loaded) {
+                if (loaded.path != texture.path) continue;
+                texture.actualTexture = loaded.actualTexture;
+                texture.uvTransform = loaded.uvTransform;
                 break;
             }
         }
-        
-        if (!skip) {
-            Texture texture;
-            std::string path = std::string(str.C_Str());
-            texture.actualTexture = importUtils::textureFromFile(path, this->m_directory, m_device);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            m_textures_loaded.push_back(texture);
-        }
     }
     
-    return textures;
+    m_pendingImages.clear();
+    m_pendingTextures.clear();
 }
 
-void Model::setupMeshBuffers(MTL::Device* device, MTL::Function* function) {
-    for (Mesh& mesh: m_meshes) {
-        mesh.setupMesh(device, function);
+void Model::setupMeshBuffers(MTL::Device* device, MaterialTable& materials) {
+    for (Mesh& mesh: m_pendingMeshes) {
+        mesh.materialIndex = materials.add(mesh.textures, mesh.endpoints);
+        mesh.setupMesh(device);
+        m_meshes.push_back(std::make_shared<const Mesh>(std::move(mesh)));
     }
+    m_pendingMeshes.clear();
+    m_meshInstances.resize(m_meshes.size());
+    updateBounds();
 }
 
-void Model::draw(MTL::RenderCommandEncoder* encoder) {
-    for (Texture texture : m_textures_loaded) {
-        encoder->useResource(texture.actualTexture, MTL::ResourceUsageSample, MTL::RenderStageFragment);
-    }
-    for (Mesh& mesh : m_meshes) {
-        mesh.draw(encoder);
+void Model::updateBounds() {
+    size_t boxCount = 0;
+    for (const std::vector<simd::float4x4>& instances : m_meshInstances) boxCount += std::max<size_t>(1, instances.size());
+    
+    m_instanceBounds.resize(boxCount);
+    m_boxMeshes.resize(boxCount);
+    m_meshFirstBox.resize(m_meshes.size());
+    
+    simd::float3 sceneMin = simd_make_float3(INFINITY, INFINITY, INFINITY);
+    simd::float3 sceneMax = -sceneMin;
+    size_t box = 0;
+    for (size_t i = 0; i < m_meshes.size(); i++) {
+        m_meshFirstBox[i] = (uint32_t)box;
+        
+        // An empty instance list still draws once with identity
+        const size_t instances = std::max<size_t>(1, m_meshInstances[i].size());
+        for (size_t j = 0; j < instances; j++, box++) {
+            m_boxMeshes[box] = (uint32_t)i;
+            simd::float3 center, extent;
+            culling::transformBox(m_meshes[i]->bounds, instanceTransform((uint32_t)box), center, extent);
+            
+            m_instanceBounds.set(box, center, extent);
+            sceneMin = simd::min(sceneMin, center - extent);
+            sceneMax = simd::max(sceneMax, center + extent);
+        }
     }
+    
+    m_boundsVersion++;
+    m_sphereCenter = boxCount ? (sceneMin + sceneMax) * 0.5f : simd_make_float3(0.0f, 0.0f, 0.0f);
+    m_sphereRadius = boxCount ? simd::length(sceneMax - sceneMin) * 0.5f : 0.0f;
+}
+
+simd::float4x4 Model::instanceTransform(uint32_t box) const {
+    const uint32_t mesh = m_boxMeshes[box];
+    const std::vector<simd::float4x4>& instances = m_meshInstances[mesh];
+    return instances.empty() ? m_placement : simd_mul(m_placement, instances[box - m_meshFirstBox[mesh]]);
+}
+
+MeshInstance Model::instanceData(uint32_t box) const {
+    const simd::float4x4 transform = instanceTransform(box);
+    simd::float3x3 linear = simd_matrix(transform.columns[0].xyz, transform.columns[1].xyz, transform.columns[2].xyz);
+    
+    MeshInstance data;
+    data.transform = transform;
+    data.normalTransform = simd_transpose(simd_inverse(linear));
+    return data;
+}
+
+void Model::bindMesh(gfx::CommandList& commands, uint32_t box) const {
+    m_meshes[m_boxMeshes[box]]->bindVertices(commands);
+}
+
+void Model::drawMesh(gfx::CommandList& commands, uint32_t box, uint32_t firstInstance, uint32_t instanceCount) const {
+    m_meshes[m_boxMeshes[box]]->drawInstances(commands, firstInstance, instanceCount);
+}
+
+void Model::setPlacement(const simd::float4x4& placement) {
+    m_placement = placement;
+    updateBounds();
+}
+
+size_t Model::occluderTriangles(uint32_t box) const {
+    const Mesh& mesh = *m_meshes[m_boxMeshes[box]];
+    return mesh.vertices.empty() ? 0 : mesh.indices.size() / 3;
+}
+
+void Model::addOccluder(OcclusionBuffer& buffer, uint32_t box, const simd::float4x4& viewProjection) const {
+    const Mesh& mesh = *m_meshes[m_boxMeshes[box]];
+    
+    buffer.addOccluder(simd_mul(viewProjection, instanceTransform(box)), &mesh.vertices[0].position, sizeof(Vertex), mesh.vertices.size(),
+                       mesh.indices.data(), mesh.indices.size());
 }
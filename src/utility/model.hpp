@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
 #include <string>
 
 #include <assimp/Importer.hpp>
@@ -8,22 +9,83 @@
 #include <assimp/postprocess.h>
 
 #include "mesh.h"
+#include "materialTable.hpp"
+#include "occlusionBuffer.hpp"
+#include "texturePacker.hpp"
+#include "transformHierarchy.hpp"
 
 class Model {
 public:
     Model();
     Model(std::string path, MTL::Device* device);
-    void draw(MTL::RenderCommandEncoder* encoder);
-    void setupMeshBuffers(MTL::Device* device, MTL::Function* function);
+    size_t instanceCount() const { return m_instanceBounds.count; }
+    
+    // World-space box of every instance, boundsVersion changes whenever they are rewritten
+    const culling::BoxSet& instanceBounds() const { return m_instanceBounds; }
+    uint32_t boundsVersion() const { return m_boundsVersion; }
+    // Mesh and material behind an instance box, for callers that order draws themselves
+    size_t meshCount() const { return m_meshes.size(); }
+    uint32_t meshOf(uint32_t box) const { return m_boxMeshes[box]; }
+    uint32_t materialOf(uint32_t box) const { return m_meshes[m_boxMeshes[box]]->materialIndex; }
+    const void* meshGeometry(size_t mesh) const { return m_meshes[mesh]->geometry(); }
+    MeshInstance instanceData(uint32_t box) const;
+    // Records binding the vertices of the box's mesh, then drawing it with instanceCount
+    // instances from the buffer bound at index 1
+    void bindMesh(gfx::CommandList& commands, uint32_t box) const;
+    void drawMesh(gfx::CommandList& commands, uint32_t box, uint32_t firstInstance, uint32_t instanceCount) const;
+    // Triangles an instance box offers as an occluder, 0 when its mesh only lives on the GPU
+    size_t occluderTriangles(uint32_t box) const;
+    void addOccluder(OcclusionBuffer& buffer, uint32_t box, const simd::float4x4& viewProjection) const;
+    // Uploads the loaded meshes and hands them over to m_meshes, copies made after this share them
+    void setupMeshBuffers(MTL::Device* device, MaterialTable& materials);
+    bool writeCache(const std::string& path);
+    
+    // Node transforms of models imported through Assimp. Changes reach the instance
+    // bounds on the next updateTransforms(). Published models are edited through a copy,
+    // see Renderer::setNodeTransform.
+    TransformHierarchy& transforms() { return m_transforms; }
+    const TransformHierarchy& transforms() const { return m_transforms; }
+    void updateTransforms();
+    
+    // Moves the whole model. Copies share geometry and materials and differ only in placement.
+    void setPlacement(const simd::float4x4& placement);
+    const simd::float4x4& placement() const { return m_placement; }
+    float boundingRadius() const { return m_sphereRadius; }
+    const std::string& path() const { return m_path; }
     
 private:
     std::vector<Texture> m_textures_loaded;
-    std::vector<Mesh> m_meshes;
+    // Meshes being imported, until setupMeshBuffers moves them into m_meshes
+    std::vector<Mesh> m_pendingMeshes;
+    std::vector<std::shared_ptr<const Mesh>> m_meshes;
+    // Model-space transform of every instance, per mesh. Empty means a single identity instance.
+    std::vector<std::vector<simd::float4x4>> m_meshInstances;
+    TransformHierarchy m_transforms;
+    // Hierarchy node of every instance, per mesh. Empty for caches and glTF, whose instances are baked.
+    std::vector<std::vector<uint32_t>> m_instanceNodes;
     std::string m_directory;
+    std::string m_path;
+    simd::float4x4 m_placement = matrix_identity_float4x4;
     MTL::Device* m_device;
+    // Decoded images waiting for uploadPendingTextures, with their m_textures_loaded index
+    std::vector<texturePacker::Image> m_pendingImages;
+    std::vector<size_t> m_pendingTextures;
+    // World-space box of every mesh instance, mesh by mesh. m_boxMeshes holds each box's
+    // mesh and m_meshFirstBox where a mesh's boxes start.
+    culling::BoxSet m_instanceBounds;
+    std::vector<uint32_t> m_boxMeshes;
+    std::vector<uint32_t> m_meshFirstBox;
+    simd::float3 m_sphereCenter = simd_make_float3(0.0f, 0.0f, 0.0f);
+    float m_sphereRadius = 0.0f;
+    uint32_t m_boundsVersion = 0;
     
     void loadModel(std::string& path);
-    void processNode(aiNode* node, const aiScene* scene);
+    void loadCache(std::string& path);
+    void generateMissingTangents();
+    void processNode(aiNode* node, const aiScene* scene, uint32_t parent, std::vector<int>& meshLookup);
     Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> loadMaterialTextures(aiMaterial* material, aiTextureType type, std::string& typeName);
+    Texture loadTexture(const std::string& path, const std::string& typeName);
+    void uploadPendingTextures();
+    void updateBounds();
+    simd::float4x4 instanceTransform(uint32_t box) const;
 };
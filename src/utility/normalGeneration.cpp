@@ -0,0 +1,226 @@
+#include "normalGeneration.hpp"
+#include "jobSystem.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+namespace {
+    constexpr uint32_t kEmptySlot = 0xFFFFFFFF;
+    constexpr size_t kMinItemsPerThread = 16384;
+
+    // A thread count only caps how finely the range is split, the job system decides who runs it
+    void parallelRanges(size_t count, unsigned int threadCount, const std::function<void(size_t, size_t)>& function) {
+        size_t grain = kMinItemsPerThread;
+        if (threadCount > 0) grain = std::max(grain, (count + threadCount - 1) / threadCount);
+        jobs::parallelFor(count, grain, function);
+    }
+
+    // Adding 0 folds -0 into +0 so both hash and compare equal
+    inline void positionKey(const simd::float3& position, uint32_t key[3]) {
+        float components[3] = { position.x + 0.0f, position.y + 0.0f, position.z + 0.0f };
+        std::memcpy(key, components, sizeof(components));
+    }
+
+    inline uint32_t hashPosition(const uint32_t key[3]) {
+        uint32_t h = key[0] * 73856093u ^ key[1] * 19349663u ^ key[2] * 83492791u;
+        h ^= h >> 16;
+        h *= 0x7feb352du;
+        h ^= h >> 15;
+        return h;
+    }
+
+    inline simd::float3 safeNormalize(simd::float3 v) {
+        float length = simd::length(v);
+        if (length < 1e-20f) return simd_make_float3(0.0f, 0.0f, 1.0f);
+        return v / length;
+    }
+}
+
+void normalGeneration::generateNormals(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const Options& options) {
+    const size_t vertexCount = vertices.size();
+    const size_t faceCount = indices.size() / 3;
+    const size_t cornerCount = faceCount * 3;
+    if (vertexCount == 0 || faceCount == 0) return;
+
+    const unsigned int threadCount = options.threadCount;
+
+    // Per-corner contribution: face normal scaled by area and/or the corner angle.
+    // Each face is independent and only touches its own three slots.
+    std::vector<simd::float3> faceNormals(faceCount);
+    std::vector<simd::float3> contributions(cornerCount);
+    parallelRanges(faceCount, threadCount, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; f++) {
+            unsigned int i0 = indices[f * 3], i1 = indices[f * 3 + 1], i2 = indices[f * 3 + 2];
+            if (i0 >= vertexCount || i1 >= vertexCount || i2 >= vertexCount) {
+                faceNormals[f] = simd_make_float3(0.0f, 0.0f, 0.0f);
+                for (int k = 0; k < 3; k++) contributions[f * 3 + k] = faceNormals[f];
+                continue;
+            }
+
+            simd::float3 p[3] = { vertices[i0].position, vertices[i1].position, vertices[i2].position };
+            simd::float3 e[3] = { p[1] - p[0], p[2] - p[1], p[0] - p[2] };
+            simd::float3 cross = simd::cross(e[0], -e[2]);
+
+            faceNormals[f] = safeNormalize(cross);
+            simd::float3 weighted = options.areaWeighted ? cross : faceNormals[f];
+
+            for (int k = 0; k < 3; k++) {
+                float angle = 1.0f;
+                if (options.angleWeighted) {
+                    simd::float3 a = e[k], b = -e[(k + 2) % 3];
+                    float denominator = std::sqrt(simd::length_squared(a) * simd::length_squared(b));
+                    float cosine = denominator > 0.0f ? simd::dot(a, b) / denominator : 1.0f;
+                    angle = std::acos(std::fmax(-1.0f, std::fmin(1.0f, cosine)));
+                }
+                contributions[f * 3 + k] = weighted * angle;
+            }
+        }
+    });
+
+    // Weld vertices by exact position with a lock-free open addressing table. The
+    // first vertex to claim a slot becomes the representative for its position.
+    size_t tableSize = 1;
+    while (tableSize < vertexCount * 2) tableSize <<= 1;
+    const size_t mask = tableSize - 1;
+
+    std::vector<std::atomic<uint32_t>> table(tableSize);
+    for (auto& slot : table) slot.store(kEmptySlot, std::memory_order_relaxed);
+
+    std::vector<uint32_t> group(vertexCount);
+    parallelRanges(vertexCount, threadCount, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; v++) {
+            uint32_t key[3];
+            positionKey(vertices[v].position, key);
+            size_t slot = hashPosition(key) & mask;
+
+            while (true) {
+                uint32_t current = table[slot].load(std::memory_order_acquire);
+                if (current == kEmptySlot) {
+                    if (table[slot].compare_exchange_strong(current, (uint32_t)v, std::memory_order_acq_rel)) {
+                        group[v] = (uint32_t)v;
+                        break;
+                    }
+                }
+
+                uint32_t other[3];
+                positionKey(vertices[current].position, other);
+                if (std::memcmp(key, other, sizeof(key)) == 0) {
+                    group[v] = current;
+                    break;
+                }
+                slot = (slot + 1) & mask;
+            }
+        }
+    });
+
+    // Every corner is listed under its position group. Slots are handed out in whatever order
+    // threads run, so each group's list is sorted to keep the sums, and the cache, reproducible.
+    std::vector<std::atomic<uint32_t>> groupCounts(vertexCount + 1);
+    for (auto& count : groupCounts) count.store(0, std::memory_order_relaxed);
+
+    parallelRanges(cornerCount, threadCount, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            if (indices[c] < vertexCount) groupCounts[group[indices[c]]].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    std::vector<uint32_t> groupStart(vertexCount + 1);
+    uint32_t running = 0;
+    for (size_t g = 0; g < vertexCount; g++) {
+        groupStart[g] = running;
+        running += groupCounts[g].load(std::memory_order_relaxed);
+        groupCounts[g].store(groupStart[g], std::memory_order_relaxed);
+    }
+    groupStart[vertexCount] = running;
+
+    std::vector<uint32_t> groupCorners(running);
+    parallelRanges(cornerCount, threadCount, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            if (indices[c] >= vertexCount) continue;
+            uint32_t slot = groupCounts[group[indices[c]]].fetch_add(1, std::memory_order_relaxed);
+            groupCorners[slot] = (uint32_t)c;
+        }
+    });
+    parallelRanges(vertexCount, threadCount, [&](size_t begin, size_t end) {
+        for (size_t g = begin; g < end; g++) {
+            std::sort(groupCorners.begin() + groupStart[g], groupCorners.begin() + groupStart[g + 1]);
+        }
+    });
+
+    if (options.smoothingAngleDegrees >= 180.0f) {
+        // Everything at a position is smoothed together, each group sums its corners once
+        std::vector<simd::float3> groupNormals(vertexCount);
+        parallelRanges(vertexCount, threadCount, [&](size_t begin, size_t end) {
+            for (size_t g = begin; g < end; g++) {
+                if (group[g] != g) continue;
+                simd::float3 sum = simd_make_float3(0.0f, 0.0f, 0.0f);
+                for (uint32_t i = groupStart[g]; i < groupStart[g + 1]; i++) sum += contributions[groupCorners[i]];
+                groupNormals[g] = safeNormalize(sum);
+            }
+        });
+
+        parallelRanges(vertexCount, threadCount, [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; v++) vertices[v].normal = groupNormals[group[v]];
+        });
+        return;
+    }
+
+    const float cosThreshold = std::cos(options.smoothingAngleDegrees * (float)M_PI / 180.0f);
+    std::vector<simd::float3> cornerNormals(cornerCount);
+    parallelRanges(cornerCount, threadCount, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            if (indices[c] >= vertexCount) continue;
+
+            simd::float3 own = faceNormals[c / 3];
+            simd::float3 sum = simd_make_float3(0.0f, 0.0f, 0.0f);
+            uint32_t g = group[indices[c]];
+            for (uint32_t i = groupStart[g]; i < groupStart[g + 1]; i++) {
+                uint32_t other = groupCorners[i];
+                if (simd::dot(own, faceNormals[other / 3]) >= cosThreshold) sum += contributions[other];
+            }
+            cornerNormals[c] = safeNormalize(simd::length_squared(sum) > 0.0f ? sum : own);
+        }
+    });
+
+    // Vertices referenced by corners that disagree on the normal are split
+    constexpr float kSameNormal = 0.9999f;
+    std::vector<bool> assigned(vertexCount, false);
+    std::vector<std::vector<uint32_t>> duplicates;
+    std::vector<int32_t> duplicateList(vertexCount, -1);
+
+    for (size_t c = 0; c < cornerCount; c++) {
+        uint32_t v = indices[c];
+        if (v >= vertexCount) continue;
+
+        if (!assigned[v]) {
+            vertices[v].normal = cornerNormals[c];
+            assigned[v] = true;
+            continue;
+        }
+        if (simd::dot(vertices[v].normal, cornerNormals[c]) >= kSameNormal) continue;
+
+        if (duplicateList[v] < 0) {
+            duplicateList[v] = (int32_t)duplicates.size();
+            duplicates.emplace_back();
+        }
+
+        uint32_t match = kEmptySlot;
+        for (uint32_t candidate : duplicates[duplicateList[v]]) {
+            if (simd::dot(vertices[candidate].normal, cornerNormals[c]) >= kSameNormal) {
+                match = candidate;
+                break;
+            }
+        }
+        if (match == kEmptySlot) {
+            match = (uint32_t)vertices.size();
+            Vertex copy = vertices[v];
+            copy.normal = cornerNormals[c];
+            vertices.push_back(copy);
+            duplicates[duplicateList[v]].push_back(match);
+        }
+        indices[c] = match;
+    }
+}
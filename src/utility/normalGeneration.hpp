@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+#include "vertex.hpp"
+
+namespace normalGeneration {
+    struct Options {
+        // Faces meeting at a sharper angle than this get separate vertices. 180 or
+        // more smooths everything that shares a position.
+        float smoothingAngleDegrees = 80.0f;
+        bool areaWeighted = true;
+        bool angleWeighted = true;
+        // Most ranges the work is split into, 0 leaves it to the job system
+        unsigned int threadCount = 0;
+    };
+
+    // Computes vertex normals from the triangles in indices. Vertices sharing a
+    // position are smoothed together even if they were split for UV seams, and
+    // vertices that end up with more than one normal are duplicated, so both
+    // vertices and indices may grow.
+    void generateNormals(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const Options& options = Options());
+}
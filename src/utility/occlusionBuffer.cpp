@@ -0,0 +1,275 @@
+#include "occlusionBuffer.hpp"
+#include "jobSystem.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OCCLUSION_BUFFER_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define OCCLUSION_BUFFER_SSE2 1
+#endif
+
+namespace {
+    // Width is padded to a multiple of the tile size, so spans can always write four pixels
+    constexpr int kLanes = 4;
+    constexpr float kFar = 1.0f;
+
+    struct Span {
+        float edgeX[3];
+        float edgeRow[3];
+        float depthX;
+        float depthRow;
+    };
+
+    // Keeps the nearer depth wherever the pixel lies inside all three edges, x0 is a multiple of kLanes
+    void rasterizeSpan(float* row, int x0, int x1, const Span& span) {
+#if defined(OCCLUSION_BUFFER_NEON)
+        const float laneOffsets[kLanes] = { 0.5f, 1.5f, 2.5f, 3.5f };
+        const float32x4_t lanes = vld1q_f32(laneOffsets);
+        for (int x = x0; x <= x1; x += kLanes) {
+            float32x4_t px = vaddq_f32(vdupq_n_f32((float)x), lanes);
+            uint32x4_t inside = vcgeq_f32(vmlaq_n_f32(vdupq_n_f32(span.edgeRow[0]), px, span.edgeX[0]), vdupq_n_f32(0.0f));
+            inside = vandq_u32(inside, vcgeq_f32(vmlaq_n_f32(vdupq_n_f32(span.edgeRow[1]), px, span.edgeX[1]), vdupq_n_f32(0.0f)));
+            inside = vandq_u32(inside, vcgeq_f32(vmlaq_n_f32(vdupq_n_f32(span.edgeRow[2]), px, span.edgeX[2]), vdupq_n_f32(0.0f)));
+            if (vmaxvq_u32(inside) == 0) continue;
+
+            float32x4_t depth = vld1q_f32(row + x);
+            float32x4_t z = vmlaq_n_f32(vdupq_n_f32(span.depthRow), px, span.depthX);
+            vst1q_f32(row + x, vbslq_f32(inside, vminq_f32(depth, z), depth));
+        }
+#elif defined(OCCLUSION_BUFFER_SSE2)
+        const __m128 lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+        for (int x = x0; x <= x1; x += kLanes) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+            __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(span.edgeX[0])), _mm_set1_ps(span.edgeRow[0])), zero);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(span.edgeX[1])), _mm_set1_ps(span.edgeRow[1])), zero));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(span.edgeX[2])), _mm_set1_ps(span.edgeRow[2])), zero));
+            if (_mm_movemask_ps(inside) == 0) continue;
+
+            __m128 depth = _mm_loadu_ps(row + x);
+            __m128 z = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(span.depthX)), _mm_set1_ps(span.depthRow));
+            __m128 nearer = _mm_min_ps(depth, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, depth)));
+        }
+#else
+        for (int x = x0; x <= x1; x++) {
+            float px = x + 0.5f;
+            if (px * span.edgeX[0] + span.edgeRow[0] < 0.0f || px * span.edgeX[1] + span.edgeRow[1] < 0.0f ||
+                px * span.edgeX[2] + span.edgeRow[2] < 0.0f) continue;
+            row[x] = std::min(row[x], px * span.depthX + span.depthRow);
+        }
+#endif
+    }
+
+    // Clips the polygon against the near plane z >= -w, returns the new vertex count
+    int clipNear(const simd::float4* input, int count, simd::float4* output) {
+        int outputCount = 0;
+        for (int i = 0; i < count; i++) {
+            const simd::float4& a = input[i];
+            const simd::float4& b = input[(i + 1) % count];
+            float distanceA = a.z + a.w;
+            float distanceB = b.z + b.w;
+
+            if (distanceA >= 0.0f) output[outputCount++] = a;
+            if ((distanceA >= 0.0f) != (distanceB >= 0.0f)) {
+                float t = distanceA / (distanceA - distanceB);
+                output[outputCount++] = a + (b - a) * t;
+            }
+        }
+        return outputCount;
+    }
+}
+
+OcclusionBuffer::OcclusionBuffer(int width, int height) {
+    resize(width, height);
+}
+
+void OcclusionBuffer::resize(int width, int height) {
+    m_width = (std::max(width, 1) + kTileSize - 1) / kTileSize * kTileSize;
+    m_height = (std::max(height, 1) + kTileSize - 1) / kTileSize * kTileSize;
+    m_tilesX = m_width / kTileSize;
+    m_depth.assign((size_t)m_width * m_height, kFar);
+    m_tileMax.assign((size_t)m_tilesX * (m_height / kTileSize), kFar);
+    m_triangles.clear();
+}
+
+void OcclusionBuffer::clear() {
+    std::fill(m_depth.begin(), m_depth.end(), kFar);
+    std::fill(m_tileMax.begin(), m_tileMax.end(), kFar);
+    m_triangles.clear();
+}
+
+void OcclusionBuffer::addOccluder(const simd::float4x4& modelViewProjection, const void* positions, size_t stride,
+                                  size_t vertexCount, const uint32_t* indices, size_t indexCount) {
+    std::vector<simd::float4> clip(vertexCount);
+    const unsigned char* bytes = static_cast<const unsigned char*>(positions);
+    for (size_t i = 0; i < vertexCount; i++) {
+        float position[3];
+        std::memcpy(position, bytes + i * stride, sizeof(position));
+        clip[i] = simd_mul(modelViewProjection, simd_make_float4(position[0], position[1], position[2], 1.0f));
+    }
+
+    const float width = (float)m_width;
+    const float height = (float)m_height;
+    auto toScreen = [width, height](simd::float4 v) {
+        return simd_make_float3((v.x / v.w * 0.5f + 0.5f) * width, (0.5f - v.y / v.w * 0.5f) * height, v.z / v.w);
+    };
+
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount) continue;
+        simd::float4 polygon[3] = { clip[indices[i]], clip[indices[i + 1]], clip[indices[i + 2]] };
+
+        const simd::float4* vertices = polygon;
+        int count = 3;
+        simd::float4 clipped[4];
+        if (polygon[0].z + polygon[0].w < 0.0f || polygon[1].z + polygon[1].w < 0.0f || polygon[2].z + polygon[2].w < 0.0f) {
+            count = clipNear(polygon, 3, clipped);
+            vertices = clipped;
+        }
+
+        for (int k = 1; k + 1 < count; k++) {
+            setupTriangle(toScreen(vertices[0]), toScreen(vertices[k]), toScreen(vertices[k + 1]));
+        }
+    }
+}
+
+void OcclusionBuffer::setupTriangle(simd::float3 v0, simd::float3 v1, simd::float3 v2) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (!(std::fabs(area) > 1e-6f)) return;
+    // Occluders are double sided, wind everything the same way
+    if (area < 0.0f) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    Triangle triangle;
+    triangle.minX = std::max(0, (int)std::floor(std::min({ v0.x, v1.x, v2.x })));
+    triangle.maxX = std::min(m_width - 1, (int)std::floor(std::max({ v0.x, v1.x, v2.x })));
+    triangle.minY = std::max(0, (int)std::floor(std::min({ v0.y, v1.y, v2.y })));
+    triangle.maxY = std::min(m_height - 1, (int)std::floor(std::max({ v0.y, v1.y, v2.y })));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) return;
+
+    // Inside is edge >= 0 for all three, evaluated at pixel centres. Shrinking the edges to fully
+    // covered pixels would open cracks along every edge shared inside a mesh.
+    const simd::float3 from[3] = { v0, v1, v2 };
+    const simd::float3 to[3] = { v1, v2, v0 };
+    for (int e = 0; e < 3; e++) {
+        triangle.edgeX[e] = from[e].y - to[e].y;
+        triangle.edgeY[e] = to[e].x - from[e].x;
+        triangle.edgeOffset[e] = from[e].x * to[e].y - from[e].y * to[e].x;
+    }
+
+    // z / w is affine in screen space, take the plane at the farthest corner of each pixel
+    triangle.depthX = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+    triangle.depthY = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+    triangle.depthOffset = v0.z - triangle.depthX * v0.x - triangle.depthY * v0.y +
+                           0.5f * (std::fabs(triangle.depthX) + std::fabs(triangle.depthY));
+
+    m_triangles.push_back(triangle);
+}
+
+void OcclusionBuffer::rasterize() {
+    jobs::parallelFor(m_height / kTileSize, 1, [this](size_t begin, size_t end) {
+        for (size_t tileRow = begin; tileRow < end; tileRow++) rasterizeTileRow((int)tileRow);
+    });
+}
+
+void OcclusionBuffer::rasterizeTileRow(int tileRow) {
+    const int rowBegin = tileRow * kTileSize;
+    const int rowEnd = rowBegin + kTileSize - 1;
+
+    for (const Triangle& triangle : m_triangles) {
+        if (triangle.maxY < rowBegin || triangle.minY > rowEnd) continue;
+
+        const int x0 = triangle.minX / kLanes * kLanes;
+        Span span;
+        std::memcpy(span.edgeX, triangle.edgeX, sizeof(span.edgeX));
+        span.depthX = triangle.depthX;
+        for (int y = std::max(triangle.minY, rowBegin); y <= std::min(triangle.maxY, rowEnd); y++) {
+            const float py = y + 0.5f;
+            for (int e = 0; e < 3; e++) span.edgeRow[e] = triangle.edgeY[e] * py + triangle.edgeOffset[e];
+            span.depthRow = triangle.depthY * py + triangle.depthOffset;
+            rasterizeSpan(m_depth.data() + (size_t)y * m_width, x0, triangle.maxX, span);
+        }
+    }
+
+    for (int tileX = 0; tileX < m_tilesX; tileX++) {
+        float farthest = -INFINITY;
+        for (int y = rowBegin; y <= rowEnd; y++) {
+            const float* row = m_depth.data() + (size_t)y * m_width + tileX * kTileSize;
+            for (int x = 0; x < kTileSize; x++) farthest = std::max(farthest, row[x]);
+        }
+        m_tileMax[(size_t)tileRow * m_tilesX + tileX] = farthest;
+    }
+}
+
+bool OcclusionBuffer::isOccluded(const simd::float4x4& viewProjection, simd::float3 min, simd::float3 max) const {
+    float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY, nearest = INFINITY;
+    for (int corner = 0; corner < 8; corner++) {
+        simd::float4 point = simd_make_float4(corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y,
+                                              corner & 4 ? max.z : min.z, 1.0f);
+        simd::float4 clip = simd_mul(viewProjection, point);
+        // Boxes reaching through the near plane are in the camera's face
+        if (clip.z + clip.w < 0.0f || clip.w <= 0.0f) return false;
+
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * m_width;
+        float y = (0.5f - clip.y / clip.w * 0.5f) * m_height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip.z / clip.w);
+    }
+
+    // Off screen is for the frustum test to decide
+    if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height) return false;
+    const int x0 = std::max(0, (int)std::floor(minX));
+    const int x1 = std::min(m_width - 1, (int)std::floor(maxX));
+    const int y0 = std::max(0, (int)std::floor(minY));
+    const int y1 = std::min(m_height - 1, (int)std::floor(maxY));
+
+    for (int tileY = y0 / kTileSize; tileY <= y1 / kTileSize; tileY++) {
+        for (int tileX = x0 / kTileSize; tileX <= x1 / kTileSize; tileX++) {
+            if (nearest > m_tileMax[(size_t)tileY * m_tilesX + tileX]) continue;
+
+            // Tile is not hidden as a whole, look at the pixels the box covers
+            const int rowBegin = std::max(y0, tileY * kTileSize), rowEnd = std::min(y1, tileY * kTileSize + kTileSize - 1);
+            const int columnBegin = std::max(x0, tileX * kTileSize), columnEnd = std::min(x1, tileX * kTileSize + kTileSize - 1);
+            for (int y = rowBegin; y <= rowEnd; y++) {
+                const float* row = m_depth.data() + (size_t)y * m_width;
+                for (int x = columnBegin; x <= columnEnd; x++) {
+                    if (nearest <= row[x]) return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool OcclusionBuffer::writePgm(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "Error::OcclusionBuffer::Could not write " << path << "\n";
+        return false;
+    }
+
+    float nearest = kFar;
+    for (float depth : m_depth) nearest = std::min(nearest, depth);
+    const float range = std::max(kFar - nearest, 1e-6f);
+
+    std::vector<unsigned char> pixels(m_depth.size());
+    for (size_t i = 0; i < m_depth.size(); i++) {
+        pixels[i] = m_depth[i] >= kFar ? 0 : (unsigned char)(255.0f - 223.0f * (m_depth[i] - nearest) / range);
+    }
+
+    file << "P5\n" << m_width << " " << m_height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+    return true;
+}
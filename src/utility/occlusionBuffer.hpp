@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <simd/simd.h>
+
+// Software occlusion culling. Occluder triangles are rasterized on the CPU into a small
+// depth buffer, then boxes are tested against it. Occluders cover the pixels whose centres
+// they cover, like the GPU would, at the farthest depth they reach inside the pixel. A box
+// counts as hidden only if every pixel it touches is nearer than its nearest point.
+// Depth is z / w with 1 as the far plane. Near clipping assumes the -w..w depth range of
+// Camera::getPerspectiveMatrix.
+class OcclusionBuffer {
+public:
+    // Tiles keep the farthest depth of their pixels, rows of tiles are rasterized in parallel
+    static constexpr int kTileSize = 8;
+
+    OcclusionBuffer(int width = 256, int height = 128);
+
+    // Sizes are rounded up to whole tiles
+    void resize(int width, int height);
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+    // Drops the occluders of the previous frame and clears to the far plane
+    void clear();
+
+    // positions are vertexCount float3 values stride bytes apart, transformed by modelViewProjection
+    void addOccluder(const simd::float4x4& modelViewProjection, const void* positions, size_t stride, size_t vertexCount,
+                     const uint32_t* indices, size_t indexCount);
+    size_t triangleCount() const { return m_triangles.size(); }
+
+    // Draws every occluder added since clear
+    void rasterize();
+
+    bool isOccluded(const simd::float4x4& viewProjection, simd::float3 min, simd::float3 max) const;
+
+    float depthAt(int x, int y) const { return m_depth[(size_t)y * m_width + x]; }
+    // Binary PGM of the depth, nearer is brighter and uncovered pixels are black
+    bool writePgm(const std::string& path) const;
+
+private:
+    // Edge functions and the depth plane, pushed to the farthest corner of each pixel
+    struct Triangle {
+        float edgeX[3], edgeY[3], edgeOffset[3];
+        float depthX, depthY, depthOffset;
+        int minX, maxX, minY, maxY;
+    };
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_tilesX = 0;
+    std::vector<float> m_depth;
+    std::vector<float> m_tileMax;
+    std::vector<Triangle> m_triangles;
+
+    void setupTriangle(simd::float3 v0, simd::float3 v1, simd::float3 v2);
+    void rasterizeTileRow(int tileRow);
+};
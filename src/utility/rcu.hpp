@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Read-copy-update cell for one reader thread and any number of writers. Writers copy the
+// current value, change the copy and publish it with one atomic exchange, so the reader never
+// waits on them. The reader pins the current value for a frame and reads it without locks.
+// Replaced values are retired with the frame the reader was on at the time, reclaim destroys
+// them once that frame has completed, GPU work included.
+template <typename T>
+class Rcu {
+public:
+    Rcu() : m_current(new T()) {}
+    ~Rcu() {
+        delete m_current.load();
+        for (const Retired& retired : m_retired) delete retired.value;
+    }
+
+    Rcu(const Rcu&) = delete;
+    Rcu& operator=(const Rcu&) = delete;
+
+    // Reader side. frame has to grow from one pin to the next. The pointer stays valid until
+    // reclaim is called with a completed frame at or past this one.
+    const T* pin(uint64_t frame) {
+        m_readerFrame.store(frame);
+        return m_current.load();
+    }
+
+    // Destroys what was retired before completedFrame finished. Never waits, if a writer is
+    // busy publishing the retired values are left for the next call.
+    void reclaim(uint64_t completedFrame) {
+        std::vector<T*> expired;
+        {
+            std::unique_lock<std::mutex> lock(m_writerMutex, std::try_to_lock);
+            if (!lock.owns_lock()) return;
+
+            auto kept = m_retired.begin();
+            for (const Retired& retired : m_retired) {
+                if (retired.frame <= completedFrame) expired.push_back(retired.value);
+                else *kept++ = retired;
+            }
+            m_retired.erase(kept, m_retired.end());
+        }
+        for (T* value : expired) delete value;
+    }
+
+    // Writer side, change gets a copy of the newest value to edit before it is published.
+    // Writers are serialized among themselves only.
+    template <typename Function>
+    void update(Function&& change) {
+        std::lock_guard<std::mutex> lock(m_writerMutex);
+        T* next = new T(*m_current.load());
+        std::forward<Function>(change)(*next);
+
+        // The reader records its frame before loading the pointer, so whatever frame is read
+        // here covers every pin that could still see the previous value
+        T* previous = m_current.exchange(next);
+        m_retired.push_back({ previous, m_readerFrame.load() });
+    }
+
+private:
+    struct Retired {
+        T* value;
+        uint64_t frame;
+    };
+
+    std::atomic<T*> m_current;
+    std::atomic<uint64_t> m_readerFrame{ 0 };
+    std::mutex m_writerMutex;
+    std::vector<Retired> m_retired;
+};
@@ -0,0 +1,523 @@
+#include "sceneBvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace {
+    constexpr int kBins = 16;
+    constexpr uint32_t kMaxLeafItems = 4;
+    // Subtrees with at least this many items are built as separate jobs
+    constexpr uint32_t kParallelItems = 4096;
+    // Nodes with at least this many items also bin in parallel
+    constexpr uint32_t kParallelBinning = 65536;
+    // Cost of visiting a node relative to testing one item
+    constexpr float kTraversalCost = 1.0f;
+    constexpr float kRebuildRatio = 1.5f;
+
+    struct Range {
+        simd::float3 min = simd_make_float3(INFINITY, INFINITY, INFINITY);
+        simd::float3 max = simd_make_float3(-INFINITY, -INFINITY, -INFINITY);
+
+        void grow(simd::float3 point) {
+            min = simd::min(min, point);
+            max = simd::max(max, point);
+        }
+        void grow(const Range& other) {
+            min = simd::min(min, other.min);
+            max = simd::max(max, other.max);
+        }
+        float area() const {
+            simd::float3 size = simd::max(max - min, simd_make_float3(0.0f, 0.0f, 0.0f));
+            return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+        }
+    };
+
+    struct Bins {
+        Range bounds[3][kBins];
+        uint32_t counts[3][kBins] = {};
+
+        void merge(const Bins& other) {
+            for (int axis = 0; axis < 3; axis++) {
+                for (int bin = 0; bin < kBins; bin++) {
+                    bounds[axis][bin].grow(other.bounds[axis][bin]);
+                    counts[axis][bin] += other.counts[axis][bin];
+                }
+            }
+        }
+    };
+
+    // Runs fill(begin, end, partial) over [begin, end) and merges the partials into result,
+    // split across the job system when the range is large
+    template <typename Partial, typename Fill, typename Merge>
+    void accumulate(uint32_t begin, uint32_t end, Partial& result, Fill fill, Merge merge) {
+        if (end - begin < kParallelBinning) {
+            fill(begin, end, result);
+            return;
+        }
+
+        std::mutex mutex;
+        jobs::parallelFor(end - begin, kParallelBinning / 4, [&](size_t rangeBegin, size_t rangeEnd) {
+            Partial partial;
+            fill(begin + (uint32_t)rangeBegin, begin + (uint32_t)rangeEnd, partial);
+            std::lock_guard<std::mutex> lock(mutex);
+            merge(result, partial);
+        });
+    }
+
+    template <typename Node>
+    float nodeArea(const Node& node) {
+        float x = node.max[0] - node.min[0], y = node.max[1] - node.min[1], z = node.max[2] - node.min[2];
+        return 2.0f * (x * y + y * z + z * x);
+    }
+
+    template <typename A, typename B>
+    float unionArea(const A& a, const B& b) {
+        float size[3];
+        for (int axis = 0; axis < 3; axis++) {
+            size[axis] = std::max(a.max[axis], b.max[axis]) - std::min(a.min[axis], b.min[axis]);
+        }
+        return 2.0f * (size[0] * size[1] + size[1] * size[2] + size[2] * size[0]);
+    }
+
+    template <typename Target, typename A, typename B>
+    void setUnion(Target& target, const A& a, const B& b) {
+        for (int axis = 0; axis < 3; axis++) {
+            target.min[axis] = std::min(a.min[axis], b.min[axis]);
+            target.max[axis] = std::max(a.max[axis], b.max[axis]);
+        }
+    }
+
+    // Entry distance of the ray into the box, INFINITY when it misses or starts past limit
+    template <typename Node>
+    float enter(const Node& node, simd::float3 origin, simd::float3 inverse, float limit) {
+        float near = 0.0f, far = limit;
+        for (int axis = 0; axis < 3; axis++) {
+            float t0 = (node.min[axis] - origin[axis]) * inverse[axis];
+            float t1 = (node.max[axis] - origin[axis]) * inverse[axis];
+            near = std::max(near, std::min(t0, t1));
+            far = std::min(far, std::max(t0, t1));
+        }
+        return near <= far ? near : INFINITY;
+    }
+}
+
+void SceneBvh::resize(size_t itemCount) {
+    m_boxes.assign(itemCount, Box{});
+    m_items.clear();
+    m_itemLeaves.assign(itemCount, kNoNode);
+    m_nodes.clear();
+    m_parents.clear();
+    m_dirty.clear();
+    m_built = false;
+    m_costSum = 0.0f;
+    m_builtCost = 0.0f;
+}
+
+void SceneBvh::setItem(uint32_t item, simd::float3 min, simd::float3 max) {
+    Box& box = m_boxes[item];
+    for (int axis = 0; axis < 3; axis++) {
+        box.min[axis] = min[axis];
+        box.max[axis] = max[axis];
+    }
+    if (!m_built) return;
+
+    for (uint32_t node = m_itemLeaves[item]; node != kNoNode && !m_dirty[node]; node = m_parents[node]) {
+        m_dirty[node] = 1;
+    }
+}
+
+void SceneBvh::build() {
+    const uint32_t itemCount = (uint32_t)m_boxes.size();
+    m_items.resize(itemCount);
+    for (uint32_t i = 0; i < itemCount; i++) m_items[i] = i;
+
+    m_nodes.clear();
+    m_parents.clear();
+    m_dirty.clear();
+    m_costSum = 0.0f;
+    m_built = true;
+    if (itemCount == 0) return;
+
+    // A root and at most itemCount - 1 sibling pairs
+    m_nodes.resize(2 * (size_t)itemCount);
+    m_parents.assign(m_nodes.size(), kNoNode);
+
+    std::atomic<uint32_t> nodeCount{ 1 };
+    jobs::Counter counter;
+    buildNode(0, 0, itemCount, nodeCount, counter);
+    jobs::wait(counter);
+
+    m_nodes.resize(nodeCount);
+    m_parents.resize(nodeCount);
+    m_dirty.assign(nodeCount, 0);
+
+    for (const Node& node : m_nodes) m_costSum += contribution(node);
+    m_builtCost = cost();
+}
+
+void SceneBvh::buildNode(uint32_t nodeIndex, uint32_t begin, uint32_t end, std::atomic<uint32_t>& nodeCount, jobs::Counter& counter) {
+    const uint32_t count = end - begin;
+    auto centroid = [this](uint32_t item) {
+        const Box& box = m_boxes[item];
+        return simd_make_float3(box.min[0] + box.max[0], box.min[1] + box.max[1], box.min[2] + box.max[2]) * 0.5f;
+    };
+
+    struct Extents {
+        Range bounds;
+        Range centroids;
+    };
+    Extents extents;
+    accumulate(begin, end, extents, [&](uint32_t from, uint32_t to, Extents& partial) {
+        for (uint32_t i = from; i < to; i++) {
+            const Box& box = m_boxes[m_items[i]];
+            partial.bounds.grow(simd_make_float3(box.min[0], box.min[1], box.min[2]));
+            partial.bounds.grow(simd_make_float3(box.max[0], box.max[1], box.max[2]));
+            partial.centroids.grow(centroid(m_items[i]));
+        }
+    }, [](Extents& result, const Extents& partial) {
+        result.bounds.grow(partial.bounds);
+        result.centroids.grow(partial.centroids);
+    });
+
+    Node& node = m_nodes[nodeIndex];
+    for (int axis = 0; axis < 3; axis++) {
+        node.min[axis] = extents.bounds.min[axis];
+        node.max[axis] = extents.bounds.max[axis];
+    }
+
+    auto makeLeaf = [&]() {
+        node.first = begin;
+        node.count = count;
+        for (uint32_t i = begin; i < end; i++) m_itemLeaves[m_items[i]] = nodeIndex;
+    };
+    if (count == 1) {
+        makeLeaf();
+        return;
+    }
+
+    simd::float3 centroidSize = extents.centroids.max - extents.centroids.min;
+    simd::float3 scale;
+    for (int axis = 0; axis < 3; axis++) scale[axis] = centroidSize[axis] > 0.0f ? kBins / centroidSize[axis] : 0.0f;
+    auto binOf = [&](simd::float3 point, int axis) {
+        return std::min(kBins - 1, (int)((point[axis] - extents.centroids.min[axis]) * scale[axis]));
+    };
+
+    Bins bins;
+    accumulate(begin, end, bins, [&](uint32_t from, uint32_t to, Bins& partial) {
+        for (uint32_t i = from; i < to; i++) {
+            const uint32_t item = m_items[i];
+            const Box& box = m_boxes[item];
+            simd::float3 center = centroid(item);
+            for (int axis = 0; axis < 3; axis++) {
+                if (scale[axis] == 0.0f) continue;
+                int bin = binOf(center, axis);
+                partial.bounds[axis][bin].grow(simd_make_float3(box.min[0], box.min[1], box.min[2]));
+                partial.bounds[axis][bin].grow(simd_make_float3(box.max[0], box.max[1], box.max[2]));
+                partial.counts[axis][bin]++;
+            }
+        }
+    }, [](Bins& result, const Bins& partial) { result.merge(partial); });
+
+    // Sweep the split planes between bins from both sides
+    float bestCost = INFINITY;
+    int bestAxis = -1, bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        if (scale[axis] == 0.0f) continue;
+
+        float rightCosts[kBins];
+        Range right;
+        uint32_t rightCount = 0;
+        for (int bin = kBins - 1; bin > 0; bin--) {
+            right.grow(bins.bounds[axis][bin]);
+            rightCount += bins.counts[axis][bin];
+            rightCosts[bin] = right.area() * rightCount;
+        }
+
+        Range left;
+        uint32_t leftCount = 0;
+        for (int split = 1; split < kBins; split++) {
+            left.grow(bins.bounds[axis][split - 1]);
+            leftCount += bins.counts[axis][split - 1];
+            if (leftCount == 0 || leftCount == count) continue;
+
+            float cost = left.area() * leftCount + rightCosts[split];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    const float area = extents.bounds.area();
+    const float splitCost = area > 0.0f ? kTraversalCost + bestCost / area : kTraversalCost;
+    if (count <= kMaxLeafItems && (bestAxis < 0 || splitCost >= (float)count)) {
+        makeLeaf();
+        return;
+    }
+
+    uint32_t middle = begin + count / 2;
+    if (bestAxis >= 0) {
+        auto split = std::partition(m_items.begin() + begin, m_items.begin() + end, [&](uint32_t item) {
+            return binOf(centroid(item), bestAxis) < bestSplit;
+        });
+        middle = (uint32_t)(split - m_items.begin());
+    }
+    // Every centroid in one spot, any halving is as good as another
+    if (middle == begin || middle == end) middle = begin + count / 2;
+
+    const uint32_t children = nodeCount.fetch_add(2);
+    node.first = children;
+    node.count = 0;
+    m_parents[children] = nodeIndex;
+    m_parents[children + 1] = nodeIndex;
+
+    if (middle - begin >= kParallelItems) {
+        jobs::run([this, children, begin, middle, &nodeCount, &counter]() {
+            buildNode(children, begin, middle, nodeCount, counter);
+        }, &counter);
+    } else {
+        buildNode(children, begin, middle, nodeCount, counter);
+    }
+    buildNode(children + 1, middle, end, nodeCount, counter);
+}
+
+void SceneBvh::refit() {
+    if (!m_built) {
+        build();
+        return;
+    }
+    if (m_nodes.empty() || !m_dirty[0]) return;
+
+    refitNode(0);
+    if (cost() > m_builtCost * kRebuildRatio) build();
+}
+
+// Only descends into dirty children, so a refit costs the paths above the changed items
+void SceneBvh::refitNode(uint32_t nodeIndex) {
+    m_costSum -= contribution(m_nodes[nodeIndex]);
+
+    Node& node = m_nodes[nodeIndex];
+    if (node.count > 0) {
+        const Box& firstBox = m_boxes[m_items[node.first]];
+        setUnion(node, firstBox, firstBox);
+        for (uint32_t i = node.first + 1; i < node.first + node.count; i++) {
+            setUnion(node, node, m_boxes[m_items[i]]);
+        }
+    } else {
+        for (uint32_t child = node.first; child < node.first + 2; child++) {
+            if (m_dirty[child]) refitNode(child);
+        }
+        setUnion(node, m_nodes[node.first], m_nodes[node.first + 1]);
+        rotate(nodeIndex);
+    }
+
+    m_costSum += contribution(m_nodes[nodeIndex]);
+    m_dirty[nodeIndex] = 0;
+}
+
+// Swaps a child with a grandchild on the other side when that shrinks the other side.
+// The node itself keeps the same items, so its bounds don't change.
+void SceneBvh::rotate(uint32_t nodeIndex) {
+    const uint32_t children = m_nodes[nodeIndex].first;
+
+    float bestGain = 0.0f;
+    uint32_t bestChild = kNoNode, bestGrandchild = kNoNode, bestSibling = kNoNode;
+    for (uint32_t side = 0; side < 2; side++) {
+        const uint32_t child = children + side;
+        const uint32_t sibling = children + 1 - side;
+        const Node& siblingNode = m_nodes[sibling];
+        if (siblingNode.count > 0) continue;
+
+        const float siblingArea = nodeArea(siblingNode);
+        for (uint32_t pick = 0; pick < 2; pick++) {
+            const uint32_t grandchild = siblingNode.first + pick;
+            const uint32_t kept = siblingNode.first + 1 - pick;
+            float gain = siblingArea - unionArea(m_nodes[child], m_nodes[kept]);
+            if (gain > bestGain) {
+                bestGain = gain;
+                bestChild = child;
+                bestGrandchild = grandchild;
+                bestSibling = sibling;
+            }
+        }
+    }
+    // Ignore changes too small to be worth the churn
+    if (bestChild == kNoNode || bestGain < nodeArea(m_nodes[bestSibling]) * 0.01f) return;
+
+    m_costSum -= contribution(m_nodes[bestSibling]);
+    swapSubtrees(bestChild, bestGrandchild);
+    Node& sibling = m_nodes[bestSibling];
+    setUnion(sibling, m_nodes[sibling.first], m_nodes[sibling.first + 1]);
+    m_costSum += contribution(sibling);
+}
+
+void SceneBvh::swapSubtrees(uint32_t a, uint32_t b) {
+    std::swap(m_nodes[a], m_nodes[b]);
+    adopt(a);
+    adopt(b);
+}
+
+// Points the children or items of the node in this slot back at it
+void SceneBvh::adopt(uint32_t nodeIndex) {
+    const Node& node = m_nodes[nodeIndex];
+    if (node.count > 0) {
+        for (uint32_t i = node.first; i < node.first + node.count; i++) m_itemLeaves[m_items[i]] = nodeIndex;
+    } else {
+        m_parents[node.first] = nodeIndex;
+        m_parents[node.first + 1] = nodeIndex;
+    }
+}
+
+float SceneBvh::contribution(const Node& node) const {
+    return nodeArea(node) * (node.count > 0 ? (float)node.count : kTraversalCost);
+}
+
+float SceneBvh::cost() const {
+    if (m_nodes.empty()) return 0.0f;
+    const float rootArea = nodeArea(m_nodes[0]);
+    return rootArea > 0.0f ? m_costSum / rootArea : 0.0f;
+}
+
+void SceneBvh::queryFrustum(const culling::Frustum& frustum, std::vector<uint32_t>& items) const {
+    items.clear();
+    if (m_nodes.empty()) return;
+
+    // Planes a node is already entirely inside of are dropped for its whole subtree
+    struct Entry {
+        uint32_t node;
+        uint32_t planes;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    stack.push_back({ 0, 0x3F });
+    std::vector<uint32_t> straddling;
+
+    while (!stack.empty()) {
+        Entry entry = stack.back();
+        stack.pop_back();
+        const Node& node = m_nodes[entry.node];
+
+        bool outside = false;
+        for (int p = 0; p < 6 && entry.planes && !outside; p++) {
+            if (!(entry.planes & (1u << p))) continue;
+
+            const simd::float4& plane = frustum.planes[p];
+            float distance = plane.w, radius = 0.0f;
+            for (int axis = 0; axis < 3; axis++) {
+                distance += plane[axis] * (node.min[axis] + node.max[axis]) * 0.5f;
+                radius += std::fabs(plane[axis]) * (node.max[axis] - node.min[axis]) * 0.5f;
+            }
+            if (distance + radius < 0.0f) outside = true;
+            else if (distance - radius >= 0.0f) entry.planes &= ~(1u << p);
+        }
+        if (outside) continue;
+
+        if (node.count > 0) {
+            std::vector<uint32_t>& target = entry.planes ? straddling : items;
+            target.insert(target.end(), m_items.begin() + node.first, m_items.begin() + node.first + node.count);
+        } else {
+            stack.push_back({ node.first, entry.planes });
+            stack.push_back({ node.first + 1, entry.planes });
+        }
+    }
+    if (straddling.empty()) return;
+
+    // Items of leaves that cross a plane are tested on their own, all of them in one batched cull
+    culling::BoxSet boxes;
+    boxes.resize(straddling.size());
+    for (size_t i = 0; i < straddling.size(); i++) {
+        const Box& box = m_boxes[straddling[i]];
+        simd::float3 min = simd_make_float3(box.min[0], box.min[1], box.min[2]);
+        simd::float3 max = simd_make_float3(box.max[0], box.max[1], box.max[2]);
+        boxes.set(i, (min + max) * 0.5f, (max - min) * 0.5f);
+    }
+    std::vector<uint32_t> visible(straddling.size());
+    const size_t visibleCount = culling::cull(frustum, boxes, visible.data());
+    for (size_t i = 0; i < visibleCount; i++) items.push_back(straddling[visible[i]]);
+}
+
+void SceneBvh::queryBox(simd::float3 min, simd::float3 max, std::vector<uint32_t>& items) const {
+    items.clear();
+    if (m_nodes.empty()) return;
+
+    auto overlaps = [&](const auto& box) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (box.max[axis] < min[axis] || box.min[axis] > max[axis]) return false;
+        }
+        return true;
+    };
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const Node& node = m_nodes[stack.back()];
+        stack.pop_back();
+        if (!overlaps(node)) continue;
+
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                if (overlaps(m_boxes[m_items[i]])) items.push_back(m_items[i]);
+            }
+        } else {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+        }
+    }
+}
+
+uint32_t SceneBvh::raycast(simd::float3 origin, simd::float3 direction, float& distance,
+                           const std::function<float(uint32_t)>& intersect) const {
+    if (m_nodes.empty()) return kNoItem;
+
+    // Tiny components instead of zeros keep the slab products finite
+    simd::float3 inverse;
+    for (int axis = 0; axis < 3; axis++) {
+        float component = std::fabs(direction[axis]) < 1e-20f ? std::copysign(1e-20f, direction[axis]) : direction[axis];
+        inverse[axis] = 1.0f / component;
+    }
+
+    float nearest = distance;
+    uint32_t hit = kNoItem;
+
+    struct Entry {
+        uint32_t node;
+        float enter;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    float rootEnter = enter(m_nodes[0], origin, inverse, nearest);
+    if (rootEnter != INFINITY) stack.push_back({ 0, rootEnter });
+
+    while (!stack.empty()) {
+        Entry entry = stack.back();
+        stack.pop_back();
+        if (entry.enter >= nearest) continue;
+
+        const Node& node = m_nodes[entry.node];
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                const uint32_t item = m_items[i];
+                float t = intersect ? intersect(item) : enter(m_boxes[item], origin, inverse, nearest);
+                if (t < nearest) {
+                    nearest = t;
+                    hit = item;
+                }
+            }
+            continue;
+        }
+
+        // Nearer child on top so it is visited first and tightens nearest for the other
+        float t0 = enter(m_nodes[node.first], origin, inverse, nearest);
+        float t1 = enter(m_nodes[node.first + 1], origin, inverse, nearest);
+        Entry first = { node.first, t0 }, second = { node.first + 1, t1 };
+        if (t1 < t0) std::swap(first, second);
+        if (second.enter != INFINITY) stack.push_back(second);
+        if (first.enter != INFINITY) stack.push_back(first);
+    }
+
+    if (hit != kNoItem) distance = nearest;
+    return hit;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <simd/simd.h>
+
+#include "frustumCulling.hpp"
+#include "jobSystem.hpp"
+
+// Bounding volume hierarchy over world-space boxes for scene-level culling and picking.
+// Built top-down with binned SAH, large nodes are split across the job system. Moving
+// items only refits the paths above them, tree rotations on the way up keep the quality
+// from drifting, and the tree is rebuilt once its SAH cost has grown too far anyway.
+class SceneBvh {
+public:
+    static constexpr uint32_t kNoItem = 0xFFFFFFFF;
+
+    // Drops the tree, every item has to be set again before build
+    void resize(size_t itemCount);
+    size_t size() const { return m_boxes.size(); }
+
+    // Once built, changes reach the tree on the next refit
+    void setItem(uint32_t item, simd::float3 min, simd::float3 max);
+
+    void build();
+    // Refits the paths above changed items, rebuilds instead when quality degraded too far
+    void refit();
+
+    // Items whose boxes touch the frustum, in no particular order
+    void queryFrustum(const culling::Frustum& frustum, std::vector<uint32_t>& items) const;
+    // Items whose boxes overlap [min, max]
+    void queryBox(simd::float3 min, simd::float3 max, std::vector<uint32_t>& items) const;
+    // Nearest item along the ray within distance, kNoItem on a miss. intersect returns the hit
+    // distance against the item itself, or INFINITY; without it the item's box is the hit.
+    uint32_t raycast(simd::float3 origin, simd::float3 direction, float& distance,
+                     const std::function<float(uint32_t)>& intersect = nullptr) const;
+
+    // Expected traversal cost relative to the root, the build's is the baseline for rebuilds
+    float cost() const;
+
+private:
+    static constexpr uint32_t kNoNode = 0xFFFFFFFF;
+
+    struct Box {
+        float min[3];
+        float max[3];
+    };
+
+    // Siblings are allocated as pairs so both are tested from adjacent memory. Leaves
+    // have count > 0 and index m_items from first, interior nodes have children first, first + 1.
+    struct Node {
+        float min[3];
+        uint32_t first;
+        float max[3];
+        uint32_t count;
+    };
+
+    std::vector<Box> m_boxes;
+    std::vector<uint32_t> m_items;
+    std::vector<uint32_t> m_itemLeaves;
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_parents;
+    std::vector<uint8_t> m_dirty;
+    bool m_built = false;
+    // Sum of node areas weighted by their cost, kept current through refits
+    float m_costSum = 0.0f;
+    float m_builtCost = 0.0f;
+
+    void buildNode(uint32_t node, uint32_t begin, uint32_t end, std::atomic<uint32_t>& nodeCount, jobs::Counter& counter);
+    void refitNode(uint32_t node);
+    void rotate(uint32_t node);
+    void swapSubtrees(uint32_t a, uint32_t b);
+    void adopt(uint32_t node);
+    float contribution(const Node& node) const;
+};
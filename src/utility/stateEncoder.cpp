@@ -0,0 +1,142 @@
+#include "stateEncoder.hpp"
+
+#include <cstring>
+
+void StateEncoder::begin(MTL::RenderCommandEncoder* encoder) {
+    m_encoder = encoder;
+    m_pipeline = nullptr;
+    m_depthStencil = nullptr;
+    for (int i = 0; i < kSlots; i++) {
+        m_vertexSlots[i].bound = false;
+        m_fragmentSlots[i].bound = false;
+        m_fragmentTextureBound[i] = false;
+    }
+    m_resident.clear();
+    m_pendingResidency.clear();
+}
+
+void StateEncoder::end() {
+    flushResidency();
+    m_encoder->endEncoding();
+    m_encoder = nullptr;
+}
+
+void StateEncoder::setRenderPipelineState(MTL::RenderPipelineState* state) {
+    m_stats.calls++;
+    if (m_pipeline == state) {
+        m_stats.redundant++;
+        return;
+    }
+    m_pipeline = state;
+    m_encoder->setRenderPipelineState(state);
+}
+
+void StateEncoder::setDepthStencilState(MTL::DepthStencilState* state) {
+    m_stats.calls++;
+    if (m_depthStencil == state) {
+        m_stats.redundant++;
+        return;
+    }
+    m_depthStencil = state;
+    m_encoder->setDepthStencilState(state);
+}
+
+bool StateEncoder::bindBuffer(BufferSlot& slot, const MTL::Buffer* buffer, NS::UInteger offset) {
+    m_stats.calls++;
+    if (slot.bound && slot.bytes.empty() && slot.buffer == buffer && slot.offset == offset) {
+        m_stats.redundant++;
+        return false;
+    }
+    slot.buffer = buffer;
+    slot.offset = offset;
+    slot.bytes.clear();
+    slot.bound = true;
+    return true;
+}
+
+bool StateEncoder::bindBytes(BufferSlot& slot, const void* data, NS::UInteger size) {
+    m_stats.calls++;
+    if (slot.bound && slot.bytes.size() == size && size > 0 && std::memcmp(slot.bytes.data(), data, size) == 0) {
+        m_stats.redundant++;
+        return false;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    slot.bytes.assign(bytes, bytes + size);
+    slot.buffer = nullptr;
+    slot.bound = size > 0;
+    return true;
+}
+
+void StateEncoder::setVertexBuffer(const MTL::Buffer* buffer, NS::UInteger offset, NS::UInteger index) {
+    if (index >= kSlots || bindBuffer(m_vertexSlots[index], buffer, offset)) m_encoder->setVertexBuffer(buffer, offset, index);
+}
+
+void StateEncoder::setFragmentBuffer(const MTL::Buffer* buffer, NS::UInteger offset, NS::UInteger index) {
+    if (index >= kSlots || bindBuffer(m_fragmentSlots[index], buffer, offset)) m_encoder->setFragmentBuffer(buffer, offset, index);
+}
+
+void StateEncoder::setVertexBytes(const void* data, NS::UInteger size, NS::UInteger index) {
+    if (index >= kSlots || bindBytes(m_vertexSlots[index], data, size)) m_encoder->setVertexBytes(data, size, index);
+}
+
+void StateEncoder::setFragmentBytes(const void* data, NS::UInteger size, NS::UInteger index) {
+    if (index >= kSlots || bindBytes(m_fragmentSlots[index], data, size)) m_encoder->setFragmentBytes(data, size, index);
+}
+
+void StateEncoder::setFragmentTexture(const MTL::Texture* texture, NS::UInteger index) {
+    m_stats.calls++;
+    if (index < kSlots) {
+        if (m_fragmentTextureBound[index] && m_fragmentTextures[index] == texture) {
+            m_stats.redundant++;
+            return;
+        }
+        m_fragmentTextures[index] = texture;
+        m_fragmentTextureBound[index] = true;
+    }
+    m_encoder->setFragmentTexture(texture, index);
+}
+
+void StateEncoder::useResources(const MTL::Resource* const resources[], NS::UInteger count, MTL::ResourceUsage usage, MTL::RenderStages stages) {
+    const uint64_t bits = (uint64_t)usage << 32 | (uint64_t)stages;
+
+    ResidencyBatch* batch = nullptr;
+    for (ResidencyBatch& pending : m_pendingResidency) {
+        if (pending.usage == usage && pending.stages == stages) batch = &pending;
+    }
+
+    for (NS::UInteger i = 0; i < count; i++) {
+        uint64_t& resident = m_resident[resources[i]];
+        if ((resident & bits) == bits) {
+            m_stats.redundantResidency++;
+            continue;
+        }
+        resident |= bits;
+
+        if (!batch) {
+            m_pendingResidency.push_back({ usage, stages, {} });
+            batch = &m_pendingResidency.back();
+        }
+        batch->resources.push_back(resources[i]);
+    }
+}
+
+void StateEncoder::flushResidency() {
+    for (const ResidencyBatch& batch : m_pendingResidency) {
+        m_encoder->useResources(batch.resources.data(), batch.resources.size(), batch.usage, batch.stages);
+        m_stats.residencyBatches++;
+    }
+    m_pendingResidency.clear();
+}
+
+void StateEncoder::drawPrimitives(MTL::PrimitiveType type, NS::UInteger start, NS::UInteger count) {
+    flushResidency();
+    m_encoder->drawPrimitives(type, start, count);
+    m_stats.draws++;
+}
+
+void StateEncoder::drawIndexedPrimitives(MTL::PrimitiveType type, NS::UInteger indexCount, MTL::IndexType indexType, const MTL::Buffer* indexBuffer,
+                                         NS::UInteger indexOffset, NS::UInteger instanceCount, NS::Integer baseVertex, NS::UInteger baseInstance) {
+    flushResidency();
+    m_encoder->drawIndexedPrimitives(type, indexCount, indexType, indexBuffer, indexOffset, instanceCount, baseVertex, baseInstance);
+    m_stats.draws++;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <Metal/Metal.hpp>
+
+// Render encoder wrapper that remembers what is bound and drops calls that would not change
+// anything: pipeline and depth state, buffers with their offsets, textures, and inline bytes
+// with identical contents. useResources calls are collected per pass, and what a pass has
+// not made resident yet goes out as one batch per usage before the next draw.
+class StateEncoder {
+public:
+    static constexpr int kSlots = 31;
+
+    struct Stats {
+        size_t calls = 0;
+        size_t redundant = 0;
+        size_t draws = 0;
+        size_t residencyBatches = 0;
+        size_t redundantResidency = 0;
+    };
+
+    // Starts tracking a new pass, nothing is assumed bound
+    void begin(MTL::RenderCommandEncoder* encoder);
+    // Flushes residency nobody drew after, then ends encoding
+    void end();
+    MTL::RenderCommandEncoder* encoder() const { return m_encoder; }
+
+    void setRenderPipelineState(MTL::RenderPipelineState* state);
+    void setDepthStencilState(MTL::DepthStencilState* state);
+    void setVertexBuffer(const MTL::Buffer* buffer, NS::UInteger offset, NS::UInteger index);
+    void setFragmentBuffer(const MTL::Buffer* buffer, NS::UInteger offset, NS::UInteger index);
+    void setVertexBytes(const void* data, NS::UInteger size, NS::UInteger index);
+    void setFragmentBytes(const void* data, NS::UInteger size, NS::UInteger index);
+    void setFragmentTexture(const MTL::Texture* texture, NS::UInteger index);
+    void useResources(const MTL::Resource* const resources[], NS::UInteger count, MTL::ResourceUsage usage, MTL::RenderStages stages);
+
+    void drawPrimitives(MTL::PrimitiveType type, NS::UInteger start, NS::UInteger count);
+    void drawIndexedPrimitives(MTL::PrimitiveType type, NS::UInteger indexCount, MTL::IndexType indexType, const MTL::Buffer* indexBuffer,
+                               NS::UInteger indexOffset, NS::UInteger instanceCount, NS::Integer baseVertex, NS::UInteger baseInstance);
+
+    // Since the last resetStats, across passes
+    const Stats& stats() const { return m_stats; }
+    void resetStats() { m_stats = Stats(); }
+
+private:
+    // A slot holds either a buffer and offset or bytes, never both
+    struct BufferSlot {
+        const MTL::Buffer* buffer = nullptr;
+        NS::UInteger offset = 0;
+        bool bound = false;
+        std::vector<uint8_t> bytes;
+    };
+
+    struct ResidencyBatch {
+        MTL::ResourceUsage usage;
+        MTL::RenderStages stages;
+        std::vector<const MTL::Resource*> resources;
+    };
+
+    MTL::RenderCommandEncoder* m_encoder = nullptr;
+    MTL::RenderPipelineState* m_pipeline = nullptr;
+    MTL::DepthStencilState* m_depthStencil = nullptr;
+    BufferSlot m_vertexSlots[kSlots];
+    BufferSlot m_fragmentSlots[kSlots];
+    const MTL::Texture* m_fragmentTextures[kSlots] = {};
+    bool m_fragmentTextureBound[kSlots] = {};
+    // Usage and stage bits each resource was made resident with in this pass
+    std::unordered_map<const MTL::Resource*, uint64_t> m_resident;
+    std::vector<ResidencyBatch> m_pendingResidency;
+    Stats m_stats;
+
+    bool bindBuffer(BufferSlot& slot, const MTL::Buffer* buffer, NS::UInteger offset);
+    bool bindBytes(BufferSlot& slot, const void* data, NS::UInteger size);
+    void flushResidency();
+};
@@ -0,0 +1,167 @@
+#include "tangentFrame.hpp"
+
+#include <cmath>
+
+namespace {
+    constexpr float kEpsilon = 1e-8f;
+
+    // Smallest |w| representable in snorm16, keeps the reflection sign from collapsing to +0
+    constexpr float kQuaternionBias = 1.0f / 32767.0f;
+
+    simd::float3 anyPerpendicular(simd::float3 n) {
+        simd::float3 axis = std::fabs(n.x) < 0.9f ? simd_make_float3(1.0f, 0.0f, 0.0f) : simd_make_float3(0.0f, 1.0f, 0.0f);
+        return simd::normalize(simd::cross(axis, n));
+    }
+
+    float cornerAngle(simd::float3 origin, simd::float3 a, simd::float3 b) {
+        simd::float3 e0 = a - origin;
+        simd::float3 e1 = b - origin;
+        float denominator = simd::length(e0) * simd::length(e1);
+        if (denominator < kEpsilon) return 0.0f;
+
+        float cosine = simd::dot(e0, e1) / denominator;
+        return std::acos(std::fmax(-1.0f, std::fmin(1.0f, cosine)));
+    }
+
+    short toSnorm16(float value) {
+        float clamped = std::fmax(-1.0f, std::fmin(1.0f, value));
+        return (short)std::lround(clamped * 32767.0f);
+    }
+}
+
+void tangentFrame::generateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+    const size_t vertexCount = vertices.size();
+    std::vector<simd::float3> tangents(vertexCount, simd_make_float3(0.0f, 0.0f, 0.0f));
+    std::vector<simd::float3> bitangents(vertexCount, simd_make_float3(0.0f, 0.0f, 0.0f));
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const unsigned int corner[3] = { indices[i], indices[i + 1], indices[i + 2] };
+        if (corner[0] >= vertexCount || corner[1] >= vertexCount || corner[2] >= vertexCount) continue;
+
+        const Vertex& v0 = vertices[corner[0]];
+        const Vertex& v1 = vertices[corner[1]];
+        const Vertex& v2 = vertices[corner[2]];
+
+        simd::float3 e1 = v1.position - v0.position;
+        simd::float3 e2 = v2.position - v0.position;
+        simd::float2 uv1 = v1.texCoords - v0.texCoords;
+        simd::float2 uv2 = v2.texCoords - v0.texCoords;
+
+        float determinant = uv1.x * uv2.y - uv2.x * uv1.y;
+        if (std::fabs(determinant) < kEpsilon) continue;
+
+        float inverse = 1.0f / determinant;
+        simd::float3 faceTangent = (e1 * uv2.y - e2 * uv1.y) * inverse;
+        simd::float3 faceBitangent = (e2 * uv1.x - e1 * uv2.x) * inverse;
+
+        for (int c = 0; c < 3; c++) {
+            const Vertex& vertex = vertices[corner[c]];
+            float weight = cornerAngle(vertex.position, vertices[corner[(c + 1) % 3]].position, vertices[corner[(c + 2) % 3]].position);
+
+            simd::float3 n = vertex.normal;
+            simd::float3 projected = faceTangent - n * simd::dot(n, faceTangent);
+            tangents[corner[c]] += projected * weight;
+            bitangents[corner[c]] += faceBitangent * weight;
+        }
+    }
+
+    for (size_t i = 0; i < vertexCount; i++) {
+        Vertex& vertex = vertices[i];
+        simd::float3 n = vertex.normal;
+        if (simd::length_squared(n) < kEpsilon) n = simd_make_float3(0.0f, 0.0f, 1.0f);
+        n = simd::normalize(n);
+
+        simd::float3 t = tangents[i] - n * simd::dot(n, tangents[i]);
+        if (simd::length_squared(t) < kEpsilon) t = anyPerpendicular(n);
+        t = simd::normalize(t);
+
+        float handedness = simd::dot(simd::cross(n, t), bitangents[i]) < 0.0f ? -1.0f : 1.0f;
+        vertex.qtangent = encodeQTangent(n, t, handedness);
+    }
+}
+
+bool tangentFrame::hasTangents(const std::vector<Vertex>& vertices) {
+    if (vertices.empty()) return false;
+
+    simd::short4 q = vertices[0].qtangent;
+    return q.x != 0 || q.y != 0 || q.z != 0 || q.w != 0;
+}
+
+simd::short4 tangentFrame::encodeQTangent(simd::float3 normal, simd::float3 tangent, float handedness) {
+    // Imported frames can be zero, NaN or have the tangent along the normal, written as
+    // !(x >= epsilon) so NaN takes the fallback too
+    simd::float3 n = normal;
+    if (!(simd::length_squared(n) >= kEpsilon)) n = simd_make_float3(0.0f, 0.0f, 1.0f);
+    n = simd::normalize(n);
+
+    simd::float3 t = tangent - n * simd::dot(n, tangent);
+    if (!(simd::length_squared(t) >= kEpsilon)) t = anyPerpendicular(n);
+    t = simd::normalize(t);
+    simd::float3 b = simd::cross(n, t);
+
+    // Rotation matrix with columns t, b, n to quaternion
+    float m00 = t.x, m11 = b.y, m22 = n.z;
+    float trace = m00 + m11 + m22;
+    float x, y, z, w;
+
+    if (trace > 0.0f) {
+        float s = std::sqrt(trace + 1.0f) * 2.0f;
+        w = 0.25f * s;
+        x = (b.z - n.y) / s;
+        y = (n.x - t.z) / s;
+        z = (t.y - b.x) / s;
+    } else if (m00 > m11 && m00 > m22) {
+        float s = std::sqrt(1.0f + m00 - m11 - m22) * 2.0f;
+        w = (b.z - n.y) / s;
+        x = 0.25f * s;
+        y = (b.x + t.y) / s;
+        z = (n.x + t.z) / s;
+    } else if (m11 > m22) {
+        float s = std::sqrt(1.0f + m11 - m00 - m22) * 2.0f;
+        w = (n.x - t.z) / s;
+        x = (b.x + t.y) / s;
+        y = 0.25f * s;
+        z = (n.y + b.z) / s;
+    } else {
+        float s = std::sqrt(1.0f + m22 - m00 - m11) * 2.0f;
+        w = (t.y - b.x) / s;
+        x = (n.x + t.z) / s;
+        y = (n.y + b.z) / s;
+        z = 0.25f * s;
+    }
+
+    float length = std::sqrt(x * x + y * y + z * z + w * w);
+    x /= length; y /= length; z /= length; w /= length;
+
+    // q and -q are the same rotation, so the sign of w is free to carry the reflection
+    if (w < 0.0f) {
+        x = -x; y = -y; z = -z; w = -w;
+    }
+    if (w < kQuaternionBias) {
+        float scale = std::sqrt(1.0f - kQuaternionBias * kQuaternionBias);
+        x *= scale; y *= scale; z *= scale;
+        w = kQuaternionBias;
+    }
+    if (handedness < 0.0f) {
+        x = -x; y = -y; z = -z; w = -w;
+    }
+
+    return simd_make_short4(toSnorm16(x), toSnorm16(y), toSnorm16(z), toSnorm16(w));
+}
+
+void tangentFrame::decodeQTangent(simd::short4 qtangent, simd::float3& normal, simd::float3& tangent, simd::float3& bitangent) {
+    simd::float4 q = simd_make_float4(qtangent.x, qtangent.y, qtangent.z, qtangent.w) / 32767.0f;
+    q = q / std::sqrt(simd::dot(q, q));
+
+    tangent = simd_make_float3(1.0f - 2.0f * (q.y * q.y + q.z * q.z),
+                               2.0f * (q.x * q.y + q.w * q.z),
+                               2.0f * (q.x * q.z - q.w * q.y));
+    bitangent = simd_make_float3(2.0f * (q.x * q.y - q.w * q.z),
+                                 1.0f - 2.0f * (q.x * q.x + q.z * q.z),
+                                 2.0f * (q.y * q.z + q.w * q.x));
+    normal = simd_make_float3(2.0f * (q.x * q.z + q.w * q.y),
+                              2.0f * (q.y * q.z - q.w * q.x),
+                              1.0f - 2.0f * (q.x * q.x + q.y * q.y));
+
+    if (q.w < 0.0f) bitangent = -bitangent;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <simd/simd.h>
+#include <vector>
+
+#include "vertex.hpp"
+
+// Tangent frames are stored per vertex as a QTangent: a snorm16 quaternion whose
+// rotation maps (1,0,0), (0,1,0), (0,0,1) to tangent, bitangent and normal. The
+// sign of w carries the bitangent reflection. decodeQTangent mirrors the decode in
+// modelShader.metal and is the reference for it.
+namespace tangentFrame {
+    // Angle weighted per-corner tangents with MikkTSpace conventions: tangents are
+    // projected onto the vertex normal before accumulation and the bitangent is
+    // reconstructed as sign * cross(normal, tangent).
+    void generateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+
+    // A valid QTangent is never all zero, so a zeroed first vertex means no frames yet
+    bool hasTangents(const std::vector<Vertex>& vertices);
+
+    simd::short4 encodeQTangent(simd::float3 normal, simd::float3 tangent, float handedness);
+    void decodeQTangent(simd::short4 qtangent, simd::float3& normal, simd::float3& tangent, simd::float3& bitangent);
+}
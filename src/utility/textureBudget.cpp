@@ -0,0 +1,199 @@
+#include "textureBudget.hpp"
+#include "jobSystem.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <queue>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TEXTURE_BUDGET_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define TEXTURE_BUDGET_SSE2 1
+#endif
+
+namespace {
+    constexpr int kMinDimension = 32;
+
+    std::atomic<size_t> budgetBytes{ size_t(1) << 30 };
+    std::atomic<size_t> committedBytes{ 0 };
+
+    float roleWeight(const std::string& role) {
+        if (role == "diffuse") return 1.0f;
+        if (role == "normal") return 0.75f;
+        return 0.5f;
+    }
+
+    size_t bytesAt(const texturePacker::Image& image, int halvings) {
+        size_t width = std::max(1, image.width >> halvings);
+        size_t height = std::max(1, image.height >> halvings);
+        return width * height * image.channels;
+    }
+
+    bool canHalve(const texturePacker::Image& image, int halvings) {
+        return std::min(image.width, image.height) >> (halvings + 1) >= kMinDimension;
+    }
+
+    // Rounding averages of the two rows, then of neighbouring texels
+    void halveRow(const unsigned char* row0, const unsigned char* row1, unsigned char* destination, int outputWidth, int channels) {
+        int x = 0;
+#if defined(TEXTURE_BUDGET_NEON)
+        if (channels == 4) {
+            for (; x + 4 <= outputWidth; x += 4) {
+                uint32x4x2_t top = vld2q_u32(reinterpret_cast<const uint32_t*>(row0 + x * 8));
+                uint32x4x2_t bottom = vld2q_u32(reinterpret_cast<const uint32_t*>(row1 + x * 8));
+                uint8x16_t left = vrhaddq_u8(vreinterpretq_u8_u32(top.val[0]), vreinterpretq_u8_u32(bottom.val[0]));
+                uint8x16_t right = vrhaddq_u8(vreinterpretq_u8_u32(top.val[1]), vreinterpretq_u8_u32(bottom.val[1]));
+                vst1q_u8(destination + x * 4, vrhaddq_u8(left, right));
+            }
+        } else if (channels == 1) {
+            for (; x + 16 <= outputWidth; x += 16) {
+                uint8x16x2_t top = vld2q_u8(row0 + x * 2);
+                uint8x16x2_t bottom = vld2q_u8(row1 + x * 2);
+                uint8x16_t left = vrhaddq_u8(top.val[0], bottom.val[0]);
+                uint8x16_t right = vrhaddq_u8(top.val[1], bottom.val[1]);
+                vst1q_u8(destination + x, vrhaddq_u8(left, right));
+            }
+        }
+#elif defined(TEXTURE_BUDGET_SSE2)
+        if (channels == 4) {
+            for (; x + 4 <= outputWidth; x += 4) {
+                __m128i a = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8)),
+                                         _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8)));
+                __m128i b = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 16)),
+                                         _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 16)));
+                __m128 evens = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0));
+                __m128 odds = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x * 4),
+                                 _mm_avg_epu8(_mm_castps_si128(evens), _mm_castps_si128(odds)));
+            }
+        } else if (channels == 1) {
+            const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+            for (; x + 16 <= outputWidth; x += 16) {
+                __m128i a = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 2)),
+                                         _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 2)));
+                __m128i b = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 2 + 16)),
+                                         _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 2 + 16)));
+                __m128i first = _mm_avg_epu16(_mm_and_si128(a, lowBytes), _mm_srli_epi16(a, 8));
+                __m128i second = _mm_avg_epu16(_mm_and_si128(b, lowBytes), _mm_srli_epi16(b, 8));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x), _mm_packus_epi16(first, second));
+            }
+        }
+#endif
+        for (; x < outputWidth; x++) {
+            for (int c = 0; c < channels; c++) {
+                int left = (row0[x * 2 * channels + c] + row1[x * 2 * channels + c] + 1) >> 1;
+                int right = (row0[(x * 2 + 1) * channels + c] + row1[(x * 2 + 1) * channels + c] + 1) >> 1;
+                destination[x * channels + c] = (unsigned char)((left + right + 1) >> 1);
+            }
+        }
+    }
+
+    void halve(texturePacker::Image& image) {
+        const int width = std::max(1, image.width / 2);
+        const int height = std::max(1, image.height / 2);
+        const size_t sourceStride = (size_t)image.width * image.channels;
+        // A one texel wide or tall image averages with itself along that axis
+        const size_t columnStep = image.width > 1 ? 1 : 0;
+
+        std::vector<unsigned char> pixels((size_t)width * height * image.channels);
+        for (int y = 0; y < height; y++) {
+            const unsigned char* row0 = image.pixels.data() + (size_t)(y * 2) * sourceStride;
+            const unsigned char* row1 = image.height > 1 ? row0 + sourceStride : row0;
+            unsigned char* destination = pixels.data() + (size_t)y * width * image.channels;
+
+            if (columnStep) {
+                halveRow(row0, row1, destination, width, image.channels);
+            } else {
+                for (int c = 0; c < image.channels; c++) destination[c] = (unsigned char)((row0[c] + row1[c] + 1) >> 1);
+            }
+        }
+
+        image.pixels = std::move(pixels);
+        image.width = width;
+        image.height = height;
+    }
+}
+
+void textureBudget::setBudget(size_t bytes) {
+    budgetBytes = bytes;
+}
+
+size_t textureBudget::budget() {
+    return budgetBytes;
+}
+
+size_t textureBudget::committed() {
+    return committedBytes;
+}
+
+void textureBudget::commit(size_t bytes) {
+    committedBytes += bytes;
+}
+
+size_t textureBudget::imageBytes(const texturePacker::Image& image) {
+    return bytesAt(image, 0);
+}
+
+std::vector<int> textureBudget::plan(const std::vector<texturePacker::Image>& images, const std::vector<Usage>& usage) {
+    std::vector<int> halvings(images.size(), 0);
+
+    size_t used = committed();
+    size_t available = budget() > used ? budget() - used : 0;
+
+    size_t total = 0;
+    float maxRelevance = 0.0f;
+    for (size_t i = 0; i < images.size(); i++) {
+        total += bytesAt(images[i], 0);
+        maxRelevance = std::max(maxRelevance, usage[i].relevance);
+    }
+    if (total <= available) return halvings;
+
+    // Always halve whatever costs the most memory per unit of importance
+    std::vector<float> weights(images.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        float relevance = maxRelevance > 0.0f ? usage[i].relevance / maxRelevance : 1.0f;
+        weights[i] = roleWeight(usage[i].role) * std::clamp(relevance, 0.05f, 1.0f);
+    }
+
+    using Candidate = std::pair<float, size_t>;
+    std::priority_queue<Candidate> candidates;
+    for (size_t i = 0; i < images.size(); i++) {
+        if (canHalve(images[i], 0)) candidates.push({ bytesAt(images[i], 0) / weights[i], i });
+    }
+
+    while (total > available && !candidates.empty()) {
+        size_t index = candidates.top().second;
+        candidates.pop();
+
+        total -= bytesAt(images[index], halvings[index]) - bytesAt(images[index], halvings[index] + 1);
+        halvings[index]++;
+        if (canHalve(images[index], halvings[index])) {
+            candidates.push({ bytesAt(images[index], halvings[index]) / weights[index], index });
+        }
+    }
+
+    return halvings;
+}
+
+void textureBudget::downscale(texturePacker::Image& image, int halvings) {
+    for (int i = 0; i < halvings && (image.width > 1 || image.height > 1); i++) {
+        halve(image);
+    }
+}
+
+void textureBudget::fit(std::vector<texturePacker::Image>& images, const std::vector<Usage>& usage) {
+    if (images.empty()) return;
+
+    std::vector<int> halvings = plan(images, usage);
+    jobs::parallelFor(images.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (halvings[i] > 0) downscale(images[i], halvings[i]);
+        }
+    });
+
+    size_t after = 0;
+    for (const texturePacker::Image& image : images) after += imageBytes(image);
+    commit(after);
+}
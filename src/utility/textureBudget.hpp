@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "texturePacker.hpp"
+
+// Process-wide texture memory budget applied while importing. Every texture uploaded
+// through the importers is charged against it; when a batch of decoded images would
+// overrun what is left, the ones that matter least get halved until it fits.
+namespace textureBudget {
+    // How much an image matters. role is the material slot ("diffuse", "normal",
+    // "specular"), relevance a relative estimate of how much screen it covers.
+    struct Usage {
+        std::string role = "diffuse";
+        float relevance = 1.0f;
+    };
+
+    void setBudget(size_t bytes);
+    size_t budget();
+    size_t committed();
+
+    // Charges memory that didn't go through fit, e.g. cooked textures
+    void commit(size_t bytes);
+
+    // Number of 2x2 halvings per image so the batch fits the remaining budget. Images are
+    // never reduced below 32 texels on their short side.
+    std::vector<int> plan(const std::vector<texturePacker::Image>& images, const std::vector<Usage>& usage);
+
+    // 2x2 box filter per halving, SSE2 or NEON where available
+    void downscale(texturePacker::Image& image, int halvings);
+
+    // plan + downscale + commit, the totals show up through committed()
+    void fit(std::vector<texturePacker::Image>& images, const std::vector<Usage>& usage);
+
+    size_t imageBytes(const texturePacker::Image& image);
+}
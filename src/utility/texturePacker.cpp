@@ -0,0 +1,230 @@
+#include "texturePacker.hpp"
+
+#include <algorithm>
+#include <map>
+
+namespace {
+    struct SkylineNode {
+        int x;
+        int y;
+        int width;
+    };
+
+    class Skyline {
+    public:
+        Skyline(int width, int height) : m_width(width), m_height(height), m_nodes({ { 0, 0, width } }) {}
+
+        bool insert(int width, int height, int& x, int& y) {
+            int bestIndex = -1;
+            int bestTop = m_height + 1;
+            int bestWidth = m_width + 1;
+
+            for (int i = 0; i < (int)m_nodes.size(); i++) {
+                int top;
+                if (!fits(i, width, height, top)) continue;
+                if (top + height < bestTop || (top + height == bestTop && m_nodes[i].width < bestWidth)) {
+                    bestIndex = i;
+                    bestTop = top + height;
+                    bestWidth = m_nodes[i].width;
+                }
+            }
+            if (bestIndex < 0) return false;
+
+            x = m_nodes[bestIndex].x;
+            y = bestTop - height;
+            place(bestIndex, x, bestTop, width);
+            m_usedWidth = std::max(m_usedWidth, x + width);
+            m_usedHeight = std::max(m_usedHeight, bestTop);
+            return true;
+        }
+
+        int usedWidth() const { return m_usedWidth; }
+        int usedHeight() const { return m_usedHeight; }
+
+    private:
+        int m_width;
+        int m_height;
+        int m_usedWidth = 0;
+        int m_usedHeight = 0;
+        std::vector<SkylineNode> m_nodes;
+
+        // The rect rests on the highest node it spans starting at node index
+        bool fits(int index, int width, int height, int& top) const {
+            if (m_nodes[index].x + width > m_width) return false;
+
+            top = 0;
+            int remaining = width;
+            for (int i = index; remaining > 0; i++) {
+                top = std::max(top, m_nodes[i].y);
+                if (top + height > m_height) return false;
+                remaining -= m_nodes[i].width;
+            }
+            return true;
+        }
+
+        void place(int index, int x, int top, int width) {
+            m_nodes.insert(m_nodes.begin() + index, { x, top, width });
+
+            for (size_t i = index + 1; i < m_nodes.size(); i++) {
+                const SkylineNode& previous = m_nodes[i - 1];
+                int overlap = previous.x + previous.width - m_nodes[i].x;
+                if (overlap <= 0) break;
+
+                m_nodes[i].x += overlap;
+                m_nodes[i].width -= overlap;
+                if (m_nodes[i].width > 0) break;
+                m_nodes.erase(m_nodes.begin() + i);
+                i--;
+            }
+
+            for (size_t i = 0; i + 1 < m_nodes.size();) {
+                if (m_nodes[i].y == m_nodes[i + 1].y) {
+                    m_nodes[i].width += m_nodes[i + 1].width;
+                    m_nodes.erase(m_nodes.begin() + i + 1);
+                } else {
+                    i++;
+                }
+            }
+        }
+    };
+
+    struct Rect {
+        size_t image;
+        int x;
+        int y;
+    };
+
+    int alignUp(int value, int alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    int wrap(int value, int size) {
+        return ((value % size) + size) % size;
+    }
+
+    // A gutter of g texels still separates neighbours after as many halvings as g has factors of two
+    int levelCountFor(int gutter) {
+        int levels = 1;
+        while (gutter > 0 && gutter % 2 == 0) {
+            gutter /= 2;
+            levels++;
+        }
+        return levels;
+    }
+
+    void buildLevels(texturePacker::Page& page, int levelCount) {
+        const int channels = page.channels;
+        int width = page.width;
+        int height = page.height;
+
+        for (int level = 1; level < levelCount && width > 1 && height > 1; level++) {
+            const std::vector<unsigned char>& source = page.levels.back();
+            int nextWidth = width / 2;
+            int nextHeight = height / 2;
+            std::vector<unsigned char> next((size_t)nextWidth * nextHeight * channels);
+
+            for (int y = 0; y < nextHeight; y++) {
+                const unsigned char* row0 = source.data() + (size_t)(y * 2) * width * channels;
+                const unsigned char* row1 = row0 + (size_t)width * channels;
+                unsigned char* destination = next.data() + (size_t)y * nextWidth * channels;
+
+                for (int x = 0; x < nextWidth * channels; x++) {
+                    int column = (x / channels) * 2 * channels + x % channels;
+                    destination[x] = (unsigned char)((row0[column] + row0[column + channels] + row1[column] + row1[column + channels] + 2) / 4);
+                }
+            }
+
+            page.levels.push_back(std::move(next));
+            width = nextWidth;
+            height = nextHeight;
+        }
+    }
+
+    void fillPage(texturePacker::Page& page, const std::vector<const texturePacker::Image*>& images, const std::vector<Rect>& rects,
+                  int gutter, int alignment) {
+        const int channels = page.channels;
+        std::vector<unsigned char> pixels((size_t)page.width * page.height * channels, 0);
+
+        for (const Rect& rect : rects) {
+            const texturePacker::Image& image = *images[rect.image];
+            int paddedWidth = alignUp(image.width + gutter * 2, alignment);
+            int paddedHeight = alignUp(image.height + gutter * 2, alignment);
+
+            for (int y = 0; y < paddedHeight; y++) {
+                int sourceY = wrap(y - gutter, image.height);
+                unsigned char* destination = pixels.data() + ((size_t)(rect.y + y) * page.width + rect.x) * channels;
+                const unsigned char* sourceRow = image.pixels.data() + (size_t)sourceY * image.width * channels;
+
+                for (int x = 0; x < paddedWidth; x++) {
+                    int sourceX = wrap(x - gutter, image.width);
+                    std::copy_n(sourceRow + (size_t)sourceX * channels, channels, destination + (size_t)x * channels);
+                }
+            }
+        }
+
+        page.levels.push_back(std::move(pixels));
+    }
+}
+
+bool texturePacker::isPackable(const Image& image, const Options& options) {
+    if (image.width <= 0 || image.height <= 0) return false;
+    if (image.pixels.size() < (size_t)image.width * image.height * image.channels) return false;
+    return image.width <= options.maxPackedSize && image.height <= options.maxPackedSize;
+}
+
+void texturePacker::pack(const std::vector<const Image*>& images, std::vector<Page>& pages, std::vector<Placement>& placements,
+                         const Options& options) {
+    placements.assign(images.size(), Placement());
+
+    const int gutter = std::max(0, options.gutter);
+    const int levelCount = levelCountFor(gutter);
+    const int alignment = 1 << (levelCount - 1);
+
+    std::map<int, std::vector<size_t>> groups;
+    for (size_t i = 0; i < images.size(); i++) {
+        if (isPackable(*images[i], options)) groups[images[i]->channels].push_back(i);
+    }
+
+    for (auto& [channels, pending] : groups) {
+        std::sort(pending.begin(), pending.end(), [&images](size_t a, size_t b) {
+            if (images[a]->height != images[b]->height) return images[a]->height > images[b]->height;
+            return images[a]->width > images[b]->width;
+        });
+
+        while (!pending.empty()) {
+            Skyline skyline(options.pageSize, options.pageSize);
+            std::vector<Rect> rects;
+            std::vector<size_t> leftover;
+
+            for (size_t index : pending) {
+                const Image& image = *images[index];
+                int x, y;
+                if (skyline.insert(alignUp(image.width + gutter * 2, alignment), alignUp(image.height + gutter * 2, alignment), x, y)) {
+                    rects.push_back({ index, x, y });
+                } else {
+                    leftover.push_back(index);
+                }
+            }
+            // Nothing fits an empty page, those images stay standalone
+            if (rects.empty()) break;
+
+            Page page;
+            page.width = skyline.usedWidth();
+            page.height = skyline.usedHeight();
+            page.channels = channels;
+            fillPage(page, images, rects, gutter, alignment);
+            buildLevels(page, levelCount);
+
+            for (const Rect& rect : rects) {
+                const Image& image = *images[rect.image];
+                Placement& placement = placements[rect.image];
+                placement.page = (int)pages.size();
+                placement.uvTransform = simd_make_float4((float)image.width / page.width, (float)image.height / page.height,
+                                                         (float)(rect.x + gutter) / page.width, (float)(rect.y + gutter) / page.height);
+            }
+
+            pages.push_back(std::move(page));
+            pending = std::move(leftover);
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <simd/simd.h>
+
+// Import-time packing of small textures into shared atlas pages. Placements are
+// skyline packed, bottom-left first, with every rect aligned to the gutter size.
+// Gutters are filled with the texture's own wrapped texels, so repeat addressing
+// and bilinear filtering stay correct across the seams. Mips are built for as many
+// levels as the gutter survives.
+namespace texturePacker {
+    struct Image {
+        std::vector<unsigned char> pixels;
+        int width = 0;
+        int height = 0;
+        int channels = 4;
+    };
+
+    struct Page {
+        int width = 0;
+        int height = 0;
+        int channels = 4;
+        // Level 0 first, each tightly packed
+        std::vector<std::vector<unsigned char>> levels;
+    };
+
+    // uvTransform maps fract(uv) into the page, xy is the scale and zw the offset.
+    // Matches SingleTexture::uvTransform in modelShader.metal.
+    struct Placement {
+        int page = -1;
+        simd::float4 uvTransform;
+    };
+
+    struct Options {
+        int maxPackedSize = 256;
+        int pageSize = 2048;
+        int gutter = 8;
+    };
+
+    bool isPackable(const Image& image, const Options& options = Options());
+
+    // Images of different channel counts never share a page. Placements line up with images.
+    void pack(const std::vector<const Image*>& images, std::vector<Page>& pages, std::vector<Placement>& placements,
+              const Options& options = Options());
+}
@@ -0,0 +1,173 @@
+#include "transformHierarchy.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    simd::float4 gather(const std::vector<float>& channel, const uint32_t (&nodes)[4]) {
+        return simd_make_float4(channel[nodes[0]], channel[nodes[1]], channel[nodes[2]], channel[nodes[3]]);
+    }
+}
+
+uint32_t TransformHierarchy::append(uint32_t parent, simd::float3 translation, simd::quatf rotation, simd::float3 scale) {
+    const uint32_t node = (uint32_t)m_parents.size();
+
+    if (parent != kNoParent && (parent >= node || m_subtreeEnds[parent] != node)) {
+        std::cout << "Error::TransformHierarchy::Node " << node << " appended out of depth-first order, attaching it to the root" << std::endl;
+        parent = kNoParent;
+    }
+
+    m_translations.x.push_back(translation.x);
+    m_translations.y.push_back(translation.y);
+    m_translations.z.push_back(translation.z);
+    m_rotations.x.push_back(rotation.vector.x);
+    m_rotations.y.push_back(rotation.vector.y);
+    m_rotations.z.push_back(rotation.vector.z);
+    m_rotations.w.push_back(rotation.vector.w);
+    m_scales.x.push_back(scale.x);
+    m_scales.y.push_back(scale.y);
+    m_scales.z.push_back(scale.z);
+
+    m_residualOf.push_back(kNoResidual);
+    m_locals.push_back(matrix_identity_float4x4);
+    m_worlds.push_back(matrix_identity_float4x4);
+    m_parents.push_back(parent);
+    m_subtreeEnds.push_back(node + 1);
+    m_dirty.push_back(0);
+    m_updateStamps.push_back(0);
+
+    for (uint32_t ancestor = parent; ancestor != kNoParent; ancestor = m_parents[ancestor]) {
+        m_subtreeEnds[ancestor] = node + 1;
+    }
+
+    markDirty(node);
+    return node;
+}
+
+void TransformHierarchy::clear() {
+    *this = TransformHierarchy();
+}
+
+void TransformHierarchy::setTranslation(uint32_t node, simd::float3 translation) {
+    m_translations.x[node] = translation.x;
+    m_translations.y[node] = translation.y;
+    m_translations.z[node] = translation.z;
+    markDirty(node);
+}
+
+void TransformHierarchy::setRotation(uint32_t node, simd::quatf rotation) {
+    m_rotations.x[node] = rotation.vector.x;
+    m_rotations.y[node] = rotation.vector.y;
+    m_rotations.z[node] = rotation.vector.z;
+    m_rotations.w[node] = rotation.vector.w;
+    markDirty(node);
+}
+
+void TransformHierarchy::setScale(uint32_t node, simd::float3 scale) {
+    m_scales.x[node] = scale.x;
+    m_scales.y[node] = scale.y;
+    m_scales.z[node] = scale.z;
+    markDirty(node);
+}
+
+void TransformHierarchy::setResidual(uint32_t node, const simd::float4x4& residual) {
+    if (m_residualOf[node] == kNoResidual) {
+        m_residualOf[node] = (uint32_t)m_residuals.size();
+        m_residuals.push_back(residual);
+    } else {
+        m_residuals[m_residualOf[node]] = residual;
+    }
+    markDirty(node);
+}
+
+simd::float3 TransformHierarchy::translation(uint32_t node) const {
+    return simd_make_float3(m_translations.x[node], m_translations.y[node], m_translations.z[node]);
+}
+
+simd::quatf TransformHierarchy::rotation(uint32_t node) const {
+    return simd_quaternion(m_rotations.x[node], m_rotations.y[node], m_rotations.z[node], m_rotations.w[node]);
+}
+
+simd::float3 TransformHierarchy::scale(uint32_t node) const {
+    return simd_make_float3(m_scales.x[node], m_scales.y[node], m_scales.z[node]);
+}
+
+void TransformHierarchy::markDirty(uint32_t node) {
+    if (m_dirty[node]) return;
+    m_dirty[node] = 1;
+    m_dirtyNodes.push_back(node);
+}
+
+// Builds scale, then rotation, then translation for four nodes per step, one matrix
+// element per vector lane
+void TransformHierarchy::composeLocals(const uint32_t* nodes, size_t count) {
+    for (size_t i = 0; i < count; i += 4) {
+        const size_t lanes = std::min<size_t>(4, count - i);
+        uint32_t batch[4];
+        for (size_t lane = 0; lane < 4; lane++) batch[lane] = nodes[i + std::min(lane, lanes - 1)];
+
+        simd::float4 qx = gather(m_rotations.x, batch);
+        simd::float4 qy = gather(m_rotations.y, batch);
+        simd::float4 qz = gather(m_rotations.z, batch);
+        simd::float4 qw = gather(m_rotations.w, batch);
+
+        simd::float4 xx = qx * qx, yy = qy * qy, zz = qz * qz;
+        simd::float4 xy = qx * qy, xz = qx * qz, yz = qy * qz;
+        simd::float4 wx = qw * qx, wy = qw * qy, wz = qw * qz;
+
+        simd::float4 sx = gather(m_scales.x, batch);
+        simd::float4 sy = gather(m_scales.y, batch);
+        simd::float4 sz = gather(m_scales.z, batch);
+
+        simd::float4 c0x = (1.0f - 2.0f * (yy + zz)) * sx;
+        simd::float4 c0y = 2.0f * (xy + wz) * sx;
+        simd::float4 c0z = 2.0f * (xz - wy) * sx;
+        simd::float4 c1x = 2.0f * (xy - wz) * sy;
+        simd::float4 c1y = (1.0f - 2.0f * (xx + zz)) * sy;
+        simd::float4 c1z = 2.0f * (yz + wx) * sy;
+        simd::float4 c2x = 2.0f * (xz + wy) * sz;
+        simd::float4 c2y = 2.0f * (yz - wx) * sz;
+        simd::float4 c2z = (1.0f - 2.0f * (xx + yy)) * sz;
+
+        simd::float4 tx = gather(m_translations.x, batch);
+        simd::float4 ty = gather(m_translations.y, batch);
+        simd::float4 tz = gather(m_translations.z, batch);
+
+        for (size_t lane = 0; lane < lanes; lane++) {
+            m_locals[batch[lane]] = simd_matrix(simd_make_float4(c0x[lane], c0y[lane], c0z[lane], 0.0f),
+                                                simd_make_float4(c1x[lane], c1y[lane], c1z[lane], 0.0f),
+                                                simd_make_float4(c2x[lane], c2y[lane], c2z[lane], 0.0f),
+                                                simd_make_float4(tx[lane], ty[lane], tz[lane], 1.0f));
+            if (m_residualOf[batch[lane]] != kNoResidual) {
+                m_locals[batch[lane]] = simd_mul(m_locals[batch[lane]], m_residuals[m_residualOf[batch[lane]]]);
+            }
+        }
+    }
+}
+
+size_t TransformHierarchy::update() {
+    if (m_dirtyNodes.empty()) return 0;
+
+    std::sort(m_dirtyNodes.begin(), m_dirtyNodes.end());
+    composeLocals(m_dirtyNodes.data(), m_dirtyNodes.size());
+    m_updateCount++;
+
+    // Sorted roots either start a new subtree or fall inside the one just rebuilt
+    size_t updated = 0;
+    uint32_t rebuiltEnd = 0;
+    for (uint32_t root : m_dirtyNodes) {
+        m_dirty[root] = 0;
+        if (root < rebuiltEnd) continue;
+
+        rebuiltEnd = m_subtreeEnds[root];
+        for (uint32_t node = root; node < rebuiltEnd; node++) {
+            uint32_t parent = m_parents[node];
+            m_worlds[node] = parent == kNoParent ? m_locals[node] : simd_mul(m_worlds[parent], m_locals[node]);
+            m_updateStamps[node] = m_updateCount;
+        }
+        updated += rebuiltEnd - root;
+    }
+
+    m_dirtyNodes.clear();
+    return updated;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <simd/simd.h>
+
+// Scene graph transforms stored depth-first, so every subtree is the contiguous range
+// [node, subtreeEnd(node)) and parents always come before their children. Local TRS
+// lives in per-component arrays; setters only flag the node, and update() recomputes
+// world matrices for the flagged subtrees and nothing else.
+class TransformHierarchy {
+public:
+    static constexpr uint32_t kNoParent = UINT32_MAX;
+
+    // Nodes have to be appended depth-first: parent is kNoParent or an ancestor of
+    // (or equal to) the last appended node. Indices stay valid for the hierarchy's lifetime.
+    uint32_t append(uint32_t parent, simd::float3 translation, simd::quatf rotation, simd::float3 scale);
+    void clear();
+
+    void setTranslation(uint32_t node, simd::float3 translation);
+    void setRotation(uint32_t node, simd::quatf rotation);
+    void setScale(uint32_t node, simd::float3 scale);
+    // What TRS can't express of an imported local matrix, such as shear. It is applied
+    // first, the local matrix becomes T * R * S * residual and keeps it through TRS edits.
+    void setResidual(uint32_t node, const simd::float4x4& residual);
+
+    simd::float3 translation(uint32_t node) const;
+    simd::quatf rotation(uint32_t node) const;
+    simd::float3 scale(uint32_t node) const;
+
+    const simd::float4x4& world(uint32_t node) const { return m_worlds[node]; }
+    uint32_t parent(uint32_t node) const { return m_parents[node]; }
+    uint32_t subtreeEnd(uint32_t node) const { return m_subtreeEnds[node]; }
+    size_t size() const { return m_parents.size(); }
+
+    // Returns how many world matrices were recomputed
+    size_t update();
+    // True when node's world matrix changed in the last update()
+    bool wasUpdated(uint32_t node) const { return m_updateStamps[node] == m_updateCount; }
+
+private:
+    struct Channel3 {
+        std::vector<float> x, y, z;
+    };
+    struct Channel4 {
+        std::vector<float> x, y, z, w;
+    };
+
+    Channel3 m_translations;
+    Channel4 m_rotations;
+    Channel3 m_scales;
+    // Few nodes have a residual, m_residualOf indexes m_residuals or holds kNoResidual
+    static constexpr uint32_t kNoResidual = UINT32_MAX;
+    std::vector<uint32_t> m_residualOf;
+    std::vector<simd::float4x4> m_residuals;
+    std::vector<simd::float4x4> m_locals;
+    std::vector<simd::float4x4> m_worlds;
+    std::vector<uint32_t> m_parents;
+    std::vector<uint32_t> m_subtreeEnds;
+
+    std::vector<uint8_t> m_dirty;
+    std::vector<uint32_t> m_dirtyNodes;
+    std::vector<uint32_t> m_updateStamps;
+    uint32_t m_updateCount = 0;
+
+    void markDirty(uint32_t node);
+    void composeLocals(const uint32_t* nodes, size_t count);
+};
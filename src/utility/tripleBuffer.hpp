@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Single producer, single consumer hand-off of whole values. The producer fills
+// back() and publishes it; the consumer acquires the newest published value and
+// keeps reading front() until its next acquire. Neither side ever waits on the
+// other, the third slot is the one in flight between them.
+template <typename T>
+class TripleBuffer {
+public:
+    // Producer side
+    T& back() { return m_slots[m_back]; }
+
+    void publish() {
+        m_back = m_shared.exchange(m_back | kFresh, std::memory_order_acq_rel) & kIndexMask;
+    }
+
+    // Consumer side, returns false and keeps the current front if nothing new was published
+    bool acquire() {
+        if (!(m_shared.load(std::memory_order_relaxed) & kFresh)) return false;
+        m_front = m_shared.exchange(m_front, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+
+    const T& front() const { return m_slots[m_front]; }
+
+private:
+    static constexpr uint8_t kIndexMask = 0x3;
+    static constexpr uint8_t kFresh = 0x4;
+
+    T m_slots[3];
+    uint8_t m_back = 0;
+    uint8_t m_front = 1;
+    std::atomic<uint8_t> m_shared{ 2 };
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <simd/simd.h>
+
+// Vertex layout shared by the importers, the mesh cache and the CPU geometry passes.
+// Kept free of Metal so those passes build without a graphics backend.
+
+struct Vertex {
+    simd::float3 position;
+    simd::float3 normal;
+    simd::float2 texCoords;
+    simd::short4 qtangent;
+};
+
+// Matches InstanceData in modelShader.metal
+struct MeshInstance {
+    simd::float4x4 transform;
+    simd::float3x3 normalTransform;
+};
+
+struct TypeEndpoints {
+    int diffuse;
+    int specular;
+    int normal;
+    int height;
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <Metal/Metal.hpp>
+#include <simd/simd.h>
+
+#include "mesh.h"
+
+// Compile-time vertex formats. A format is any vertex struct with a Format<T>
+// specialization listing its attributes; converters and the MTL::VertexDescriptor
+// are generated from that table, so adding a format needs no hand-written code.
+namespace vertexFormat {
+    // The value doubles as the [[attribute(n)]] index in the shaders
+    enum class Semantic : uint32_t {
+        Position = 0,
+        Normal = 1,
+        TexCoord = 2,
+        QTangent = 3
+    };
+
+    struct Attribute {
+        Semantic semantic;
+        MTL::VertexFormat format;
+        uint32_t offset;
+    };
+
+    template <typename VertexType>
+    struct Format;
+
+    template <>
+    struct Format<Vertex> {
+        static constexpr Attribute attributes[] = {
+            { Semantic::Position, MTL::VertexFormatFloat3, offsetof(Vertex, position) },
+            { Semantic::Normal, MTL::VertexFormatFloat3, offsetof(Vertex, normal) },
+            { Semantic::TexCoord, MTL::VertexFormatFloat2, offsetof(Vertex, texCoords) },
+            { Semantic::QTangent, MTL::VertexFormatShort4Normalized, offsetof(Vertex, qtangent) }
+        };
+        static constexpr uint32_t stride = sizeof(Vertex);
+    };
+
+    template <typename VertexType>
+    constexpr int attributeIndex(Semantic semantic) {
+        constexpr size_t count = sizeof(Format<VertexType>::attributes) / sizeof(Attribute);
+        for (size_t i = 0; i < count; i++) {
+            if (Format<VertexType>::attributes[i].semantic == semantic) return (int)i;
+        }
+        return -1;
+    }
+
+    template <typename VertexType>
+    constexpr bool has(Semantic semantic) {
+        return attributeIndex<VertexType>(semantic) >= 0;
+    }
+
+    template <typename VertexType>
+    constexpr uint32_t offsetOf(Semantic semantic) {
+        return Format<VertexType>::attributes[attributeIndex<VertexType>(semantic)].offset;
+    }
+
+    constexpr uint32_t componentCount(MTL::VertexFormat format) {
+        switch (format) {
+            case MTL::VertexFormatFloat2: return 2;
+            case MTL::VertexFormatFloat3: return 3;
+            case MTL::VertexFormatFloat4:
+            case MTL::VertexFormatShort4Normalized:
+            case MTL::VertexFormatUChar4Normalized: return 4;
+            default: return 0;
+        }
+    }
+
+    template <MTL::VertexFormat Format>
+    inline void store(unsigned char* destination, simd::float4 value) {
+        if constexpr (Format == MTL::VertexFormatFloat2 || Format == MTL::VertexFormatFloat3 || Format == MTL::VertexFormatFloat4) {
+            std::memcpy(destination, &value, sizeof(float) * componentCount(Format));
+        } else if constexpr (Format == MTL::VertexFormatShort4Normalized) {
+            int16_t packed[4];
+            for (int c = 0; c < 4; c++) packed[c] = (int16_t)std::lround(std::fmax(-1.0f, std::fmin(1.0f, value[c])) * 32767.0f);
+            std::memcpy(destination, packed, sizeof(packed));
+        } else if constexpr (Format == MTL::VertexFormatUChar4Normalized) {
+            uint8_t packed[4];
+            for (int c = 0; c < 4; c++) packed[c] = (uint8_t)std::lround(std::fmax(0.0f, std::fmin(1.0f, value[c])) * 255.0f);
+            std::memcpy(destination, packed, sizeof(packed));
+        } else {
+            static_assert(Format == MTL::VertexFormatFloat2, "No store for this vertex format");
+        }
+    }
+
+    // Writes a semantic into a vertex, compiled out entirely when the format lacks it
+    template <typename VertexType, Semantic S>
+    inline void write(VertexType& vertex, simd::float4 value) {
+        constexpr int index = attributeIndex<VertexType>(S);
+        if constexpr (index >= 0) {
+            constexpr Attribute attribute = Format<VertexType>::attributes[index];
+            store<attribute.format>(reinterpret_cast<unsigned char*>(&vertex) + attribute.offset, value);
+        }
+    }
+
+    // Already quantized QTangents are copied as they are
+    template <typename VertexType>
+    inline void writeQTangent(VertexType& vertex, simd::short4 qtangent) {
+        constexpr int index = attributeIndex<VertexType>(Semantic::QTangent);
+        if constexpr (index >= 0) {
+            constexpr Attribute attribute = Format<VertexType>::attributes[index];
+            static_assert(attribute.format == MTL::VertexFormatShort4Normalized, "QTangents are stored as short4");
+            std::memcpy(reinterpret_cast<unsigned char*>(&vertex) + attribute.offset, &qtangent, sizeof(int16_t) * 4);
+        }
+    }
+
+    template <typename VertexType>
+    MTL::VertexDescriptor* makeVertexDescriptor(NS::UInteger bufferIndex) {
+        MTL::VertexDescriptor* descriptor = MTL::VertexDescriptor::alloc()->init();
+
+        for (const Attribute& attribute : Format<VertexType>::attributes) {
+            MTL::VertexAttributeDescriptor* attributeDescriptor = descriptor->attributes()->object((NS::UInteger)attribute.semantic);
+            attributeDescriptor->setFormat(attribute.format);
+            attributeDescriptor->setOffset(attribute.offset);
+            attributeDescriptor->setBufferIndex(bufferIndex);
+        }
+        descriptor->layouts()->object(bufferIndex)->setStride(Format<VertexType>::stride);
+        descriptor->layouts()->object(bufferIndex)->setStepFunction(MTL::VertexStepFunctionPerVertex);
+
+        return descriptor;
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal assertion helpers for the core tests. A failed check is reported and counted,
+// main returns checkFailures() so ctest sees the result.
+inline int& checkFailureCount() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        if (!(condition)) {                                                                \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);      \
+            checkFailureCount()++;                                                         \
+        }                                                                                  \
+    } while (0)
+
+inline int checkFailures() {
+    if (checkFailureCount() == 0) std::printf("all checks passed\n");
+    return checkFailureCount() == 0 ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+#include "utility/commandList.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include "check.hpp"
+
+namespace {
+    int vertexBuffer, instanceBuffer, indexBuffer;
+
+    void testValidDraws() {
+        gfx::CommandList list;
+        list.setVertexBuffer(&vertexBuffer, 0, 0);
+        list.setVertexBuffer(&instanceBuffer, 64, 1);
+        const float material[4] = { 1.0f, 0.5f, 0.25f, 1.0f };
+        list.setFragmentBytes(material, sizeof(material), 0);
+        list.drawIndexed(&indexBuffer, 36, 4, 0);
+        list.drawIndexed(&indexBuffer, 36, 2, 4);
+
+        CHECK(list.commandCount() == 5);
+        CHECK(list.drawCount() == 2);
+        CHECK(list.byteSize() % 8 == 0);
+
+        const gfx::ValidationResult result = gfx::validate({ list });
+        CHECK(result.errors == 0);
+        CHECK(result.commands == 5);
+        CHECK(result.draws == 2);
+        CHECK(result.vertexBufferBinds == 2);
+        CHECK(result.fragmentByteBinds == 1);
+        CHECK(result.instances == 6);
+    }
+
+    // Bindings carry over between lists, the way they would on one encoder
+    void testStateAcrossLists() {
+        std::vector<gfx::CommandList> lists(2);
+        lists[0].setVertexBuffer(&vertexBuffer, 0, 0);
+        lists[0].setVertexBuffer(&instanceBuffer, 0, 1);
+        lists[1].drawIndexed(&indexBuffer, 3, 1, 0);
+
+        const gfx::ValidationResult result = gfx::validate(lists);
+        CHECK(result.errors == 0);
+        CHECK(result.draws == 1);
+    }
+
+    void testMissingBindings() {
+        gfx::CommandList list;
+        list.setVertexBuffer(&vertexBuffer, 0, 0);
+        list.drawIndexed(&indexBuffer, 3, 1, 0);
+        list.drawIndexed(nullptr, 3, 1, 0);
+
+        const gfx::ValidationResult result = gfx::validate({ list });
+        CHECK(result.errors >= 2);
+        CHECK(!result.firstError.empty());
+    }
+
+    void testOversizedBytesRejected() {
+        gfx::CommandList list;
+        std::vector<uint8_t> data(gfx::kMaxInlineBytes + 1);
+        list.setFragmentBytes(data.data(), uint32_t(data.size()), 0);
+        CHECK(list.commandCount() == 0);
+
+        list.clear();
+        CHECK(list.byteSize() == 0);
+        CHECK(list.drawCount() == 0);
+    }
+}
+
+int main() {
+    testValidDraws();
+    testStateAcrossLists();
+    testMissingBindings();
+    testOversizedBytesRejected();
+    return checkFailures();
+}
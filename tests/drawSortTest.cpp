@@ -0,0 +1,48 @@
+#include "utility/drawSort.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+
+namespace {
+    void testFieldsRoundTrip() {
+        const uint64_t key = drawSort::makeKey(1, 2, 0xABCD, 0x1234567, 200);
+        CHECK(drawSort::material(key) == 0xABCD);
+        CHECK(drawSort::mesh(key) == 0x1234567);
+        CHECK(drawSort::batch(key) == drawSort::batch(drawSort::makeKey(1, 2, 0xABCD, 0x1234567, 3)));
+        CHECK(drawSort::batch(key) != drawSort::batch(drawSort::makeKey(1, 2, 0xABCC, 0x1234567, 200)));
+    }
+
+    // Materials past the field width wrap around, which is why batching compares full materials
+    void testWideMaterialsCollide() {
+        const uint32_t wrapped = 1u << drawSort::kMaterialBits;
+        CHECK(drawSort::material(drawSort::makeKey(0, 0, wrapped + 5, 0, 0)) == 5);
+        CHECK(drawSort::batch(drawSort::makeKey(0, 0, wrapped + 5, 7, 0)) == drawSort::batch(drawSort::makeKey(0, 0, 5, 7, 0)));
+    }
+
+    void testRadixSortIsStable() {
+        std::mt19937 random(7);
+        std::vector<drawSort::Item> items(50000);
+        for (uint32_t i = 0; i < items.size(); i++) {
+            items[i].key = drawSort::makeKey(random() % 2, 0, random() % 40, random() % 300, random() % drawSort::kDepthBuckets);
+            items[i].value = i;
+        }
+        std::vector<drawSort::Item> expected = items;
+        std::stable_sort(expected.begin(), expected.end(), [](const drawSort::Item& a, const drawSort::Item& b) { return a.key < b.key; });
+
+        std::vector<drawSort::Item> scratch;
+        drawSort::radixSort(items, scratch);
+        bool same = true;
+        for (size_t i = 0; i < items.size(); i++) same = same && items[i].key == expected[i].key && items[i].value == expected[i].value;
+        CHECK(same);
+    }
+}
+
+int main() {
+    testFieldsRoundTrip();
+    testWideMaterialsCollide();
+    testRadixSortIsStable();
+    return checkFailures();
+}
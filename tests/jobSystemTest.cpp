@@ -0,0 +1,90 @@
+#include "utility/jobSystem.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+
+namespace {
+    void testParallelForCoversRange() {
+        std::vector<std::atomic<int>> hits(100000);
+        jobs::parallelFor(hits.size(), 64, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) hits[i]++;
+        });
+
+        bool once = true;
+        for (std::atomic<int>& hit : hits) once = once && hit.load() == 1;
+        CHECK(once);
+    }
+
+    // Jobs that wait on jobs they spawn, the way the BVH build recurses
+    void testNestedWaits() {
+        std::atomic<int> leaves{ 0 };
+        jobs::Counter outer;
+        for (int i = 0; i < 16; i++) {
+            jobs::run([&leaves]() {
+                jobs::parallelFor(1000, 10, [&leaves](size_t begin, size_t end) { leaves += int(end - begin); });
+            }, &outer);
+        }
+        jobs::wait(outer);
+        CHECK(leaves.load() == 16 * 1000);
+    }
+
+    // A waiter must not pick up a queued job of another counter, a long import would
+    // otherwise run inline inside a frame's parallelFor
+    void testWaitOnlyRunsOwnJobs() {
+        std::atomic<bool> blocking{ false };
+        std::atomic<bool> release{ false };
+        jobs::Counter blocker;
+        for (unsigned int i = 0; i < jobs::workerCount(); i++) {
+            jobs::run([&]() {
+                blocking = true;
+                while (!release.load()) std::this_thread::yield();
+            }, &blocker);
+        }
+        while (!blocking.load()) std::this_thread::yield();
+
+        const std::thread::id caller = std::this_thread::get_id();
+        std::atomic<bool> unrelatedOnCaller{ false };
+        jobs::Counter unrelated;
+        jobs::run([&]() { unrelatedOnCaller = std::this_thread::get_id() == caller; }, &unrelated);
+
+        std::atomic<size_t> covered{ 0 };
+        jobs::parallelFor(4096, 16, [&](size_t begin, size_t end) { covered += end - begin; });
+        CHECK(covered.load() == 4096);
+        CHECK(!unrelated.done());
+
+        release = true;
+        jobs::wait(blocker);
+        jobs::wait(unrelated);
+        CHECK(!unrelatedOnCaller.load());
+    }
+
+    void testRunAfter() {
+        std::atomic<int> order{ 0 };
+        std::atomic<bool> go{ false };
+        int first = -1, second = -1;
+        jobs::Counter dependency, dependent;
+        jobs::run([&]() {
+            while (!go.load()) std::this_thread::yield();
+            first = order++;
+        }, &dependency);
+        jobs::runAfter(dependency, [&]() { second = order++; }, &dependent);
+        go = true;
+        jobs::wait(dependency);
+        jobs::wait(dependent);
+        CHECK(first == 0);
+        CHECK(second == 1);
+    }
+}
+
+int main() {
+    // Two workers and the caller, whatever the machine has
+    jobs::initialize(3);
+    testParallelForCoversRange();
+    testNestedWaits();
+    testWaitOnlyRunsOwnJobs();
+    testRunAfter();
+    return checkFailures();
+}
@@ -0,0 +1,75 @@
+#include "utility/lightClusters.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "check.hpp"
+
+namespace {
+    constexpr float kNear = 0.1f;
+    constexpr float kFar = 100.0f;
+
+    simd::float4x4 perspective(float fovY, float aspect) {
+        const float f = 1.0f / std::tan(fovY * 0.5f);
+        return simd_matrix(simd_make_float4(f / aspect, 0.0f, 0.0f, 0.0f),
+                           simd_make_float4(0.0f, f, 0.0f, 0.0f),
+                           simd_make_float4(0.0f, 0.0f, (kFar + kNear) / (kNear - kFar), -1.0f),
+                           simd_make_float4(0.0f, 0.0f, 2.0f * kFar * kNear / (kNear - kFar), 0.0f));
+    }
+
+    std::vector<uint32_t> lightsIn(const LightClusters& clusters, uint32_t cluster) {
+        const LightClusters::Cluster& range = clusters.clusters()[cluster];
+        std::vector<uint32_t> lights(clusters.indices().begin() + range.offset, clusters.indices().begin() + range.offset + range.count);
+        std::sort(lights.begin(), lights.end());
+        return lights;
+    }
+
+    // With a 90 degree field of view and 16:9, ndc x is view x * 0.5625 / depth
+    void testLightsLandInTheirClusters() {
+        LightClusters clusters;
+        CHECK(clusters.setProjection(perspective(float(M_PI) * 0.5f, 16.0f / 9.0f), kNear, kFar));
+        CHECK(!clusters.setProjection(perspective(float(M_PI) * 0.5f, 16.0f / 9.0f), kNear, kFar));
+
+        const LightClusters::Light lights[] = {
+            { simd_make_float3(0.0f, 0.0f, -10.0f), 1.0f },
+            { simd_make_float3(5.0f, 0.0f, -10.0f), 0.5f },
+            // Behind the camera, and one without range
+            { simd_make_float3(0.0f, 0.0f, 10.0f), 2.0f },
+            { simd_make_float3(0.0f, 0.0f, -10.0f), 0.0f },
+        };
+        clusters.assign(matrix_identity_float4x4, lights, 4);
+        CHECK(clusters.clusters().size() == LightClusters::kClusterCount);
+        CHECK(clusters.droppedLights() == 0);
+
+        CHECK(lightsIn(clusters, clusters.clusterAt(0.0f, 0.0f, 10.0f)) == std::vector<uint32_t>{ 0 });
+        CHECK(lightsIn(clusters, clusters.clusterAt(5.0f * 0.5625f / 10.0f, 0.0f, 10.0f)) == std::vector<uint32_t>{ 1 });
+        CHECK(lightsIn(clusters, clusters.clusterAt(0.0f, 0.0f, 30.0f)).empty());
+        CHECK(lightsIn(clusters, clusters.clusterAt(-0.9f, 0.9f, 10.0f)).empty());
+        CHECK(lightsIn(clusters, clusters.clusterAt(0.0f, 0.0f, 1.0f)).empty());
+
+        const std::vector<uint32_t>& indices = clusters.indices();
+        CHECK(std::find(indices.begin(), indices.end(), 2u) == indices.end());
+        CHECK(std::find(indices.begin(), indices.end(), 3u) == indices.end());
+    }
+
+    // Lights are placed in world space and binned as the view sees them
+    void testViewMovesLights() {
+        LightClusters clusters;
+        clusters.setProjection(perspective(float(M_PI) * 0.5f, 16.0f / 9.0f), kNear, kFar);
+
+        simd::float4x4 view = matrix_identity_float4x4;
+        view.columns[3] = simd_make_float4(0.0f, 0.0f, -20.0f, 1.0f);
+        const LightClusters::Light light = { simd_make_float3(0.0f, 0.0f, 0.0f), 1.0f };
+        clusters.assign(view, &light, 1);
+
+        CHECK(lightsIn(clusters, clusters.clusterAt(0.0f, 0.0f, 20.0f)) == std::vector<uint32_t>{ 0 });
+        CHECK(lightsIn(clusters, clusters.clusterAt(0.0f, 0.0f, 10.0f)).empty());
+    }
+}
+
+int main() {
+    testLightsLandInTheirClusters();
+    testViewMovesLights();
+    return checkFailures();
+}
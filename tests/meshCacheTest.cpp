@@ -0,0 +1,151 @@
+#include "utility/meshCache.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+
+namespace {
+    const std::string kPath = (std::filesystem::temp_directory_path() / "meshCacheTest.mcache").string();
+
+    std::vector<meshCache::CachedMesh> sampleMeshes() {
+        std::vector<meshCache::CachedMesh> meshes(2);
+        for (size_t m = 0; m < meshes.size(); m++) {
+            meshCache::CachedMesh& mesh = meshes[m];
+            const int side = 20 + int(m) * 7;
+            for (int y = 0; y < side; y++) {
+                for (int x = 0; x < side; x++) {
+                    Vertex vertex = {};
+                    vertex.position = simd_make_float3(float(x), float(m), float(y));
+                    vertex.normal = simd_make_float3(0.0f, 1.0f, 0.0f);
+                    vertex.texCoords = simd_make_float2(x / float(side), y / float(side));
+                    vertex.qtangent = simd_make_short4(0, 0, 0, 32767);
+                    mesh.vertices.push_back(vertex);
+                }
+            }
+            for (int y = 0; y + 1 < side; y++) {
+                for (int x = 0; x + 1 < side; x++) {
+                    const unsigned int corner = y * side + x;
+                    mesh.indices.insert(mesh.indices.end(), { corner, corner + side, corner + 1, corner + 1, corner + side, corner + side + 1 });
+                }
+            }
+            mesh.textures.push_back({ "diffuse", "textures/albedo" + std::to_string(m) + ".png" });
+            mesh.endpoints = { 0, -1, -1, -1 };
+            mesh.instances.push_back(matrix_identity_float4x4);
+        }
+        return meshes;
+    }
+
+    std::vector<unsigned char> readFile(const std::string& path) {
+        std::ifstream stream(path, std::ios::binary);
+        return std::vector<unsigned char>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    }
+
+    void writeFile(const std::string& path, const std::vector<unsigned char>& bytes) {
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+    }
+
+    // Whatever read makes of corrupt input, what it returns has to be safe to draw
+    bool consistent(const std::vector<meshCache::CachedMesh>& meshes) {
+        for (const meshCache::CachedMesh& mesh : meshes) {
+            if (mesh.indices.size() % 3 != 0) return false;
+            for (unsigned int index : mesh.indices) {
+                if (index >= mesh.vertices.size()) return false;
+            }
+        }
+        return true;
+    }
+
+    void testRoundTrip() {
+        const std::vector<meshCache::CachedMesh> meshes = sampleMeshes();
+        CHECK(meshCache::write(kPath, meshes));
+
+        std::vector<meshCache::CachedMesh> loaded;
+        CHECK(meshCache::read(kPath, loaded));
+        CHECK(loaded.size() == meshes.size());
+        for (size_t m = 0; m < loaded.size() && m < meshes.size(); m++) {
+            CHECK(loaded[m].vertices.size() == meshes[m].vertices.size());
+            CHECK(loaded[m].indices.size() == meshes[m].indices.size());
+            CHECK(loaded[m].textures.size() == 1 && loaded[m].textures[0].path == meshes[m].textures[0].path);
+            CHECK(loaded[m].endpoints.diffuse == 0 && loaded[m].endpoints.normal == -1);
+            CHECK(loaded[m].instances.size() == 1);
+
+            bool positions = loaded[m].vertices.size() == meshes[m].vertices.size();
+            for (size_t i = 0; positions && i < loaded[m].vertices.size(); i++) {
+                positions = std::memcmp(&loaded[m].vertices[i].position, &meshes[m].vertices[i].position, sizeof(float) * 3) == 0;
+            }
+            CHECK(positions);
+        }
+        CHECK(consistent(loaded));
+    }
+
+    void testTruncation() {
+        const std::vector<unsigned char> bytes = readFile(kPath);
+        CHECK(!bytes.empty());
+
+        bool rejected = true;
+        for (size_t length = 0; length < bytes.size(); length += 1 + length / 64) {
+            writeFile(kPath, std::vector<unsigned char>(bytes.begin(), bytes.begin() + length));
+            std::vector<meshCache::CachedMesh> loaded;
+            rejected = rejected && !meshCache::read(kPath, loaded);
+        }
+        CHECK(rejected);
+        writeFile(kPath, bytes);
+    }
+
+    // Counts past what the file could hold must fail before anything is allocated for them
+    void testHugeCounts() {
+        const std::vector<unsigned char> bytes = readFile(kPath);
+        const size_t countOffsets[] = {
+            8,  // mesh count
+            12, // first mesh's vertex count
+            16, // first mesh's index count
+            36, // first mesh's texture count
+        };
+        for (size_t offset : countOffsets) {
+            std::vector<unsigned char> corrupt = bytes;
+            const uint32_t huge = 0xFFFFFFF0u;
+            std::memcpy(corrupt.data() + offset, &huge, sizeof(huge));
+            writeFile(kPath, corrupt);
+
+            std::vector<meshCache::CachedMesh> loaded;
+            CHECK(!meshCache::read(kPath, loaded));
+        }
+        writeFile(kPath, bytes);
+    }
+
+    void testRandomCorruption() {
+        const std::vector<unsigned char> bytes = readFile(kPath);
+        std::mt19937 random(7);
+
+        bool allConsistent = true;
+        for (int round = 0; round < 2000; round++) {
+            std::vector<unsigned char> corrupt = bytes;
+            const int flips = 1 + round % 8;
+            for (int i = 0; i < flips; i++) {
+                corrupt[random() % corrupt.size()] ^= (unsigned char)(1 + random() % 255);
+            }
+            writeFile(kPath, corrupt);
+
+            std::vector<meshCache::CachedMesh> loaded;
+            if (meshCache::read(kPath, loaded)) allConsistent = allConsistent && consistent(loaded);
+        }
+        CHECK(allConsistent);
+    }
+}
+
+int main() {
+    testRoundTrip();
+    testTruncation();
+    testHugeCounts();
+    testRandomCorruption();
+    std::filesystem::remove(kPath);
+    return checkFailures();
+}
@@ -0,0 +1,67 @@
+#include "utility/normalGeneration.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "check.hpp"
+
+namespace {
+    // Unindexed bumpy grid, every corner its own vertex, so each position group gathers
+    // from up to six triangles and the welding does all the work
+    void makeGrid(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+        constexpr int kSize = 96;
+        auto at = [](int x, int y) {
+            return simd_make_float3((float)x, std::sin(x * 0.37f) * std::cos(y * 0.21f) * 3.0f, (float)y);
+        };
+        vertices.clear();
+        indices.clear();
+        for (int y = 0; y < kSize; y++) {
+            for (int x = 0; x < kSize; x++) {
+                const simd::float3 corners[6] = { at(x, y), at(x, y + 1), at(x + 1, y), at(x + 1, y), at(x, y + 1), at(x + 1, y + 1) };
+                for (const simd::float3& corner : corners) {
+                    Vertex vertex = {};
+                    vertex.position = corner;
+                    indices.push_back((unsigned int)vertices.size());
+                    vertices.push_back(vertex);
+                }
+            }
+        }
+    }
+
+    bool sameNormals(const std::vector<Vertex>& a, const std::vector<Vertex>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (std::memcmp(&a[i].normal, &b[i].normal, sizeof(float) * 3) != 0) return false;
+        }
+        return true;
+    }
+
+    // Cooked caches have to come out byte-for-byte the same however the work was split
+    void testReproducible() {
+        for (float smoothing : { 80.0f, 180.0f }) {
+            std::vector<Vertex> reference, vertices;
+            std::vector<unsigned int> referenceIndices, indices;
+
+            normalGeneration::Options options;
+            options.smoothingAngleDegrees = smoothing;
+            options.threadCount = 1;
+            makeGrid(reference, referenceIndices);
+            normalGeneration::generateNormals(reference, referenceIndices, options);
+
+            for (unsigned int threads : { 0u, 3u, 8u }) {
+                options.threadCount = threads;
+                for (int run = 0; run < 3; run++) {
+                    makeGrid(vertices, indices);
+                    normalGeneration::generateNormals(vertices, indices, options);
+                    CHECK(sameNormals(vertices, reference) && indices == referenceIndices);
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    testReproducible();
+    return checkFailures();
+}
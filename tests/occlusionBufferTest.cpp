@@ -0,0 +1,71 @@
+#include "utility/occlusionBuffer.hpp"
+
+#include <cmath>
+
+#include "check.hpp"
+
+namespace {
+    // Right handed, looking down -z, depth in -w..w like Camera::getPerspectiveMatrix
+    simd::float4x4 perspective(float fovY, float aspect, float nearPlane, float farPlane) {
+        const float f = 1.0f / std::tan(fovY * 0.5f);
+        return simd_matrix(simd_make_float4(f / aspect, 0.0f, 0.0f, 0.0f),
+                           simd_make_float4(0.0f, f, 0.0f, 0.0f),
+                           simd_make_float4(0.0f, 0.0f, (farPlane + nearPlane) / (nearPlane - farPlane), -1.0f),
+                           simd_make_float4(0.0f, 0.0f, 2.0f * farPlane * nearPlane / (nearPlane - farPlane), 0.0f));
+    }
+
+    // Camera at the origin, a wall 8 wide and 6 high 10 units ahead of it
+    struct Scene {
+        simd::float4x4 viewProjection = perspective(float(M_PI) * 0.5f, 2.0f, 0.1f, 100.0f);
+        OcclusionBuffer buffer = OcclusionBuffer(256, 128);
+
+        Scene() {
+            const float wall[4][3] = { { -4.0f, -3.0f, -10.0f }, { 4.0f, -3.0f, -10.0f }, { 4.0f, 3.0f, -10.0f }, { -4.0f, 3.0f, -10.0f } };
+            const uint32_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+            buffer.clear();
+            buffer.addOccluder(viewProjection, wall, sizeof(wall[0]), 4, indices, 6);
+            buffer.rasterize();
+        }
+
+        bool occluded(simd::float3 min, simd::float3 max) const {
+            return buffer.isOccluded(viewProjection, min, max);
+        }
+    };
+
+    void testWallHidesWhatIsBehindIt() {
+        Scene scene;
+        CHECK(scene.buffer.triangleCount() == 2);
+        CHECK(scene.occluded(simd_make_float3(-1.0f, -1.0f, -20.0f), simd_make_float3(1.0f, 1.0f, -18.0f)));
+        // Same screen rectangle, but in front of the wall
+        CHECK(!scene.occluded(simd_make_float3(-0.5f, -0.5f, -6.0f), simd_make_float3(0.5f, 0.5f, -5.0f)));
+        // Behind the wall's plane, beside it
+        CHECK(!scene.occluded(simd_make_float3(14.0f, -1.0f, -20.0f), simd_make_float3(16.0f, 1.0f, -18.0f)));
+        // Half behind the wall, half past its edge
+        CHECK(!scene.occluded(simd_make_float3(5.0f, -1.0f, -20.0f), simd_make_float3(9.0f, 1.0f, -18.0f)));
+        // Cutting through the wall
+        CHECK(!scene.occluded(simd_make_float3(-1.0f, -1.0f, -12.0f), simd_make_float3(1.0f, 1.0f, -8.0f)));
+    }
+
+    void testWallDepth() {
+        Scene scene;
+        const simd::float4 center = simd_mul(scene.viewProjection, simd_make_float4(0.0f, 0.0f, -10.0f, 1.0f));
+        const float depth = scene.buffer.depthAt(128, 64);
+        CHECK(depth >= center.z / center.w && depth < 1.0f);
+        CHECK(scene.buffer.depthAt(2, 2) == 1.0f);
+    }
+
+    void testEmptyBufferHidesNothing() {
+        OcclusionBuffer buffer(64, 64);
+        buffer.clear();
+        buffer.rasterize();
+        const simd::float4x4 viewProjection = perspective(float(M_PI) * 0.5f, 1.0f, 0.1f, 100.0f);
+        CHECK(!buffer.isOccluded(viewProjection, simd_make_float3(-1.0f, -1.0f, -60.0f), simd_make_float3(1.0f, 1.0f, -50.0f)));
+    }
+}
+
+int main() {
+    testWallHidesWhatIsBehindIt();
+    testWallDepth();
+    testEmptyBufferHidesNothing();
+    return checkFailures();
+}
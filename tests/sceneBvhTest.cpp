@@ -0,0 +1,67 @@
+#include "utility/sceneBvh.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "check.hpp"
+
+namespace {
+    // Unit boxes on a 40 x 40 grid in the xy plane, centred on the origin
+    constexpr int kGrid = 40;
+
+    simd::float3 cellCenter(uint32_t item) {
+        return simd_make_float3(float(item % kGrid) - kGrid * 0.5f + 0.5f, float(item / kGrid) - kGrid * 0.5f + 0.5f, 0.0f);
+    }
+
+    // Axis-aligned box [-halfSize, halfSize] seen as a frustum, planes pointing inwards
+    culling::Frustum boxFrustum(simd::float3 center, float halfSize) {
+        culling::Frustum frustum;
+        for (int axis = 0; axis < 3; axis++) {
+            simd::float4 plane = simd_make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+            plane[axis] = 1.0f;
+            plane.w = halfSize - center[axis];
+            frustum.planes[axis * 2] = plane;
+            plane[axis] = -1.0f;
+            plane.w = halfSize + center[axis];
+            frustum.planes[axis * 2 + 1] = plane;
+        }
+        return frustum;
+    }
+
+    // The tree has to find exactly the items the flat cull finds, items of leaves that
+    // only straddle the frustum included
+    void testFrustumMatchesFlatCull() {
+        SceneBvh bvh;
+        culling::BoxSet boxes;
+        bvh.resize(kGrid * kGrid);
+        boxes.resize(kGrid * kGrid);
+        const simd::float3 extent = simd_make_float3(0.4f, 0.4f, 0.4f);
+        for (uint32_t item = 0; item < kGrid * kGrid; item++) {
+            bvh.setItem(item, cellCenter(item) - extent, cellCenter(item) + extent);
+            boxes.set(item, cellCenter(item), extent);
+        }
+        bvh.build();
+
+        const simd::float3 centers[] = {
+            simd_make_float3(0.0f, 0.0f, 0.0f), simd_make_float3(3.3f, -7.1f, 0.0f), simd_make_float3(19.0f, 19.0f, 0.0f),
+        };
+        for (simd::float3 center : centers) {
+            for (float halfSize : { 0.7f, 2.45f, 6.0f }) {
+                const culling::Frustum frustum = boxFrustum(center, halfSize);
+
+                std::vector<uint32_t> expected(boxes.count);
+                expected.resize(culling::cull(frustum, boxes, expected.data()));
+
+                std::vector<uint32_t> found;
+                bvh.queryFrustum(frustum, found);
+                std::sort(found.begin(), found.end());
+                CHECK(found == expected);
+            }
+        }
+    }
+}
+
+int main() {
+    testFrustumMatchesFlatCull();
+    return checkFailures();
+}
@@ -0,0 +1,93 @@
+#include "utility/normalGeneration.hpp"
+#include "utility/tangentFrame.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "check.hpp"
+
+namespace {
+    bool near(simd::float3 a, simd::float3 b, float tolerance) {
+        return simd::length(a - b) < tolerance;
+    }
+
+    bool finite(simd::float3 v) {
+        return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+    }
+
+    void testRoundTrip() {
+        const simd::float3 normal = simd::normalize(simd_make_float3(0.2f, 0.9f, -0.3f));
+        const simd::float3 tangent = simd::normalize(simd::cross(normal, simd_make_float3(0.0f, 0.0f, 1.0f)));
+        for (float handedness : { 1.0f, -1.0f }) {
+            simd::float3 n, t, b;
+            tangentFrame::decodeQTangent(tangentFrame::encodeQTangent(normal, tangent, handedness), n, t, b);
+            CHECK(near(n, normal, 1e-3f));
+            CHECK(near(t, tangent, 1e-3f));
+            CHECK(near(b, simd::cross(normal, tangent) * handedness, 1e-3f));
+        }
+    }
+
+    // Raw file frames: zero normal, zero tangent, tangent along the normal, NaN. Each still
+    // has to encode a valid orthonormal frame around the normal it was given.
+    void testDegenerateInput() {
+        const simd::float3 up = simd_make_float3(0.0f, 1.0f, 0.0f);
+        const simd::float3 zero = simd_make_float3(0.0f, 0.0f, 0.0f);
+        const simd::float3 cases[][2] = {
+            { zero, simd_make_float3(1.0f, 0.0f, 0.0f) },
+            { up, zero },
+            { up, up * 3.0f },
+            { up, simd_make_float3(NAN, 0.0f, 0.0f) },
+            { simd_make_float3(NAN, NAN, NAN), zero },
+        };
+        for (const simd::float3 (&frame)[2] : cases) {
+            simd::float3 n, t, b;
+            tangentFrame::decodeQTangent(tangentFrame::encodeQTangent(frame[0], frame[1], 1.0f), n, t, b);
+            CHECK(finite(n) && finite(t) && finite(b));
+            CHECK(std::fabs(simd::length(n) - 1.0f) < 1e-3f && std::fabs(simd::length(t) - 1.0f) < 1e-3f);
+            CHECK(std::fabs(simd::dot(n, t)) < 1e-3f);
+            if (simd::length_squared(frame[0]) > 0.5f) CHECK(near(n, up, 1e-3f));
+        }
+    }
+
+    // A cube with shared corners and no normals, the way a glTF without NORMAL arrives.
+    // Flat normal generation splits every corner, and the split vertices need frames too.
+    void testFramesAfterNormalGeneration() {
+        std::vector<Vertex> vertices(8);
+        for (int i = 0; i < 8; i++) {
+            vertices[i] = {};
+            vertices[i].position = simd_make_float3(float(i & 1), float((i >> 1) & 1), float((i >> 2) & 1));
+            vertices[i].texCoords = simd_make_float2(float(i & 1), float(((i >> 1) ^ (i >> 2)) & 1));
+        }
+        std::vector<unsigned int> indices = {
+            0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,
+            0, 1, 4, 1, 5, 4,  2, 6, 3, 3, 6, 7,
+            0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5,
+        };
+
+        normalGeneration::Options options;
+        options.smoothingAngleDegrees = 0.0f;
+        normalGeneration::generateNormals(vertices, indices, options);
+        CHECK(vertices.size() == 24);
+
+        tangentFrame::generateTangents(vertices, indices);
+        CHECK(tangentFrame::hasTangents(vertices));
+
+        bool allValid = true;
+        for (const Vertex& vertex : vertices) {
+            const simd::short4 q = vertex.qtangent;
+            simd::float3 n, t, b;
+            tangentFrame::decodeQTangent(q, n, t, b);
+            allValid = allValid && (q.x != 0 || q.y != 0 || q.z != 0 || q.w != 0);
+            allValid = allValid && finite(n) && finite(t) && finite(b);
+            allValid = allValid && near(n, simd::normalize(vertex.normal), 1e-3f) && std::fabs(simd::dot(n, t)) < 1e-3f;
+        }
+        CHECK(allValid);
+    }
+}
+
+int main() {
+    testRoundTrip();
+    testDegenerateInput();
+    testFramesAfterNormalGeneration();
+    return checkFailures();
+}
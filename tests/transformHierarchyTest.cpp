@@ -0,0 +1,66 @@
+#include "utility/transformHierarchy.hpp"
+
+#include <cmath>
+
+#include "check.hpp"
+
+namespace {
+    bool near(const simd::float4x4& a, const simd::float4x4& b, float tolerance) {
+        for (int c = 0; c < 4; c++) {
+            if (simd::length(a.columns[c] - b.columns[c]) > tolerance) return false;
+        }
+        return true;
+    }
+
+    simd::float4x4 translationMatrix(simd::float3 t) {
+        simd::float4x4 m = matrix_identity_float4x4;
+        m.columns[3] = simd_make_float4(t.x, t.y, t.z, 1.0f);
+        return m;
+    }
+
+    const simd::quatf kIdentityRotation = simd_quaternion(0.0f, 0.0f, 0.0f, 1.0f);
+    const simd::float3 kUnitScale = simd_make_float3(1.0f, 1.0f, 1.0f);
+
+    void testChildFollowsParent() {
+        TransformHierarchy hierarchy;
+        uint32_t root = hierarchy.append(TransformHierarchy::kNoParent, simd_make_float3(1.0f, 0.0f, 0.0f), kIdentityRotation, kUnitScale);
+        uint32_t child = hierarchy.append(root, simd_make_float3(0.0f, 2.0f, 0.0f), kIdentityRotation, kUnitScale);
+        uint32_t sibling = hierarchy.append(TransformHierarchy::kNoParent, simd_make_float3(0.0f, 0.0f, 3.0f), kIdentityRotation, kUnitScale);
+        CHECK(hierarchy.update() == 3);
+        CHECK(near(hierarchy.world(child), translationMatrix(simd_make_float3(1.0f, 2.0f, 0.0f)), 1e-5f));
+
+        // Only the edited subtree is recomputed
+        hierarchy.setTranslation(root, simd_make_float3(5.0f, 0.0f, 0.0f));
+        CHECK(hierarchy.update() == 2);
+        CHECK(hierarchy.wasUpdated(child));
+        CHECK(!hierarchy.wasUpdated(sibling));
+        CHECK(near(hierarchy.world(child), translationMatrix(simd_make_float3(5.0f, 2.0f, 0.0f)), 1e-5f));
+        CHECK(hierarchy.update() == 0);
+    }
+
+    // A sheared node keeps its shear through the residual, also after its TRS is edited
+    void testResidualKeepsShear() {
+        simd::float4x4 shear = matrix_identity_float4x4;
+        shear.columns[1].x = 0.5f;
+
+        TransformHierarchy hierarchy;
+        uint32_t node = hierarchy.append(TransformHierarchy::kNoParent, simd_make_float3(0.0f, 0.0f, 0.0f), kIdentityRotation, kUnitScale);
+        hierarchy.setResidual(node, shear);
+        hierarchy.update();
+        CHECK(near(hierarchy.world(node), shear, 1e-5f));
+
+        const simd::float3 translation = simd_make_float3(0.0f, 1.0f, 0.0f);
+        const simd::quatf rotation = simd_quaternion(float(M_PI) * 0.5f, simd_make_float3(0.0f, 0.0f, 1.0f));
+        hierarchy.setTranslation(node, translation);
+        hierarchy.setRotation(node, rotation);
+        hierarchy.update();
+        const simd::float4x4 expected = simd_mul(translationMatrix(translation), simd_mul(simd_matrix4x4(rotation), shear));
+        CHECK(near(hierarchy.world(node), expected, 1e-5f));
+    }
+}
+
+int main() {
+    testChildFollowsParent();
+    testResidualKeepsShear();
+    return checkFailures();
+}